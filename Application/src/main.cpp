@@ -1,5 +1,7 @@
 #include <iostream>
+#include <thread>
 #include "src\system.h"
+#include "src\emulation_thread.h"
 
 int main()
 {
@@ -17,7 +19,15 @@ int main()
 
 	system.loadRom(input);
 	system.init();
-	system.start();
+
+	EmulationThread emulation(system);
+	emulation.start();
+	while (emulation.running())
+	{
+		emulation.pollFrame();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	emulation.stop();
 
 	return 0;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include "cpu.h"
 #include "addressing_utils.h"
+#include "opcode_info.h"
 #include <cstdint>
 
 inline uint16_t dpRead16(const CPU& cpu, uint8_t dpOff)
@@ -148,3 +149,66 @@ inline uint32_t absoluteIndirectLong(CPU& cpu)
     uint8_t hi = cpu.memory->read(addr::bank0(uint16_t(addr + 2)));
     return (uint32_t(hi) << 16) | (uint32_t(mi) << 8) | lo;
 }
+
+
+// Addressing modes as types, so an operation can be instantiated per mode and
+// each opcode handler inlines its own effective address calculation. Each type
+// names the AddrMode the disassembler and cycle table see for it.
+namespace mode
+{
+    template <AddrMode Mode>
+    struct Tagged
+    {
+        static constexpr AddrMode addressing = Mode;
+    };
+
+    template <class Derived, AddrMode Mode>
+    struct Addressed : Tagged<Mode>
+    {
+        static uint16_t load(CPU& cpu, bool) { return cpu.memory->read(Derived::address(cpu)); }
+        static void store(CPU& cpu, uint8_t value) { cpu.memory->write(Derived::address(cpu), value); }
+    };
+
+    struct Implied : Tagged<AddrMode::Implied> {};
+    struct Accumulator : Tagged<AddrMode::Accumulator> {};
+
+    // The operation passes its own register width; the tag only tells the tables which one that is
+    template <AddrMode Mode>
+    struct Immediate : Tagged<Mode>
+    {
+        static uint16_t load(CPU& cpu, bool in8BitMode) { return immediate(cpu, in8BitMode); }
+    };
+    using ImmediateM = Immediate<AddrMode::ImmediateM>;
+    using ImmediateX = Immediate<AddrMode::ImmediateX>;
+    using Immediate8 = Immediate<AddrMode::Immediate8>;
+
+    struct Relative : Tagged<AddrMode::Relative>
+    {
+        static uint16_t target(CPU& cpu)
+        {
+            int8_t offset = int8_t(cpu.fetch8());
+            return uint16_t(cpu.registers.PC + offset);
+        }
+    };
+    struct RelativeLong : Tagged<AddrMode::RelativeLong> {};
+
+    struct DirectPage : Addressed<DirectPage, AddrMode::DirectPage> { static uint32_t address(CPU& cpu) { return directPage(cpu); } };
+    struct DirectPageX : Addressed<DirectPageX, AddrMode::DirectPageX> { static uint32_t address(CPU& cpu) { return directPage(cpu, cpu.registers.X); } };
+    struct DirectPageY : Addressed<DirectPageY, AddrMode::DirectPageY> { static uint32_t address(CPU& cpu) { return directPage(cpu, cpu.registers.Y); } };
+    struct DpIndirect : Addressed<DpIndirect, AddrMode::DpIndirect> { static uint32_t address(CPU& cpu) { return dpIndirect(cpu); } };
+    struct DpIndirectX : Addressed<DpIndirectX, AddrMode::DpIndirectX> { static uint32_t address(CPU& cpu) { return dpIndirectX(cpu); } };
+    struct DpIndirectY : Addressed<DpIndirectY, AddrMode::DpIndirectY> { static uint32_t address(CPU& cpu) { return dpIndirectY(cpu); } };
+    struct DpIndirectLong : Addressed<DpIndirectLong, AddrMode::DpIndirectLong> { static uint32_t address(CPU& cpu) { return dpIndirectLong(cpu); } };
+    struct DpIndirectLongY : Addressed<DpIndirectLongY, AddrMode::DpIndirectLongY> { static uint32_t address(CPU& cpu) { return dpIndirectLongY(cpu); } };
+    struct Absolute : Addressed<Absolute, AddrMode::Absolute> { static uint32_t address(CPU& cpu) { return absolute(cpu); } };
+    struct AbsoluteX : Addressed<AbsoluteX, AddrMode::AbsoluteX> { static uint32_t address(CPU& cpu) { return absoluteX(cpu); } };
+    struct AbsoluteY : Addressed<AbsoluteY, AddrMode::AbsoluteY> { static uint32_t address(CPU& cpu) { return absoluteY(cpu); } };
+    struct AbsoluteLong : Addressed<AbsoluteLong, AddrMode::AbsoluteLong> { static uint32_t address(CPU& cpu) { return absoluteLong(cpu); } };
+    struct AbsoluteLongX : Addressed<AbsoluteLongX, AddrMode::AbsoluteLongX> { static uint32_t address(CPU& cpu) { return absoluteLong(cpu, cpu.registers.X); } };
+    struct AbsoluteIndirect : Addressed<AbsoluteIndirect, AddrMode::AbsoluteIndirect> { static uint32_t address(CPU& cpu) { return absoluteIndirect(cpu); } };
+    struct AbsoluteIndexedIndirect : Addressed<AbsoluteIndexedIndirect, AddrMode::AbsoluteIndexedIndirect> { static uint32_t address(CPU& cpu) { return absoluteIndexedIndirect(cpu); } };
+    struct AbsoluteIndirectLong : Addressed<AbsoluteIndirectLong, AddrMode::AbsoluteIndirectLong> { static uint32_t address(CPU& cpu) { return absoluteIndirectLong(cpu); } };
+    struct StackRelative : Addressed<StackRelative, AddrMode::StackRelative> { static uint32_t address(CPU& cpu) { return stackRelative(cpu); } };
+    struct StackRelativeIndirectY : Addressed<StackRelativeIndirectY, AddrMode::StackRelativeIndirectY> { static uint32_t address(CPU& cpu) { return stackRelativeIndirectY(cpu); } };
+    struct BlockMove : Tagged<AddrMode::BlockMove> {};
+}
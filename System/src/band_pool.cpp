@@ -0,0 +1,89 @@
+#include "band_pool.h"
+
+BandPool::BandPool(size_t threads)
+{
+	for (size_t i = 1; i < threads; ++i)
+		workers.emplace_back(&BandPool::work, this);
+}
+
+BandPool::~BandPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void BandPool::run(size_t bands, Job task, void* context)
+{
+	if (bands == 0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		job = task;
+		ctx = context;
+		bandCount = bands;
+		nextBand.store(0, std::memory_order_relaxed);
+		doneBands.store(0, std::memory_order_relaxed);
+		++generation;
+	}
+	wake.notify_all();
+	drain(task, context, bands);
+
+	std::unique_lock<std::mutex> guard(lock);
+	finished.wait(guard, [this] { return doneBands.load(std::memory_order_acquire) == bandCount && active == 0; });
+}
+
+void BandPool::drain(Job task, void* context, size_t bands)
+{
+	// Bands are claimed one at a time, so a slow thread only holds up its own band
+	size_t band;
+	while ((band = nextBand.fetch_add(1, std::memory_order_relaxed)) < bands)
+	{
+		task(context, band);
+		if (doneBands.fetch_add(1, std::memory_order_acq_rel) + 1 == bands)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			finished.notify_all();
+		}
+	}
+}
+
+void BandPool::work()
+{
+	uint64_t seen = 0;
+	for (;;)
+	{
+		Job task;
+		void* context;
+		size_t bands;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [&] { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+
+			// Woken too late to help: run() may already have returned, and the next
+			// run() would reset nextBand under a job this worker never saw
+			if (nextBand.load(std::memory_order_relaxed) >= bandCount)
+				continue;
+
+			// Copied under the lock; run() cannot return, and so cannot publish
+			// another job, while this worker is counted in active
+			task = job;
+			context = ctx;
+			bands = bandCount;
+			++active;
+		}
+		drain(task, context, bands);
+
+		std::lock_guard<std::mutex> guard(lock);
+		if (--active == 0)
+			finished.notify_all();
+	}
+}
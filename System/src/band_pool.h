@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed pool for splitting one job into independent bands, such as row
+// ranges of a frame. run() hands the job to the workers, takes bands itself
+// too and returns once every band is done. Jobs are a plain function and
+// context, so dispatching a frame allocates nothing.
+class BandPool
+{
+public:
+	using Job = void (*)(void* ctx, size_t band);
+
+	explicit BandPool(size_t threads);	// Total threads including the caller of run()
+	~BandPool();
+	BandPool(const BandPool&) = delete;
+	BandPool& operator=(const BandPool&) = delete;
+
+	void run(size_t bands, Job job, void* ctx);
+	size_t threads() const { return workers.size() + 1; }
+private:
+	void work();
+	void drain(Job task, void* context, size_t bands);
+
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	uint64_t generation = 0;
+	bool stopping = false;
+	size_t active = 0;		// Workers inside drain(), which must be none before the next job
+
+	Job job = nullptr;
+	void* ctx = nullptr;
+	size_t bandCount = 0;
+	std::atomic<size_t> nextBand{ 0 };
+	std::atomic<size_t> doneBands{ 0 };
+};
@@ -0,0 +1,83 @@
+#include "bus.h"
+
+constexpr uint32_t Bus::WRAM_START;
+constexpr uint32_t Bus::WRAM_END;
+constexpr uint32_t Bus::WRAM_MIRROR_SIZE;
+constexpr uint32_t Bus::ROM_START;
+
+Bus::Bus() : Bus(MachineStatePool::shared().acquire())
+{
+
+}
+
+Bus::Bus(MachineStatePool::Handle state)
+	: ownState(std::move(state)),
+	map(ownState->pageTable),
+	wram(ownState->wram, MachineState::WRAM_SIZE)
+{
+	wram.fill(0xFF);
+	mapFixed();
+}
+
+Bus::Bus(MachineState& state)
+	: map(state.pageTable),
+	wram(state.wram, MachineState::WRAM_SIZE)
+{
+	wram.fill(0xFF);
+	mapFixed();
+}
+
+void Bus::loadRom(const std::vector<uint8_t>& program)
+{
+	loadRom(RomStore::instance().intern(program));
+}
+
+void Bus::loadRom(RomImage image)
+{
+	rom.load(std::move(image));
+	if (romMapped)
+		rebuild();
+	else
+		mapRom();
+}
+
+void Bus::mapCartridge(uint32_t start, uint32_t end, MemoryHandler* handler)
+{
+	// Mapping the same region again, as a second loadSram() does, changes nothing
+	for (const auto& region : cartridge)
+	{
+		if (region.start == start && region.end == end && region.handler == handler)
+			return;
+	}
+	cartridge.push_back({ start, end, handler });
+	map.map(start, end, handler);
+}
+
+void Bus::mapFixed()
+{
+	// Whole 4 KiB pages, so every fixed access resolves from the page table without a search
+	map.map(WRAM_START, WRAM_END, &wram);
+	for (uint32_t bank = 0x00; bank <= 0x3F; ++bank)
+	{
+		map.map(bank << 16, (bank << 16) + WRAM_MIRROR_SIZE - 1, &wram);
+		map.map((bank | 0x80) << 16, ((bank | 0x80) << 16) + WRAM_MIRROR_SIZE - 1, &wram);
+	}
+	map.mapIo(&io);
+}
+
+void Bus::mapRom()
+{
+	if (rom.size())
+		map.map(ROM_START, ROM_START + uint32_t(rom.size()) - 1, &rom);
+	romMapped = true;
+}
+
+void Bus::rebuild()
+{
+	// Coverage and other per-region settings are dropped; attach them after loading
+	map.clear();
+	mapFixed();
+	mapRom();
+	for (const auto& region : cartridge)
+		map.map(region.start, region.end, region.handler);
+}
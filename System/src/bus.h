@@ -0,0 +1,67 @@
+#pragma once
+#include "memory.h"
+#include "io.h"
+#include "machine_state.h"
+#include <cstdint>
+#include <vector>
+
+// The whole SNES address decode in one place. Regions fixed by the console
+// (WRAM and its low-bank mirrors, the I/O pages) are wired at construction;
+// cartridge regions are added at runtime. Fixed regions are mapped first, so
+// they win over cartridge mappings exactly like the hardware decoder.
+class Bus
+{
+	MachineStatePool::Handle ownState;	// Declared first; set only when the bus owns its arena
+public:
+	static constexpr uint32_t WRAM_START = 0x7E0000;
+	static constexpr uint32_t WRAM_END = 0x7FFFFF;
+	static constexpr uint32_t WRAM_MIRROR_SIZE = 0x2000;
+	static constexpr uint32_t ROM_START = 0x008000;
+
+	// The first 8K of WRAM in banks $00-$3F and $80-$BF
+	static constexpr bool isWramMirror(uint32_t address)
+	{
+		return ((address >> 16) & 0x7F) < 0x40 && (address & 0xFFFF) < WRAM_MIRROR_SIZE;
+	}
+	static constexpr bool isWram(uint32_t address)
+	{
+		return (address >= WRAM_START && address <= WRAM_END) || isWramMirror(address);
+	}
+	static constexpr uint32_t wramOffset(uint32_t address)
+	{
+		return isWramMirror(address) ? (address & 0xFFFF) : address - WRAM_START;
+	}
+	static bool isIo(uint32_t address) { return IoDispatcher::contains(address); }
+
+	Bus();
+	explicit Bus(MachineState& state);	// Page table and WRAM live in the arena
+	Bus(const Bus&) = delete;
+	Bus& operator=(const Bus&) = delete;
+
+	// Maps the image linearly from $00:8000 and rebuilds the decode if one was already mapped
+	void loadRom(const std::vector<uint8_t>& program);
+	void loadRom(RomImage image);
+	void mapCartridge(uint32_t start, uint32_t end, MemoryHandler* handler);
+
+	uint8_t peek(uint32_t address) const { return map.peek(address); }
+
+	MemoryMap map;
+	RAM wram;
+	ROM rom = {};
+	IoDispatcher io = {};
+private:
+	struct CartridgeRegion
+	{
+		uint32_t start;
+		uint32_t end;
+		MemoryHandler* handler;
+	};
+
+	explicit Bus(MachineStatePool::Handle state);
+	void mapFixed();
+	void rebuild();
+	void mapRom();
+
+	std::vector<CartridgeRegion> cartridge = {};
+	bool romMapped = false;
+};
@@ -0,0 +1,193 @@
+#include "color_math.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COLORMATH_SSE2 1
+#endif
+
+namespace
+{
+	uint16_t scaleChannel(uint32_t value, uint32_t scale)
+	{
+		return uint16_t((value * scale) >> 4);
+	}
+
+	uint16_t blendPixel(uint16_t main, uint16_t sub, bool clip, bool math, bool half, bool subtract, uint32_t scale)
+	{
+		if (clip)
+			main = 0;
+
+		uint32_t channels[3];
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			uint32_t a = (main >> (i * 5)) & 0x1F;
+			uint32_t b = (sub >> (i * 5)) & 0x1F;
+			uint32_t value = a;
+			if (math)
+			{
+				if (subtract)
+					value = a > b ? a - b : 0;
+				else
+					value = a + b;
+				if (half)
+					value >>= 1;
+				else if (value > 31)
+					value = 31;
+			}
+			channels[i] = scaleChannel(value, scale);
+		}
+		return uint16_t(channels[0] | (channels[1] << 5) | (channels[2] << 10));
+	}
+
+#ifdef COLORMATH_SSE2
+	// Expands eight mask bits to eight 16-bit lanes of all ones or zero
+	__m128i expand(const colormath::LineMask& mask, size_t x)
+	{
+		const __m128i select = _mm_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+		__m128i bits = _mm_set1_epi16(short((mask[x >> 6] >> (x & 63)) & 0xFF));
+		return _mm_cmpeq_epi16(_mm_and_si128(bits, select), select);
+	}
+
+	__m128i select(__m128i mask, __m128i whenSet, __m128i whenClear)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, whenSet), _mm_andnot_si128(mask, whenClear));
+	}
+#endif
+}
+
+namespace colormath
+{
+	LineMask none()
+	{
+		return LineMask{ { 0, 0, 0, 0 } };
+	}
+
+	LineMask all()
+	{
+		return ~none();
+	}
+
+	LineMask range(uint32_t left, uint32_t right)
+	{
+		LineMask mask = none();
+		if (left > right)
+			return mask;
+		right = right < WIDTH - 1 ? right : uint32_t(WIDTH - 1);
+		for (uint32_t word = left >> 6; word <= right >> 6; ++word)
+		{
+			uint32_t first = word == (left >> 6) ? left & 63 : 0;
+			uint32_t last = word == (right >> 6) ? right & 63 : 63;
+			uint64_t upTo = last == 63 ? ~uint64_t(0) : (uint64_t(1) << (last + 1)) - 1;
+			mask[word] = upTo & (~uint64_t(0) << first);
+		}
+		return mask;
+	}
+
+	LineMask operator&(const LineMask& a, const LineMask& b)
+	{
+		return LineMask{ { a[0] & b[0], a[1] & b[1], a[2] & b[2], a[3] & b[3] } };
+	}
+
+	LineMask operator|(const LineMask& a, const LineMask& b)
+	{
+		return LineMask{ { a[0] | b[0], a[1] | b[1], a[2] | b[2], a[3] | b[3] } };
+	}
+
+	LineMask operator^(const LineMask& a, const LineMask& b)
+	{
+		return LineMask{ { a[0] ^ b[0], a[1] ^ b[1], a[2] ^ b[2], a[3] ^ b[3] } };
+	}
+
+	LineMask operator~(const LineMask& a)
+	{
+		return LineMask{ { ~a[0], ~a[1], ~a[2], ~a[3] } };
+	}
+
+	bool operator==(const LineMask& a, const LineMask& b)
+	{
+		return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3];
+	}
+
+	LineMask window(const LineMask& window1, const LineMask& window2, uint8_t settings, uint8_t logic)
+	{
+		bool enable1 = (settings & 0x02) != 0;
+		bool enable2 = (settings & 0x08) != 0;
+		LineMask first = (settings & 0x01) ? ~window1 : window1;
+		LineMask second = (settings & 0x04) ? ~window2 : window2;
+
+		if (!enable1 && !enable2)
+			return none();
+		if (!enable2)
+			return first;
+		if (!enable1)
+			return second;
+
+		switch (logic & 0x03)
+		{
+		case 0: return first | second;
+		case 1: return first & second;
+		case 2: return first ^ second;
+		default: return ~(first ^ second);
+		}
+	}
+
+	void blendScalar(const Line& line, uint16_t* out)
+	{
+		uint32_t scale = uint32_t(line.brightness & 0x0F) + 1;
+		for (uint32_t x = 0; x < WIDTH; ++x)
+			out[x] = blendPixel(line.main[x], line.sub[x], test(line.clip, x), test(line.math, x), test(line.half, x), line.subtract, scale);
+	}
+
+	void blend(const Line& line, uint16_t* out)
+	{
+#ifdef COLORMATH_SSE2
+		const __m128i channel = _mm_set1_epi16(0x1F);
+		const __m128i maxChannel = _mm_set1_epi16(31);
+		const __m128i scale = _mm_set1_epi16(short((line.brightness & 0x0F) + 1));
+		bool fullBrightness = (line.brightness & 0x0F) == 0x0F;
+
+		for (size_t x = 0; x < WIDTH; x += 8)
+		{
+			__m128i main = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line.main + x));
+			__m128i sub = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line.sub + x));
+			__m128i math = expand(line.math, x);
+			__m128i half = expand(line.half, x);
+			main = _mm_andnot_si128(expand(line.clip, x), main);
+
+			__m128i result = _mm_setzero_si128();
+			for (int shift = 0; shift < 15; shift += 5)
+			{
+				__m128i a = _mm_and_si128(_mm_srli_epi16(main, shift), channel);
+				__m128i b = _mm_and_si128(_mm_srli_epi16(sub, shift), channel);
+				__m128i combined;
+				if (line.subtract)
+				{
+					combined = _mm_subs_epu16(a, b);
+					combined = select(half, _mm_srli_epi16(combined, 1), combined);
+				}
+				else
+				{
+					combined = _mm_add_epi16(a, b);
+					combined = select(half, _mm_srli_epi16(combined, 1), _mm_min_epi16(combined, maxChannel));
+				}
+				__m128i value = select(math, combined, a);
+				if (!fullBrightness)
+					value = _mm_srli_epi16(_mm_mullo_epi16(value, scale), 4);
+				result = _mm_or_si128(result, _mm_slli_epi16(value, shift));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), result);
+		}
+#else
+		blendScalar(line, out);
+#endif
+	}
+
+	bool simd()
+	{
+#ifdef COLORMATH_SSE2
+		return true;
+#else
+		return false;
+#endif
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Final compositing stage over one 256-pixel line of BGR555 colors: clip to
+// black, color add/subtract with optional halving, then master brightness.
+// Per-pixel conditions come in as line bitmasks, so window logic is a few word
+// operations per line and the blend runs on whole registers; SSE2 handles
+// eight pixels per step. Both paths give identical results.
+namespace colormath
+{
+	static constexpr size_t WIDTH = 256;
+
+	// One bit per pixel, pixel x in bit x % 64 of word x / 64
+	struct LineMask
+	{
+		uint64_t words[WIDTH / 64];
+
+		uint64_t& operator[](size_t i) { return words[i]; }
+		uint64_t operator[](size_t i) const { return words[i]; }
+	};
+
+	LineMask none();
+	LineMask all();
+	LineMask range(uint32_t left, uint32_t right);	// Inclusive, empty when left > right
+	LineMask operator&(const LineMask& a, const LineMask& b);
+	LineMask operator|(const LineMask& a, const LineMask& b);
+	LineMask operator^(const LineMask& a, const LineMask& b);
+	LineMask operator~(const LineMask& a);
+	bool operator==(const LineMask& a, const LineMask& b);
+	inline bool operator!=(const LineMask& a, const LineMask& b) { return !(a == b); }
+	inline bool test(const LineMask& mask, uint32_t x) { return (mask[x >> 6] >> (x & 63)) & 1; }
+	inline void set(LineMask& mask, uint32_t x) { mask[x >> 6] |= uint64_t(1) << (x & 63); }
+
+	// Two windows combined as the PPU does for one layer: settings is the layer's
+	// W12SEL/W34SEL/WOBJSEL nibble, logic its WBGLOG/WOBJLOG bit pair
+	LineMask window(const LineMask& window1, const LineMask& window2, uint8_t settings, uint8_t logic);
+
+	struct Line
+	{
+		const uint16_t* main = nullptr;
+		const uint16_t* sub = nullptr;	// Sub screen or fixed color per pixel
+		LineMask clip = {};				// Main color forced to black first
+		LineMask math = {};				// Combine with sub
+		LineMask half = {};				// Halve the combined color
+		bool subtract = false;
+		uint8_t brightness = 15;		// INIDISP bits 0-3
+	};
+
+	void blend(const Line& line, uint16_t* out);
+	void blendScalar(const Line& line, uint16_t* out);
+	bool simd();	// True when blend() runs the SSE2 path
+}
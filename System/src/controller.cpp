@@ -0,0 +1,17 @@
+#include "controller.h"
+
+constexpr size_t Controllers::PORTS;
+
+void Controllers::attach(IoDispatcher& io)
+{
+	// JOYnL/JOYnH: even addresses return the low byte, odd the high byte
+	for (uint16_t address = 0x4218; address <= 0x421F; ++address)
+	{
+		io.registerRead(address, [](void* ctx, uint16_t address) -> uint8_t
+		{
+			const Controllers& pads = *static_cast<const Controllers*>(ctx);
+			uint16_t state = pads.buttons[(address - 0x4218) >> 1];
+			return uint8_t((address & 1) ? state >> 8 : state);
+		}, this);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "io.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Standard joypads as seen through the auto-read registers JOY1L-JOY4H ($4218-$421F).
+// Button bits follow the hardware order, B in bit 15 down to R in bit 4.
+enum Button : uint16_t
+{
+	ButtonR = 0x0010,
+	ButtonL = 0x0020,
+	ButtonX = 0x0040,
+	ButtonA = 0x0080,
+	ButtonRight = 0x0100,
+	ButtonLeft = 0x0200,
+	ButtonDown = 0x0400,
+	ButtonUp = 0x0800,
+	ButtonStart = 0x1000,
+	ButtonSelect = 0x2000,
+	ButtonY = 0x4000,
+	ButtonB = 0x8000
+};
+
+class Controllers
+{
+public:
+	static constexpr size_t PORTS = 4;
+
+	Controllers() : Controllers(ownButtons) {}
+	explicit Controllers(std::array<uint16_t, PORTS>& state) : buttons(state) { buttons.fill(0); }
+	Controllers(const Controllers&) = delete;
+	Controllers& operator=(const Controllers&) = delete;
+
+	void attach(IoDispatcher& io);
+
+	std::array<uint16_t, PORTS>& buttons;
+private:
+	std::array<uint16_t, PORTS> ownButtons;
+};
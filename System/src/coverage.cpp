@@ -0,0 +1,188 @@
+#include "coverage.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+	const char MAGIC[8] = { 'S', 'N', 'C', 'O', 'V', 0, 0, 1 };
+
+	size_t countBits(const std::vector<uint8_t>& bits, size_t limit)
+	{
+		size_t count = 0;
+		for (size_t i = 0; i < bits.size() && i * 8 < limit; ++i)
+		{
+			uint8_t b = bits[i];
+			if ((i + 1) * 8 > limit)
+				b &= uint8_t((1u << (limit & 7)) - 1);
+			b = uint8_t(b - ((b >> 1) & 0x55));
+			b = uint8_t((b & 0x33) + ((b >> 2) & 0x33));
+			count += (b + (b >> 4)) & 0x0F;
+		}
+		return count;
+	}
+
+	void mergeBits(std::vector<uint8_t>& into, const uint8_t* from)
+	{
+		for (size_t i = 0; i < into.size(); ++i)
+			into[i] |= from[i];
+	}
+
+	void writeU32(std::ostream& out, uint32_t value)
+	{
+		uint8_t bytes[4] = { uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) };
+		out.write(reinterpret_cast<const char*>(bytes), 4);
+	}
+
+	uint32_t readU32(std::istream& in)
+	{
+		uint8_t bytes[4] = {};
+		in.read(reinterpret_cast<char*>(bytes), 4);
+		return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (uint32_t(bytes[3]) << 24);
+	}
+}
+
+void CoverageMap::resize(size_t bytes)
+{
+	size = bytes;
+
+	size_t bitmapBytes = 1;
+	while (bitmapBytes * 8 < bytes)
+		bitmapBytes <<= 1;
+	mask = uint32_t(bitmapBytes * 8 - 1);
+
+	executed.assign(bitmapBytes, 0);
+	readFrom.assign(bitmapBytes, 0);
+	writtenTo.assign(bitmapBytes, 0);
+}
+
+void CoverageMap::clear()
+{
+	std::fill(executed.begin(), executed.end(), 0);
+	std::fill(readFrom.begin(), readFrom.end(), 0);
+	std::fill(writtenTo.begin(), writtenTo.end(), 0);
+}
+
+Coverage::Coverage(size_t romSize, size_t wramSize)
+{
+	rom.resize(romSize);
+	wram.resize(wramSize);
+}
+
+void Coverage::attach(MemoryMap& target, const MemoryHandler* romTarget, const MemoryHandler* wramTarget)
+{
+	detach();
+	memory = &target;
+	romHandler = romTarget;
+	wramHandler = wramTarget;
+	if (romHandler)
+		memory->setCoverage(romHandler, rom.executed.data(), rom.readFrom.data(), rom.writtenTo.data(), rom.mask);
+	if (wramHandler)
+		memory->setCoverage(wramHandler, wram.executed.data(), wram.readFrom.data(), wram.writtenTo.data(), wram.mask);
+}
+
+void Coverage::detach()
+{
+	if (memory && romHandler)
+		memory->clearCoverage(romHandler);
+	if (memory && wramHandler)
+		memory->clearCoverage(wramHandler);
+	memory = nullptr;
+	romHandler = nullptr;
+	wramHandler = nullptr;
+}
+
+void Coverage::clear()
+{
+	rom.clear();
+	wram.clear();
+}
+
+bool Coverage::merge(const Coverage& other)
+{
+	if (other.rom.size != rom.size || other.wram.size != wram.size)
+		return false;
+
+	mergeBits(rom.executed, other.rom.executed.data());
+	mergeBits(rom.readFrom, other.rom.readFrom.data());
+	mergeBits(rom.writtenTo, other.rom.writtenTo.data());
+	mergeBits(wram.executed, other.wram.executed.data());
+	mergeBits(wram.readFrom, other.wram.readFrom.data());
+	mergeBits(wram.writtenTo, other.wram.writtenTo.data());
+	return true;
+}
+
+bool Coverage::save(const std::string& path) const
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+		return false;
+
+	// Header, then executed/read/written bitmaps for ROM and WRAM, bit i = byte offset i
+	out.write(MAGIC, sizeof(MAGIC));
+	writeU32(out, uint32_t(rom.size));
+	writeU32(out, uint32_t(wram.size));
+	for (const CoverageMap* region : { &rom, &wram })
+	{
+		size_t bytes = (region->size + 7) / 8;
+		out.write(reinterpret_cast<const char*>(region->executed.data()), bytes);
+		out.write(reinterpret_cast<const char*>(region->readFrom.data()), bytes);
+		out.write(reinterpret_cast<const char*>(region->writtenTo.data()), bytes);
+	}
+	return bool(out);
+}
+
+bool Coverage::mergeFile(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return false;
+
+	in.seekg(0, std::ios::end);
+	std::streamoff length = in.tellg();
+	in.seekg(0, std::ios::beg);
+
+	char magic[sizeof(MAGIC)] = {};
+	in.read(magic, sizeof(magic));
+	if (!in || !std::equal(magic, magic + sizeof(magic), MAGIC))
+		return false;
+
+	// The sizes come from the file: check them against this map and the file length before allocating anything
+	uint32_t romSize = readU32(in);
+	uint32_t wramSize = readU32(in);
+	if (!in || romSize != rom.size || wramSize != wram.size)
+		return false;
+	std::streamoff expected = std::streamoff(sizeof(MAGIC) + 8 + 3 * ((rom.size + 7) / 8 + (wram.size + 7) / 8));
+	if (length != expected)
+		return false;
+
+	Coverage other(romSize, wramSize);
+
+	for (CoverageMap* region : { &other.rom, &other.wram })
+	{
+		std::streamsize bytes = std::streamsize((region->size + 7) / 8);
+		in.read(reinterpret_cast<char*>(region->executed.data()), bytes);
+		in.read(reinterpret_cast<char*>(region->readFrom.data()), bytes);
+		in.read(reinterpret_cast<char*>(region->writtenTo.data()), bytes);
+	}
+	return bool(in) && merge(other);
+}
+
+std::string Coverage::summary() const
+{
+	std::string text;
+	char line[160];
+	for (const CoverageMap* region : { &rom, &wram })
+	{
+		const char* name = region == &rom ? "ROM" : "WRAM";
+		size_t executed = countBits(region->executed, region->size);
+		size_t read = countBits(region->readFrom, region->size);
+		size_t written = countBits(region->writtenTo, region->size);
+		double total = region->size ? double(region->size) : 1.0;
+
+		snprintf(line, sizeof(line), "%-4s %8zu bytes  executed %8zu (%5.1f%%)  read %8zu (%5.1f%%)  written %8zu (%5.1f%%)\n",
+			name, region->size, executed, 100.0 * executed / total, read, 100.0 * read / total, written, 100.0 * written / total);
+		text += line;
+	}
+	return text;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "memory.h"
+#include <string>
+
+struct CoverageMap
+{
+	void resize(size_t bytes);
+	void clear();
+
+	size_t size = 0;				// Tracked bytes
+	uint32_t mask = 0;				// Offset mask for the power-of-two bitmap length
+	std::vector<uint8_t> executed;	// One bit per byte
+	std::vector<uint8_t> readFrom;
+	std::vector<uint8_t> writtenTo;
+};
+
+// Executed/read/written bitmaps over ROM and WRAM offsets. Bits are set by the
+// MemoryMap on every access to an attached handler and can be merged across runs.
+// Detaches when destroyed, so it must not outlive the map it is attached to.
+class Coverage
+{
+public:
+	Coverage(size_t romSize, size_t wramSize = 0x20000);
+	~Coverage() { detach(); }
+	Coverage(const Coverage&) = delete;
+	Coverage& operator=(const Coverage&) = delete;
+
+	void attach(MemoryMap& memory, const MemoryHandler* romHandler, const MemoryHandler* wramHandler);
+	void detach();
+	void clear();
+
+	bool merge(const Coverage& other);
+	bool save(const std::string& path) const;
+	bool mergeFile(const std::string& path);
+	std::string summary() const;
+
+	CoverageMap rom;
+	CoverageMap wram;
+private:
+	MemoryMap* memory = nullptr;
+	const MemoryHandler* romHandler = nullptr;
+	const MemoryHandler* wramHandler = nullptr;
+};
@@ -1,18 +1,36 @@
 #include "cpu.h"
 #include "opcodes.h"
 #include "addressing_utils.h"
+#include "timing.h"
+#include "debugger.h"
+#include "opcode_info.h"
+#include "trace.h"
 #include <iostream>
 
-CPU::CPU()
+CPU::CPU() : CPU(ownState)
 {
+
+}
+
+CPU::CPU(CpuState& state)
+	: registers(state.registers), cycles(state.cycles), pendingInterrupts(state.pendingInterrupts), running(state.running)
+{
+	state = CpuState();
 	memory = {};
 	opcodeTable = {};
 
 	register_opcodes(*this);
 }
 
+void CPU::reset()
+{
+	setDefaultFlags();
+	running = true;
+}
+
 void CPU::run()
 {
+	PhaseProfiler::Scope phase(profiler, ProfilePhase::CpuDispatch);
 	setDefaultFlags();
 	while (running)
 	{
@@ -20,9 +38,39 @@ void CPU::run()
 	}
 }
 
+void CPU::runUntil(uint64_t cycle)
+{
+	PhaseProfiler::Scope phase(profiler, ProfilePhase::CpuDispatch);
+	while (running && cycles < cycle)
+	{
+		step();
+	}
+}
+
 void CPU::step()
 {
-	uint8_t opcode = memory->read(registers.PC++);
+	if (pendingInterrupts && serviceInterrupts())
+		return;
+
+	uint32_t pc = addr::withPBR(registers.PBR, registers.PC);
+	if (memory->pageFlags(pc) & WatchExec)
+	{
+		if (memory->debugger && memory->debugger->onExec(pc, memory->peek(pc)))
+		{
+			running = false;
+			return;
+		}
+	}
+
+	if (tracer)
+		tracer->record(*this, pc);
+
+	if (codeGeneration != memory->generation())
+		code.length = 0;
+
+	uint8_t opcode = fetch8();
+	cycles += opcodeInfo[opcode].cycles * timing::CLOCKS_PER_CYCLE;
+	++instructions;
 
 	auto& handler = opcodeTable[opcode];
 	if (handler)
@@ -31,6 +79,87 @@ void CPU::step()
 	}
 }
 
+void CPU::setIrq(bool asserted)
+{
+	if (asserted)
+		pendingInterrupts |= InterruptIrq;
+	else
+		pendingInterrupts &= ~InterruptIrq;
+}
+
+bool CPU::serviceInterrupts()
+{
+	if (pendingInterrupts & InterruptNmi)
+	{
+		pendingInterrupts &= ~InterruptNmi;
+		interrupt(0xFFEA, 0xFFFA);
+		return true;
+	}
+	if ((pendingInterrupts & InterruptIrq) && !(registers.P & I))
+	{
+		interrupt(0xFFEE, 0xFFFE);
+		return true;
+	}
+	return false;
+}
+
+void CPU::interrupt(uint16_t nativeVector, uint16_t emulationVector)
+{
+	if (registers.E)
+	{
+		// B is pushed clear so the handler can tell hardware interrupts from BRK
+		push16(registers.PC);
+		push8(registers.P & ~X);
+	}
+	else
+	{
+		push8(registers.PBR);
+		push16(registers.PC);
+		push8(registers.P);
+	}
+
+	setFlag(I, true);
+	setFlag(D, false);
+	registers.PBR = 0;
+
+	uint16_t vector = registers.E ? emulationVector : nativeVector;
+	uint8_t lo = memory->read(addr::bank0(vector));
+	uint8_t hi = memory->read(addr::bank0(uint16_t(vector + 1)));
+	registers.PC = uint16_t((hi << 8) | lo);
+
+	cycles += (registers.E ? 7 : 8) * timing::CLOCKS_PER_CYCLE;
+}
+
+void CPU::push8(uint8_t value)
+{
+	memory->write(addr::bank0(registers.S), value);
+	registers.S = registers.E ? uint16_t(0x0100 | uint8_t(registers.S - 1)) : uint16_t(registers.S - 1);
+}
+
+void CPU::push16(uint16_t value)
+{
+	push8(uint8_t(value >> 8));
+	push8(uint8_t(value));
+}
+
+uint8_t CPU::pull8()
+{
+	registers.S = registers.E ? uint16_t(0x0100 | uint8_t(registers.S + 1)) : uint16_t(registers.S + 1);
+	return memory->read(addr::bank0(registers.S));
+}
+
+uint16_t CPU::pull16()
+{
+	uint8_t lo = pull8();
+	uint8_t hi = pull8();
+	return uint16_t((hi << 8) | lo);
+}
+
+bool CPU::hasHandler(uint8_t opcode) const
+{
+	return opcodeTable[opcode] != nullptr;
+}
+
 void CPU::setDefaultFlags()
 {
 	setFlag(M, true);
@@ -65,6 +194,10 @@ void CPU::setIndex(uint16_t& index, uint16_t value)
 
 void CPU::updateRegisterSizes()
 {
+	// Emulation mode pins M and X, so REP cannot widen the registers
+	if (registers.E)
+		registers.P |= M | X;
+
 	if (isAccumulator8Bit())
 		registers.A &= 0x00FF;
 
@@ -76,10 +209,36 @@ void CPU::updateRegisterSizes()
 
 uint8_t CPU::fetch8()
 {
-	uint8_t v = memory->read(addr::withPBR(registers.PBR, registers.PC));
+	uint16_t index = uint16_t(registers.PC - code.start);
+	if (index >= code.length || registers.PBR != codeBank)
+	{
+		refreshCode();
+		index = uint16_t(registers.PC - code.start);
+	}
+
+	uint8_t v;
+	if (code.bytes)
+	{
+		v = code.bytes[index];
+		++windowFetches;
+		markCoverage(code.executed, code.coverageMask, code.coverageOffset + index);
+		memory->setOpenBus(v);
+	}
+	else
+	{
+		v = memory->fetch(addr::withPBR(registers.PBR, registers.PC));
+	}
 	registers.PC = uint16_t(registers.PC + 1);
 	return v;
 }
+
+void CPU::refreshCode()
+{
+	// Only on page crossings, bank changes and remaps; sequential fetches stay in the window
+	code = memory->codeWindow(addr::withPBR(registers.PBR, registers.PC));
+	codeBank = registers.PBR;
+	codeGeneration = memory->generation();
+}
 uint16_t CPU::fetch16() {
 	uint8_t lo = fetch8();
 	uint8_t hi = fetch8();
@@ -1,21 +1,10 @@
 #pragma once
 #include "memory.h"
+#include "machine_state.h"
 #include <cstdint>
 #include <array>
 
-struct Registers
-{
-	uint8_t		P	= 0;	//Processor Status, holds various important flags
-	uint8_t		DBR = 0;	//Data bank register, holds the default bank for memory transfers
-	uint8_t		PBR = 0;	//Program Bank, holds the bank address of all instruction fetches
-	uint16_t	PC	= 0;	//Program counter 
-	uint16_t	A	= 0;	//The accumulator. This is the math register. It stores one of two operands or the result of most arithmetic and logical operations
-	uint16_t	X	= 0;	//The index registers. These can be used to reference memory, to pass data to memory, or as counters for loops
-	uint16_t	Y	= 0;	
-	uint16_t	S	= 0;	//The stack pointer, points to the next available(unused) location on the stack
-	uint16_t	D	= 0;	//Direct page register, used for direct page addressing modes
-	bool		E	= 0;	// Emulation mode flag
-};
+class TraceLogger;
 
 enum PFlags
 {
@@ -29,11 +18,23 @@ enum PFlags
 	N = 0x80   // Negative
 };
 
+enum InterruptLine : uint8_t
+{
+	InterruptNmi = 0x01,	// Edge triggered, cleared when taken
+	InterruptIrq = 0x02		// Level triggered, held until the source is acknowledged
+};
+
 class CPU
 {
+	CpuState ownState;	// Used unless constructed on an external arena
 public:
 	CPU();
+	explicit CPU(CpuState& state);
+	CPU(const CPU&) = delete;
+	CPU& operator=(const CPU&) = delete;
+	void reset();
 	void run();
+	void runUntil(uint64_t cycle);
 	void step();
 	void setFlag(PFlags flag, bool enabled);
 	bool isAccumulator8Bit();
@@ -41,18 +42,42 @@ public:
 	uint8_t fetch8();
 	uint16_t fetch16();
 	uint32_t fetch24();
+	bool hasHandler(uint8_t opcode) const;
+	void setA(uint16_t value);
+	void setIndex(uint16_t& index, uint16_t value);
+	void updateRegisterSizes();
+
+	void raiseNmi() { pendingInterrupts |= InterruptNmi; }
+	void setIrq(bool asserted);
+	void push8(uint8_t value);
+	void push16(uint16_t value);
+	uint8_t pull8();
+	uint16_t pull16();
+
+	// Views of the CpuState the CPU was constructed on
+	Registers& registers;
+	uint64_t& cycles;				// Master clock cycles elapsed
+	uint8_t& pendingInterrupts;		// InterruptLine bits, checked once per instruction
+	bool& running;
 
-	Registers registers = {};
 	MemoryMap* memory;
-	bool running = false;
+	TraceLogger* tracer = nullptr;
+	uint64_t instructions = 0;		// Retired, for metrics
+	uint64_t windowFetches = 0;		// Instruction bytes served from the code window
+	PhaseProfiler* profiler = nullptr;
 private:
 	using OpcodeHandler = void(*)(CPU&);
 	std::array<OpcodeHandler, 256> opcodeTable;
 
+	// Current instruction fetch window, valid for one PBR and map generation
+	CodeWindow code = {};
+	uint8_t codeBank = 0;
+	uint32_t codeGeneration = 0;
+
 	void setDefaultFlags();
-	void setA(uint16_t value);
-	void setIndex(uint16_t& index, uint16_t value);
-	void updateRegisterSizes();
+	void refreshCode();
+	bool serviceInterrupts();
+	void interrupt(uint16_t nativeVector, uint16_t emulationVector);
 
 	friend void register_opcodes(CPU&);
 };
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "debugger.h"
+#include "cpu.h"
+
+void Debugger::attach(CPU& target)
+{
+	detach();
+	cpu = &target;
+	memory = target.memory;
+	memory->debugger = this;
+	updatePageFlags();
+}
+
+void Debugger::detach()
+{
+	if (memory)
+	{
+		memory->clearPageFlags();
+		memory->debugger = nullptr;
+	}
+	cpu = nullptr;
+	memory = nullptr;
+}
+
+uint32_t Debugger::addBreakpoint(uint32_t pc)
+{
+	Watchpoint watch;
+	watch.start = pc & 0xFFFFFF;
+	watch.end = pc & 0xFFFFFF;
+	watch.kinds = WatchExec;
+	return add(watch);
+}
+
+uint32_t Debugger::addWatchpoint(uint32_t start, uint32_t end, uint8_t kinds)
+{
+	Watchpoint watch;
+	watch.start = start & 0xFFFFFF;
+	watch.end = end & 0xFFFFFF;
+	watch.kinds = kinds;
+	return add(watch);
+}
+
+uint32_t Debugger::addWatchpoint(uint32_t start, uint32_t end, uint8_t kinds, uint8_t value, uint8_t mask)
+{
+	Watchpoint watch;
+	watch.start = start & 0xFFFFFF;
+	watch.end = end & 0xFFFFFF;
+	watch.kinds = kinds;
+	watch.value = value;
+	watch.mask = mask;
+	return add(watch);
+}
+
+uint32_t Debugger::add(const Watchpoint& watch)
+{
+	watches.push_back(watch);
+	watches.back().id = nextId++;
+	updatePageFlags();
+	return watches.back().id;
+}
+
+bool Debugger::remove(uint32_t id)
+{
+	for (auto it = watches.begin(); it != watches.end(); ++it)
+	{
+		if (it->id == id)
+		{
+			watches.erase(it);
+			updatePageFlags();
+			return true;
+		}
+	}
+	return false;
+}
+
+void Debugger::clear()
+{
+	watches.clear();
+	hits.clear();
+	resumePending = false;
+	updatePageFlags();
+}
+
+bool Debugger::onExec(uint32_t address, uint8_t opcode)
+{
+	if (resumePending && address == resumeAddress && cpu->cycles == resumeCycle)
+	{
+		resumePending = false;
+		return false;
+	}
+	resumePending = false;
+
+	if (!check(WatchExec, address, opcode))
+		return false;
+
+	resumeAddress = address;
+	resumeCycle = cpu->cycles;
+	resumePending = true;
+	return true;
+}
+
+void Debugger::onRead(uint32_t address, uint8_t value)
+{
+	if (check(WatchRead, address, value))
+		cpu->running = false;
+}
+
+void Debugger::onWrite(uint32_t address, uint8_t value)
+{
+	if (check(WatchWrite, address, value))
+		cpu->running = false;
+}
+
+bool Debugger::check(WatchKind kind, uint32_t address, uint8_t value)
+{
+	address &= 0xFFFFFF;
+	bool stop = false;
+	for (const Watchpoint& watch : watches)
+	{
+		if (!(watch.kinds & kind) || address < watch.start || address > watch.end)
+			continue;
+		if ((value & watch.mask) != (watch.value & watch.mask))
+			continue;
+
+		DebugHit hit;
+		hit.id = watch.id;
+		hit.kind = kind;
+		hit.address = address;
+		hit.value = value;
+		hit.cycle = cpu->cycles;
+		hits.push_back(hit);
+		stop |= watch.stop;
+	}
+	return stop;
+}
+
+void Debugger::updatePageFlags()
+{
+	if (!memory)
+		return;
+
+	memory->clearPageFlags();
+	for (const Watchpoint& watch : watches)
+		memory->setPageFlags(watch.start, watch.end, watch.kinds);
+}
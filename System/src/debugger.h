@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class CPU;
+class MemoryMap;
+
+enum WatchKind : uint8_t
+{
+	WatchExec	= 0x01,
+	WatchRead	= 0x02,
+	WatchWrite	= 0x04
+};
+
+struct Watchpoint
+{
+	uint32_t id = 0;
+	uint32_t start = 0;		// 24-bit, inclusive
+	uint32_t end = 0;
+	uint8_t kinds = 0;		// WatchKind bits
+	uint8_t value = 0;		// Hit only when (byte & mask) == (value & mask)
+	uint8_t mask = 0x00;
+	bool stop = true;		// Halt the CPU after the access
+};
+
+struct DebugHit
+{
+	uint32_t id = 0;
+	WatchKind kind = WatchExec;
+	uint32_t address = 0;
+	uint8_t value = 0;
+	uint64_t cycle = 0;
+};
+
+// Breakpoints and watchpoints. Only memory pages that carry one are flagged in
+// the MemoryMap, so unflagged pages never leave the normal access path.
+// Detaches when destroyed, so it must not outlive the CPU it is attached to.
+class Debugger
+{
+public:
+	Debugger() {}
+	~Debugger() { detach(); }
+	Debugger(const Debugger&) = delete;
+	Debugger& operator=(const Debugger&) = delete;
+
+	void attach(CPU& cpu);
+	void detach();
+
+	uint32_t addBreakpoint(uint32_t pc);
+	uint32_t addWatchpoint(uint32_t start, uint32_t end, uint8_t kinds);
+	uint32_t addWatchpoint(uint32_t start, uint32_t end, uint8_t kinds, uint8_t value, uint8_t mask = 0xFF);
+	uint32_t add(const Watchpoint& watch);
+	bool remove(uint32_t id);
+	void clear();
+
+	bool onExec(uint32_t address, uint8_t opcode);
+	void onRead(uint32_t address, uint8_t value);
+	void onWrite(uint32_t address, uint8_t value);
+
+	std::vector<DebugHit> hits;
+private:
+	bool check(WatchKind kind, uint32_t address, uint8_t value);
+	void updatePageFlags();
+
+	CPU* cpu = nullptr;
+	MemoryMap* memory = nullptr;
+	std::vector<Watchpoint> watches;
+	uint32_t nextId = 1;
+
+	// Resuming from a breakpoint must not trip it again before the instruction runs
+	uint32_t resumeAddress = 0;
+	uint64_t resumeCycle = 0;
+	bool resumePending = false;
+};
@@ -0,0 +1,124 @@
+#include "disassembler.h"
+#include "memory.h"
+#include "text_utils.h"
+
+uint8_t instructionLength(uint8_t opcode, uint8_t p, bool e)
+{
+	bool m8 = e || (p & 0x20);
+	bool x8 = e || (p & 0x10);
+	return uint8_t(1 + operandLength(opcodeInfo[opcode].mode, m8, x8));
+}
+
+namespace
+{
+	struct ModeFormat
+	{
+		const char* prefix;
+		const char* suffix;
+	};
+
+	// Indexed by AddrMode
+	const ModeFormat modeFormats[] =
+	{
+		{ "", "" },			// Implied
+		{ "A", "" },		// Accumulator
+		{ "#$", "" },		// ImmediateM
+		{ "#$", "" },		// ImmediateX
+		{ "#$", "" },		// Immediate8
+		{ "$", "" },		// Relative
+		{ "$", "" },		// RelativeLong
+		{ "$", "" },		// DirectPage
+		{ "$", ",X" },		// DirectPageX
+		{ "$", ",Y" },		// DirectPageY
+		{ "($", ")" },		// DpIndirect
+		{ "($", ",X)" },	// DpIndirectX
+		{ "($", "),Y" },	// DpIndirectY
+		{ "[$", "]" },		// DpIndirectLong
+		{ "[$", "],Y" },	// DpIndirectLongY
+		{ "$", "" },		// Absolute
+		{ "$", ",X" },		// AbsoluteX
+		{ "$", ",Y" },		// AbsoluteY
+		{ "$", "" },		// AbsoluteLong
+		{ "$", ",X" },		// AbsoluteLongX
+		{ "($", ")" },		// AbsoluteIndirect
+		{ "($", ",X)" },	// AbsoluteIndexedIndirect
+		{ "[$", "]" },		// AbsoluteIndirectLong
+		{ "$", ",S" },		// StackRelative
+		{ "($", ",S),Y" },	// StackRelativeIndirectY
+		{ "$", "" },		// BlockMove
+	};
+
+	using text::appendText;
+	using text::appendHex;
+}
+
+size_t disassemble(const uint8_t* bytes, uint32_t pc, uint8_t p, bool e, char* out, size_t size)
+{
+	// Longest line is "JML [$1234]" or "MVN $12,$34" plus a mnemonic; 24 bytes is plenty
+	char text[24];
+	char* cursor = appendText(text, opcodeInfo[bytes[0]].mnemonic);
+
+	const OpcodeInfo& info = opcodeInfo[bytes[0]];
+	uint8_t operands = uint8_t(instructionLength(bytes[0], p, e) - 1);
+	uint32_t value = bytes[1] | (uint32_t(bytes[2]) << 8) | (uint32_t(bytes[3]) << 16);
+	int digits = operands * 2;
+
+	switch (info.mode)
+	{
+	case AddrMode::Relative:
+		value = uint16_t(pc + 2 + int8_t(bytes[1]));
+		digits = 4;
+		break;
+	case AddrMode::RelativeLong:
+		value = uint16_t(pc + 3 + int16_t(value & 0xFFFF));
+		digits = 4;
+		break;
+	case AddrMode::BlockMove:
+		value = (uint32_t(bytes[2]) << 8) | bytes[1];
+		break;
+	default:
+		break;
+	}
+
+	const ModeFormat& format = modeFormats[size_t(info.mode)];
+	if (info.mode != AddrMode::Implied)
+	{
+		*cursor++ = ' ';
+		cursor = appendText(cursor, format.prefix);
+		if (info.mode == AddrMode::BlockMove)
+		{
+			// Source bank is the second operand byte
+			cursor = appendHex(cursor, value >> 8, 2);
+			cursor = appendText(cursor, ",$");
+			cursor = appendHex(cursor, value, 2);
+		}
+		else if (digits)
+		{
+			cursor = appendHex(cursor, value, digits);
+		}
+		cursor = appendText(cursor, format.suffix);
+	}
+
+	size_t n = size_t(cursor - text);
+	if (size == 0)
+		return 0;
+	if (n >= size)
+		n = size - 1;
+	for (size_t i = 0; i < n; ++i)
+		out[i] = text[i];
+	out[n] = '\0';
+	return n;
+}
+
+std::string disassemble(const MemoryMap& memory, uint32_t pc, uint8_t p, bool e)
+{
+	uint8_t bytes[4] = {};
+	bytes[0] = memory.peek(pc);
+	uint8_t length = instructionLength(bytes[0], p, e);
+	for (uint8_t i = 1; i < length; ++i)
+		bytes[i] = memory.peek((pc & 0xFF0000) | uint16_t(pc + i));
+
+	char text[32];
+	size_t n = disassemble(bytes, pc, p, e, text, sizeof(text));
+	return std::string(text, n);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "opcode_info.h"
+#include <cstddef>
+#include <string>
+
+class MemoryMap;
+
+// Instruction length in bytes, opcode included
+uint8_t instructionLength(uint8_t opcode, uint8_t p, bool e);
+
+// Formats the instruction whose bytes start at bytes[0] (the opcode). Returns
+// the number of characters written, not counting the terminator.
+size_t disassemble(const uint8_t* bytes, uint32_t pc, uint8_t p, bool e, char* out, size_t size);
+
+std::string disassemble(const MemoryMap& memory, uint32_t pc, uint8_t p, bool e);
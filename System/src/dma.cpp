@@ -0,0 +1,215 @@
+#include "dma.h"
+#include "cpu.h"
+
+constexpr uint32_t DmaController::CHANNELS;
+constexpr uint32_t DmaController::CLOCKS_PER_BYTE;
+
+namespace
+{
+	// B-bus register offsets written by one unit of each transfer pattern (DMAPn bits 0-2)
+	struct Pattern
+	{
+		uint8_t length;
+		uint8_t offsets[4];
+	};
+
+	const Pattern PATTERNS[8] = {
+		{ 1, { 0, 0, 0, 0 } },
+		{ 2, { 0, 1, 0, 0 } },
+		{ 2, { 0, 0, 0, 0 } },
+		{ 4, { 0, 0, 1, 1 } },
+		{ 4, { 0, 1, 2, 3 } },
+		{ 4, { 0, 1, 0, 1 } },
+		{ 2, { 0, 0, 0, 0 } },
+		{ 4, { 0, 0, 1, 1 } },
+	};
+
+	const uint8_t CONTROL_B_TO_A = 0x80;
+	const uint8_t CONTROL_INDIRECT = 0x40;
+	const uint8_t CONTROL_DECREMENT = 0x10;
+	const uint8_t CONTROL_FIXED = 0x08;
+
+	void setLow(uint16_t& target, uint8_t value) { target = uint16_t((target & 0xFF00) | value); }
+	void setHigh(uint16_t& target, uint8_t value) { target = uint16_t((value << 8) | (target & 0x00FF)); }
+
+	// offset is the register within the channel's $43n0-$43nF block
+	uint8_t readRegister(const DmaChannel& channel, uint8_t offset)
+	{
+		switch (offset)
+		{
+		case 0x0: return channel.control;
+		case 0x1: return channel.bAddress;
+		case 0x2: return uint8_t(channel.aAddress);
+		case 0x3: return uint8_t(channel.aAddress >> 8);
+		case 0x4: return channel.aBank;
+		case 0x5: return uint8_t(channel.count);
+		case 0x6: return uint8_t(channel.count >> 8);
+		case 0x7: return channel.indirectBank;
+		case 0x8: return uint8_t(channel.tableAddress);
+		case 0x9: return uint8_t(channel.tableAddress >> 8);
+		case 0xA: return channel.lineCounter;
+		default: return channel.unused;
+		}
+	}
+
+	void writeRegister(DmaChannel& channel, uint8_t offset, uint8_t value)
+	{
+		switch (offset)
+		{
+		case 0x0: channel.control = value; break;
+		case 0x1: channel.bAddress = value; break;
+		case 0x2: setLow(channel.aAddress, value); break;
+		case 0x3: setHigh(channel.aAddress, value); break;
+		case 0x4: channel.aBank = value; break;
+		case 0x5: setLow(channel.count, value); break;
+		case 0x6: setHigh(channel.count, value); break;
+		case 0x7: channel.indirectBank = value; break;
+		case 0x8: setLow(channel.tableAddress, value); break;
+		case 0x9: setHigh(channel.tableAddress, value); break;
+		case 0xA: channel.lineCounter = value; break;
+		default: channel.unused = value; break;
+		}
+	}
+}
+
+DmaController::DmaController() : DmaController(ownState)
+{
+
+}
+
+DmaController::DmaController(DmaState& target) : state(target)
+{
+	state = DmaState();
+	for (auto& channel : state.channels)
+		channel.finished = 1;
+}
+
+void DmaController::attach(CPU& target, IoDispatcher& dispatcher, MemoryMap& map)
+{
+	cpu = &target;
+	io = &dispatcher;
+	memory = &map;
+
+	// MDMAEN
+	io->registerWrite(0x420B, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static_cast<DmaController*>(ctx)->transfer(value);
+	}, this);
+	// HDMAEN
+	io->registerWrite(0x420C, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static_cast<DmaController*>(ctx)->state.hdmaEnable = value;
+	}, this);
+
+	for (uint16_t address = 0x4300; address <= 0x437F; ++address)
+	{
+		io->registerWrite(address, [](void* ctx, uint16_t port, uint8_t value)
+		{
+			DmaController& dma = *static_cast<DmaController*>(ctx);
+			writeRegister(dma.state.channels[(port >> 4) & 7], port & 0x0F, value);
+		}, this);
+		io->registerRead(address, [](void* ctx, uint16_t port) -> uint8_t
+		{
+			DmaController& dma = *static_cast<DmaController*>(ctx);
+			return readRegister(dma.state.channels[(port >> 4) & 7], port & 0x0F);
+		}, this);
+	}
+}
+
+void DmaController::transfer(uint8_t mask)
+{
+	uint64_t clocks = 0;
+	for (uint32_t i = 0; i < CHANNELS; ++i)
+	{
+		if (!(mask & (1 << i)))
+			continue;
+
+		DmaChannel& channel = state.channels[i];
+		const Pattern& pattern = PATTERNS[channel.control & 7];
+		uint32_t remaining = channel.count ? channel.count : 0x10000;
+		for (uint32_t unit = 0; remaining; ++unit)
+		{
+			uint8_t port = uint8_t(channel.bAddress + pattern.offsets[unit % pattern.length]);
+			uint32_t address = (uint32_t(channel.aBank) << 16) | channel.aAddress;
+			if (channel.control & CONTROL_B_TO_A)
+				memory->write(address, io->read(uint16_t(0x2100 | port), 0));
+			else
+				io->write(uint16_t(0x2100 | port), read(address));
+
+			if (!(channel.control & CONTROL_FIXED))
+				channel.aAddress = uint16_t(channel.aAddress + ((channel.control & CONTROL_DECREMENT) ? -1 : 1));
+			--remaining;
+			clocks += CLOCKS_PER_BYTE;
+		}
+		channel.count = 0;
+		clocks += CLOCKS_PER_BYTE;
+	}
+
+	if (cpu)
+		cpu->cycles += clocks;
+}
+
+void DmaController::startFrame()
+{
+	for (uint32_t i = 0; i < CHANNELS; ++i)
+	{
+		DmaChannel& channel = state.channels[i];
+		channel.finished = 1;
+		if (!(state.hdmaEnable & (1 << i)))
+			continue;
+
+		channel.tableAddress = channel.aAddress;
+		channel.finished = 0;
+		loadLine(channel);
+	}
+}
+
+void DmaController::hblank()
+{
+	for (uint32_t i = 0; i < CHANNELS; ++i)
+	{
+		DmaChannel& channel = state.channels[i];
+		if (!(state.hdmaEnable & (1 << i)) || channel.finished)
+			continue;
+
+		if (channel.doTransfer)
+		{
+			const Pattern& pattern = PATTERNS[channel.control & 7];
+			for (uint32_t unit = 0; unit < pattern.length; ++unit)
+			{
+				uint32_t address;
+				if (channel.control & CONTROL_INDIRECT)
+					address = (uint32_t(channel.indirectBank) << 16) | channel.count++;
+				else
+					address = (uint32_t(channel.aBank) << 16) | channel.tableAddress++;
+				io->write(uint16_t(0x2100 | uint8_t(channel.bAddress + pattern.offsets[unit])), read(address));
+			}
+		}
+
+		// Bit 7 repeats the transfer on every line of the entry rather than just the first
+		--channel.lineCounter;
+		channel.doTransfer = channel.lineCounter & 0x80;
+		if (!(channel.lineCounter & 0x7F))
+			loadLine(channel);
+	}
+}
+
+void DmaController::loadLine(DmaChannel& channel)
+{
+	uint32_t bank = uint32_t(channel.aBank) << 16;
+	channel.lineCounter = read(bank | channel.tableAddress++);
+	if (channel.control & CONTROL_INDIRECT)
+	{
+		uint8_t low = read(bank | channel.tableAddress++);
+		uint8_t high = read(bank | channel.tableAddress++);
+		channel.count = uint16_t(low | (high << 8));
+	}
+	channel.doTransfer = 1;
+	if (!channel.lineCounter)
+		channel.finished = 1;
+}
+
+uint8_t DmaController::read(uint32_t address)
+{
+	return memory->read(address);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "io.h"
+#include "memory.h"
+#include "machine_state.h"
+#include <cstdint>
+
+class CPU;
+
+// The 5A22's eight DMA channels: registers at $4300-$437F, general purpose
+// transfers started by MDMAEN ($420B) and per-line HDMA enabled by HDMAEN
+// ($420C). The frame loop calls startFrame() before line 0 and hblank() at
+// the end of each visible line, so HDMA writes land between rendered lines.
+class DmaController
+{
+	DmaState ownState;	// Used unless constructed on an external arena
+public:
+	static constexpr uint32_t CHANNELS = 8;
+	static constexpr uint32_t CLOCKS_PER_BYTE = 8;
+
+	DmaController();
+	explicit DmaController(DmaState& state);
+	DmaController(const DmaController&) = delete;
+	DmaController& operator=(const DmaController&) = delete;
+
+	void attach(CPU& cpu, IoDispatcher& io, MemoryMap& memory);
+
+	void startFrame();
+	void hblank();
+
+	// Runs the channels set in mask to completion, stalling the CPU for the transfer
+	void transfer(uint8_t mask);
+
+	DmaState& state;
+private:
+	uint8_t read(uint32_t address);
+	void loadLine(DmaChannel& channel);
+
+	CPU* cpu = nullptr;
+	IoDispatcher* io = nullptr;
+	MemoryMap* memory = nullptr;
+};
@@ -0,0 +1,74 @@
+#include "emulation_thread.h"
+
+EmulationThread::EmulationThread(System& target)
+	: system(target), frames(VideoFrame{ std::vector<uint16_t>(PPU::WIDTH * PPU::HEIGHT, 0), 0 })
+{
+
+}
+
+EmulationThread::~EmulationThread()
+{
+	stop();
+}
+
+void EmulationThread::start(bool paced)
+{
+	if (worker.joinable())
+		return;
+	stopRequested = false;
+	active = true;
+	worker = std::thread(&EmulationThread::loop, this, paced);
+}
+
+void EmulationThread::stop()
+{
+	stopRequested = true;
+	if (worker.joinable())
+		worker.join();
+}
+
+bool EmulationThread::pushInput(uint8_t port, uint16_t buttons)
+{
+	InputEvent event;
+	event.port = port;
+	event.buttons = buttons;
+	return input.push(event);
+}
+
+bool EmulationThread::pollFrame()
+{
+	return frames.poll();
+}
+
+PacerStats EmulationThread::pacerStats() const
+{
+	return worker.joinable() ? PacerStats() : pacer.stats();
+}
+
+void EmulationThread::loop(bool paced)
+{
+	if (paced)
+		pacer.start();
+
+	while (!stopRequested.load(std::memory_order_acquire) && system.running())
+	{
+		InputEvent event;
+		while (input.pop(event))
+			system.setInput(event.port, event.buttons);
+
+		system.runFrame();
+
+		VideoFrame& out = frames.back();
+		const std::vector<uint16_t>& pixels = system.framebuffer();
+		std::copy(pixels.begin(), pixels.end(), out.pixels.begin());
+		out.number = system.frameCount();
+		frames.publish();
+		if (post)
+			post->submit(pixels.data(), out.number);
+		completed.fetch_add(1, std::memory_order_release);
+
+		if (paced)
+			pacer.wait();
+	}
+	active = false;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "system.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+#include "frame_pacer.h"
+#include "post_process.h"
+#include <atomic>
+#include <thread>
+
+struct InputEvent
+{
+	uint8_t port = 0;
+	uint16_t buttons = 0;
+};
+
+struct VideoFrame
+{
+	std::vector<uint16_t> pixels;	// BGR555, PPU::WIDTH * PPU::HEIGHT
+	uint64_t number = 0;
+};
+
+// Runs a System on its own thread. The embedding application queues input and
+// polls for the newest frame without taking locks; the thread owns the System
+// between start() and stop().
+class EmulationThread
+{
+public:
+	explicit EmulationThread(System& system);
+	~EmulationThread();
+	EmulationThread(const EmulationThread&) = delete;
+	EmulationThread& operator=(const EmulationThread&) = delete;
+
+	void start(bool paced = true);
+	void stop();
+	bool running() const { return active.load(std::memory_order_acquire); }
+
+	// Also hands every frame to a started PostProcessor; set while stopped
+	void setPostProcessor(PostProcessor* processor) { post = processor; }
+
+	// Application thread only
+	bool pushInput(uint8_t port, uint16_t buttons);
+	bool pollFrame();
+	const VideoFrame& frame() const { return frames.front(); }
+
+	uint64_t framesRun() const { return completed.load(std::memory_order_acquire); }
+	PacerStats pacerStats() const;	// Valid after stop()
+private:
+	void loop(bool paced);
+
+	System& system;
+	SpscQueue<InputEvent, 64> input;
+	TripleBuffer<VideoFrame> frames;
+	FramePacer pacer;
+	PostProcessor* post = nullptr;
+	std::thread worker;
+	std::atomic<bool> active{ false };
+	std::atomic<bool> stopRequested{ false };
+	std::atomic<uint64_t> completed{ 0 };
+};
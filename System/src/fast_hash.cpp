@@ -0,0 +1,208 @@
+#include "fast_hash.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FASTHASH_SSE2 1
+#endif
+
+namespace
+{
+	const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+	const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+	const uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+	const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+	const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+	const uint32_t PRIME32_1 = 0x9E3779B1u;
+	const uint32_t PRIME32_2 = 0x85EBCA77u;
+	const uint32_t PRIME32_3 = 0xC2B2AE3Du;
+
+	const size_t LANES = 8;
+	const size_t STRIPE = LANES * sizeof(uint64_t);
+	const size_t STRIPES_PER_BLOCK = 16;
+
+	struct Keys
+	{
+		uint64_t stripe[LANES];
+		uint64_t merge[LANES];
+	};
+
+	uint64_t rotl(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	uint64_t read64(const uint8_t* bytes)
+	{
+		uint64_t value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	// Low and high halves of the full 128-bit product, xor-folded
+	uint64_t foldedMultiply(uint64_t a, uint64_t b)
+	{
+		uint64_t aLo = uint32_t(a), aHi = a >> 32;
+		uint64_t bLo = uint32_t(b), bHi = b >> 32;
+		uint64_t lolo = aLo * bLo;
+		uint64_t hilo = aHi * bLo;
+		uint64_t lohi = aLo * bHi;
+		uint64_t hihi = aHi * bHi;
+		uint64_t cross = (lolo >> 32) + uint32_t(hilo) + lohi;
+		uint64_t high = hihi + (hilo >> 32) + (cross >> 32);
+		uint64_t low = (cross << 32) | uint32_t(lolo);
+		return low ^ high;
+	}
+
+	uint64_t avalanche(uint64_t h)
+	{
+		h ^= h >> 37;
+		h *= 0x165667919E3779F9ull;
+		return h ^ (h >> 32);
+	}
+
+	Keys makeKeys(uint64_t seed)
+	{
+		Keys keys;
+		const uint64_t primes[] = { PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME64_5 };
+		for (size_t i = 0; i < LANES; ++i)
+		{
+			uint64_t base = rotl(primes[i % 5] * (i + 1), int(7 * i + 5));
+			keys.stripe[i] = (i & 1) ? base - seed : base + seed;
+			keys.merge[i] = rotl(base ^ PRIME64_4, 29) + seed;
+		}
+		return keys;
+	}
+
+	void initLanes(uint64_t* acc)
+	{
+		const uint64_t init[LANES] = { PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1 };
+		std::memcpy(acc, init, sizeof(init));
+	}
+
+	void accumulateScalar(uint64_t* acc, const uint8_t* stripe, const Keys& keys)
+	{
+		for (size_t i = 0; i < LANES; ++i)
+		{
+			uint64_t data = read64(stripe + i * 8);
+			uint64_t keyed = data ^ keys.stripe[i];
+			acc[i ^ 1] += data;
+			acc[i] += uint64_t(uint32_t(keyed)) * (keyed >> 32);
+		}
+	}
+
+	void scrambleScalar(uint64_t* acc, const Keys& keys)
+	{
+		for (size_t i = 0; i < LANES; ++i)
+		{
+			uint64_t value = acc[i];
+			value ^= value >> 47;
+			value ^= keys.stripe[i];
+			acc[i] = value * PRIME32_1;
+		}
+	}
+
+#ifdef FASTHASH_SSE2
+	void accumulateSse2(__m128i* acc, const uint8_t* stripe, const __m128i* keys)
+	{
+		for (size_t i = 0; i < LANES / 2; ++i)
+		{
+			__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stripe) + i);
+			__m128i keyed = _mm_xor_si128(data, keys[i]);
+			__m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+			__m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+			acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(product, swapped));
+		}
+	}
+
+	void scrambleSse2(__m128i* acc, const __m128i* keys)
+	{
+		const __m128i prime = _mm_set1_epi32(int(PRIME32_1));
+		for (size_t i = 0; i < LANES / 2; ++i)
+		{
+			__m128i value = acc[i];
+			value = _mm_xor_si128(value, _mm_srli_epi64(value, 47));
+			value = _mm_xor_si128(value, keys[i]);
+			__m128i low = _mm_mul_epu32(value, prime);
+			__m128i high = _mm_mul_epu32(_mm_srli_epi64(value, 32), prime);
+			acc[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+		}
+	}
+#endif
+
+	uint64_t finish(uint64_t* acc, const uint8_t* bytes, size_t size, size_t done, const Keys& keys, void (*accumulate)(uint64_t*, const uint8_t*, const Keys&))
+	{
+		// The remainder is zero-padded to a whole stripe; the length goes into the merge
+		uint8_t last[STRIPE] = {};
+		std::memcpy(last, bytes + done, size - done);
+		accumulate(acc, last, keys);
+
+		uint64_t result = uint64_t(size) * PRIME64_1;
+		for (size_t i = 0; i < LANES; i += 2)
+			result += foldedMultiply(acc[i] ^ keys.merge[i], acc[i + 1] ^ keys.merge[i + 1]);
+		return avalanche(result);
+	}
+}
+
+namespace fasthash
+{
+	uint64_t hashScalar(const void* data, size_t size, uint64_t seed)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		Keys keys = makeKeys(seed);
+		uint64_t acc[LANES];
+		initLanes(acc);
+
+		size_t done = 0;
+		size_t stripes = 0;
+		for (; size - done >= STRIPE; done += STRIPE)
+		{
+			accumulateScalar(acc, bytes + done, keys);
+			if (++stripes % STRIPES_PER_BLOCK == 0)
+				scrambleScalar(acc, keys);
+		}
+		return finish(acc, bytes, size, done, keys, accumulateScalar);
+	}
+
+	uint64_t hash(const void* data, size_t size, uint64_t seed)
+	{
+#ifdef FASTHASH_SSE2
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		Keys keys = makeKeys(seed);
+		uint64_t lanes[LANES];
+		initLanes(lanes);
+
+		__m128i acc[LANES / 2];
+		__m128i stripeKeys[LANES / 2];
+		for (size_t i = 0; i < LANES / 2; ++i)
+		{
+			acc[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes) + i);
+			stripeKeys[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys.stripe) + i);
+		}
+
+		size_t done = 0;
+		size_t stripes = 0;
+		for (; size - done >= STRIPE; done += STRIPE)
+		{
+			accumulateSse2(acc, bytes + done, stripeKeys);
+			if (++stripes % STRIPES_PER_BLOCK == 0)
+				scrambleSse2(acc, stripeKeys);
+		}
+
+		for (size_t i = 0; i < LANES / 2; ++i)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes) + i, acc[i]);
+		return finish(lanes, bytes, size, done, keys, accumulateScalar);
+#else
+		return hashScalar(data, size, seed);
+#endif
+	}
+
+	bool simd()
+	{
+#ifdef FASTHASH_SSE2
+		return true;
+#else
+		return false;
+#endif
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit non-cryptographic hash in the xxHash3 style: eight 64-bit lanes take
+// 64-byte stripes with a 32x32->64 multiply per lane, scrambled every 1 KiB and
+// folded with 128-bit multiplies. SSE2 and scalar paths give identical results.
+// Used for framebuffer and audio comparison, where throughput matters.
+namespace fasthash
+{
+	uint64_t hash(const void* data, size_t size, uint64_t seed = 0);
+	uint64_t hashScalar(const void* data, size_t size, uint64_t seed = 0);
+	bool simd();	// True when hash() runs the SSE2 path
+}
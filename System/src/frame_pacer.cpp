@@ -0,0 +1,52 @@
+#include "frame_pacer.h"
+#include "timing.h"
+#include <thread>
+
+int64_t FramePacer::framePeriodNs()
+{
+	return int64_t(uint64_t(timing::CLOCKS_PER_FRAME_PAIR) * 1000000000ull / (2ull * timing::MASTER_CLOCK_HZ));
+}
+
+void FramePacer::start()
+{
+	origin = clock::now();
+	index = 0;
+	counters = {};
+}
+
+FramePacer::clock::time_point FramePacer::deadline(uint64_t frame) const
+{
+	// Exact in master clocks, so the 60.0988 Hz rate holds over any run length. Computed
+	// in whole seconds plus remainder, so the product cannot overflow on long sessions
+	const uint64_t rate = 2ull * timing::MASTER_CLOCK_HZ;
+	uint64_t clocks = frame * timing::CLOCKS_PER_FRAME_PAIR;
+	uint64_t ns = clocks / rate * 1000000000ull + clocks % rate * 1000000000ull / rate;
+	return origin + std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds(ns));
+}
+
+void FramePacer::wait()
+{
+	clock::time_point target = deadline(++index);
+
+	clock::time_point now = clock::now();
+	if (target - now > spinWindow)
+		std::this_thread::sleep_for(target - now - spinWindow);
+	while ((now = clock::now()) < target)
+		std::this_thread::yield();
+
+	int64_t late = std::chrono::duration_cast<std::chrono::nanoseconds>(now - target).count();
+	++counters.frames;
+	counters.totalLatenessNs += late;
+	if (late > counters.maxLatenessNs)
+		counters.maxLatenessNs = late;
+	if (late > lateTolerance.count())
+		++counters.lateFrames;
+
+	// A stall longer than a frame restarts the schedule rather than running fast to catch up
+	if (late > framePeriodNs())
+	{
+		++counters.resyncs;
+		origin = now;
+		index = 0;
+	}
+}
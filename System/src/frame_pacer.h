@@ -0,0 +1,36 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+struct PacerStats
+{
+	uint64_t frames = 0;
+	uint64_t lateFrames = 0;		// Woke after the deadline by more than the tolerance
+	uint64_t resyncs = 0;			// Fell a whole frame behind and dropped the backlog
+	int64_t maxLatenessNs = 0;
+	int64_t totalLatenessNs = 0;
+};
+
+// Holds a loop to the console's frame rate (master clock over the average frame
+// length, 60.0988 Hz on NTSC). Deadlines are absolute from start() so error does
+// not accumulate; the wait sleeps coarsely and spins the last stretch.
+class FramePacer
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	static int64_t framePeriodNs();
+
+	void start();
+	void wait();
+	const PacerStats& stats() const { return counters; }
+
+	std::chrono::nanoseconds spinWindow = std::chrono::microseconds(1500);
+	std::chrono::nanoseconds lateTolerance = std::chrono::microseconds(250);
+private:
+	clock::time_point deadline(uint64_t index) const;
+
+	clock::time_point origin = {};
+	uint64_t index = 0;
+	PacerStats counters = {};
+};
@@ -0,0 +1,149 @@
+#include "interrupts.h"
+#include "cpu.h"
+#include "timing.h"
+
+InterruptController::InterruptController() : InterruptController(ownState)
+{
+
+}
+
+InterruptController::InterruptController(InterruptState& state)
+	: nmitimen(state.nmitimen), htime(state.htime), vtime(state.vtime), nmiFlag(state.nmiFlag), timeUp(state.timeUp)
+{
+	state = InterruptState();
+	htime = 0x1FF;
+	vtime = 0x1FF;
+}
+
+void InterruptController::attach(CPU& target, IoDispatcher& io, Scheduler& events)
+{
+	cpu = &target;
+	scheduler = &events;
+
+	scheduler->setHandler(Event::VBlankStart, [](void* ctx, uint64_t time)
+	{
+		InterruptController& irq = *static_cast<InterruptController*>(ctx);
+		irq.nmiFlag = true;
+		if (irq.nmitimen & 0x80)
+			irq.cpu->raiseNmi();
+
+		irq.scheduler->schedule(Event::VBlankStart, time + timing::CLOCKS_PER_FRAME);
+		irq.scheduler->schedule(Event::VBlankEnd, time + (timing::SCANLINES_PER_FRAME - VBLANK_LINE) * timing::CLOCKS_PER_SCANLINE);
+	}, this);
+	scheduler->setHandler(Event::VBlankEnd, [](void* ctx, uint64_t)
+	{
+		static_cast<InterruptController*>(ctx)->nmiFlag = false;
+	}, this);
+	scheduler->setHandler(Event::HvTimer, [](void* ctx, uint64_t time)
+	{
+		InterruptController& irq = *static_cast<InterruptController*>(ctx);
+		irq.timeUp = true;
+		irq.cpu->setIrq(true);
+		irq.scheduler->schedule(Event::HvTimer, irq.nextTimerMatch(time));
+	}, this);
+
+	uint64_t vblank = cpu->cycles / timing::CLOCKS_PER_FRAME * timing::CLOCKS_PER_FRAME + VBLANK_LINE * timing::CLOCKS_PER_SCANLINE;
+	if (vblank <= cpu->cycles)
+		vblank += timing::CLOCKS_PER_FRAME;
+	scheduler->schedule(Event::VBlankStart, vblank);
+
+	// NMITIMEN
+	io.registerWrite(0x4200, [](void* ctx, uint16_t, uint8_t value)
+	{
+		InterruptController& irq = *static_cast<InterruptController*>(ctx);
+		bool enablingNmi = (value & 0x80) && !(irq.nmitimen & 0x80);
+		irq.nmitimen = value;
+
+		// Enabling NMI during vblank with the flag still set fires immediately
+		if (enablingNmi && irq.nmiFlag)
+			irq.cpu->raiseNmi();
+		if (!(value & 0x30))
+		{
+			irq.timeUp = false;
+			irq.cpu->setIrq(false);
+		}
+		irq.rescheduleTimer();
+	}, this);
+
+	// HTIMEL/HTIMEH, VTIMEL/VTIMEH
+	io.registerWrite(0x4207, [](void* ctx, uint16_t, uint8_t value)
+	{
+		InterruptController& irq = *static_cast<InterruptController*>(ctx);
+		irq.htime = uint16_t((irq.htime & 0x100) | value);
+		irq.rescheduleTimer();
+	}, this);
+	io.registerWrite(0x4208, [](void* ctx, uint16_t, uint8_t value)
+	{
+		InterruptController& irq = *static_cast<InterruptController*>(ctx);
+		irq.htime = uint16_t(((value & 0x01) << 8) | (irq.htime & 0xFF));
+		irq.rescheduleTimer();
+	}, this);
+	io.registerWrite(0x4209, [](void* ctx, uint16_t, uint8_t value)
+	{
+		InterruptController& irq = *static_cast<InterruptController*>(ctx);
+		irq.vtime = uint16_t((irq.vtime & 0x100) | value);
+		irq.rescheduleTimer();
+	}, this);
+	io.registerWrite(0x420A, [](void* ctx, uint16_t, uint8_t value)
+	{
+		InterruptController& irq = *static_cast<InterruptController*>(ctx);
+		irq.vtime = uint16_t(((value & 0x01) << 8) | (irq.vtime & 0xFF));
+		irq.rescheduleTimer();
+	}, this);
+
+	// RDNMI: reading acknowledges, low bits are the CPU version
+	io.registerRead(0x4210, [](void* ctx, uint16_t) -> uint8_t
+	{
+		InterruptController& irq = *static_cast<InterruptController*>(ctx);
+		uint8_t value = uint8_t((irq.nmiFlag ? 0x80 : 0x00) | 0x02);
+		irq.nmiFlag = false;
+		return value;
+	}, this);
+
+	// TIMEUP: reading acknowledges and releases the IRQ line
+	io.registerRead(0x4211, [](void* ctx, uint16_t) -> uint8_t
+	{
+		InterruptController& irq = *static_cast<InterruptController*>(ctx);
+		uint8_t value = irq.timeUp ? 0x80 : 0x00;
+		irq.timeUp = false;
+		irq.cpu->setIrq(false);
+		return value;
+	}, this);
+}
+
+uint64_t InterruptController::nextTimerMatch(uint64_t after) const
+{
+	uint32_t mode = (nmitimen >> 4) & 0x03;
+	uint64_t hClock = uint64_t(htime) * CLOCKS_PER_DOT;
+	bool hValid = hClock < timing::CLOCKS_PER_SCANLINE;
+	bool vValid = vtime < timing::SCANLINES_PER_FRAME;
+
+	switch (mode)
+	{
+	case 1:
+	{
+		// Every line at HTIME
+		if (!hValid)
+			return Scheduler::NEVER;
+		uint64_t time = after / timing::CLOCKS_PER_SCANLINE * timing::CLOCKS_PER_SCANLINE + hClock;
+		return time > after ? time : time + timing::CLOCKS_PER_SCANLINE;
+	}
+	case 2:
+	case 3:
+	{
+		// Once a frame at VTIME, at the start of the line or at HTIME
+		if (!vValid || (mode == 3 && !hValid))
+			return Scheduler::NEVER;
+		uint64_t offset = uint64_t(vtime) * timing::CLOCKS_PER_SCANLINE + (mode == 3 ? hClock : 0);
+		uint64_t time = after / timing::CLOCKS_PER_FRAME * timing::CLOCKS_PER_FRAME + offset;
+		return time > after ? time : time + timing::CLOCKS_PER_FRAME;
+	}
+	default:
+		return Scheduler::NEVER;
+	}
+}
+
+void InterruptController::rescheduleTimer()
+{
+	scheduler->schedule(Event::HvTimer, nextTimerMatch(cpu->cycles));
+}
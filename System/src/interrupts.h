@@ -0,0 +1,39 @@
+#pragma once
+#include "io.h"
+#include "scheduler.h"
+#include "machine_state.h"
+#include <cstdint>
+
+class CPU;
+
+// The 5A22's interrupt side: NMITIMEN ($4200), HTIME/VTIME ($4207-$420A),
+// RDNMI ($4210) and TIMEUP ($4211). Vblank and H/V timer matches are
+// scheduled events that raise lines on the CPU.
+class InterruptController
+{
+	InterruptState ownState;	// Used unless constructed on an external arena
+public:
+	static constexpr uint32_t VBLANK_LINE = 225;
+	static constexpr uint32_t CLOCKS_PER_DOT = 4;
+
+	InterruptController();
+	explicit InterruptController(InterruptState& state);
+	InterruptController(const InterruptController&) = delete;
+	InterruptController& operator=(const InterruptController&) = delete;
+
+	void attach(CPU& cpu, IoDispatcher& io, Scheduler& scheduler);
+
+	// Master clock at which the next H/V match occurs after the given time
+	uint64_t nextTimerMatch(uint64_t after) const;
+
+	uint8_t& nmitimen;
+	uint16_t& htime;
+	uint16_t& vtime;
+	uint8_t& nmiFlag;	// RDNMI bit 7
+	uint8_t& timeUp;	// TIMEUP bit 7
+private:
+	void rescheduleTimer();
+
+	CPU* cpu = nullptr;
+	Scheduler* scheduler = nullptr;
+};
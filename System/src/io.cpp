@@ -0,0 +1,31 @@
+#include "io.h"
+
+IoDispatcher::IoDispatcher() : pages(1)
+{
+
+}
+
+void IoDispatcher::registerRead(uint16_t address, IoRead handler, void* context)
+{
+	Port& entry = port(address);
+	entry.read = handler;
+	entry.readContext = context;
+}
+
+void IoDispatcher::registerWrite(uint16_t address, IoWrite handler, void* context)
+{
+	Port& entry = port(address);
+	entry.write = handler;
+	entry.writeContext = context;
+}
+
+IoDispatcher::Port& IoDispatcher::port(uint16_t address)
+{
+	uint8_t& slot = pageSlot[(address - START) >> 8];
+	if (slot == 0)
+	{
+		slot = uint8_t(pages.size());
+		pages.emplace_back();
+	}
+	return pages[slot].ports[address & 0xFF];
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <vector>
+
+using IoRead = uint8_t(*)(void* context, uint16_t address);
+using IoWrite = void(*)(void* context, uint16_t address, uint8_t value);
+
+// Dispatcher for the $2000-$5FFF register area. Components register a handler
+// per register at init; every bank mirror resolves with a single table lookup.
+class IoDispatcher
+{
+public:
+	static constexpr uint16_t START = 0x2000;
+	static constexpr uint16_t SIZE = 0x4000;
+
+	IoDispatcher();
+	void registerRead(uint16_t address, IoRead handler, void* context);
+	void registerWrite(uint16_t address, IoWrite handler, void* context);
+
+	static bool contains(uint32_t address)
+	{
+		return !(address & 0x400000) && uint16_t(address - START) < SIZE;
+	}
+
+	uint8_t read(uint16_t address, uint8_t openBus)
+	{
+		const Port& port = pages[pageSlot[(address - START) >> 8]].ports[address & 0xFF];
+		return port.read ? port.read(port.readContext, address) : openBus;
+	}
+
+	void write(uint16_t address, uint8_t value)
+	{
+		const Port& port = pages[pageSlot[(address - START) >> 8]].ports[address & 0xFF];
+		if (port.write)
+			port.write(port.writeContext, address, value);
+	}
+private:
+	struct Port
+	{
+		IoRead read = nullptr;
+		void* readContext = nullptr;
+		IoWrite write = nullptr;
+		void* writeContext = nullptr;
+	};
+	struct Page
+	{
+		std::array<Port, 256> ports = {};
+	};
+
+	Port& port(uint16_t address);
+
+	std::array<uint8_t, SIZE / 256> pageSlot = {};	// Slot 0 is the shared unmapped page
+	std::vector<Page> pages;
+};
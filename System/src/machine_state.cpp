@@ -0,0 +1,99 @@
+#include "machine_state.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+constexpr size_t MachineState::PAGE_COUNT;
+constexpr size_t MachineState::WRAM_SIZE;
+
+void* allocateAligned(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+	void* block = _aligned_malloc(size, alignment);
+#else
+	void* block = nullptr;
+	if (posix_memalign(&block, alignment, size) != 0)
+		block = nullptr;
+#endif
+	if (!block)
+		throw std::bad_alloc();
+	return block;
+}
+
+void freeAligned(void* block)
+{
+#ifdef _WIN32
+	_aligned_free(block);
+#else
+	std::free(block);
+#endif
+}
+
+namespace
+{
+	MachineState* allocateState()
+	{
+		return static_cast<MachineState*>(allocateAligned(sizeof(MachineState), alignof(MachineState)));
+	}
+
+	void freeState(MachineState* state)
+	{
+		freeAligned(state);
+	}
+}
+
+MachineStatePool& MachineStatePool::shared()
+{
+	// Never destroyed, so machines in static storage can still return their arena at exit
+	static MachineStatePool* pool = new MachineStatePool();
+	return *pool;
+}
+
+MachineStatePool::~MachineStatePool()
+{
+	trim();
+}
+
+MachineStatePool::Handle MachineStatePool::acquire()
+{
+	MachineState* state = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!free.empty())
+		{
+			state = free.back();
+			free.pop_back();
+		}
+	}
+	if (!state)
+		state = allocateState();
+
+	// Components write their own power-on values when they bind to the arena
+	std::memset(static_cast<void*>(state), 0, sizeof(MachineState));
+	return Handle(state, Release{ this });
+}
+
+size_t MachineStatePool::idle()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return free.size();
+}
+
+void MachineStatePool::trim()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (MachineState* state : free)
+		freeState(state);
+	free.clear();
+}
+
+void MachineStatePool::release(MachineState* state)
+{
+	if (!state)
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	free.push_back(state);
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include "scheduler.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+// Fixed-length view of an array in the arena, indexed like the vectors it replaced
+template <class T>
+class Span
+{
+public:
+	Span(T* data, size_t size) : first(data), count(size) {}
+	T& operator[](size_t index) const { return first[index]; }
+	T* data() const { return first; }
+	size_t size() const { return count; }
+	T* begin() const { return first; }
+	T* end() const { return first + count; }
+private:
+	T* first;
+	size_t count;
+};
+
+struct Registers
+{
+	uint8_t		P	= 0;	//Processor Status, holds various important flags
+	uint8_t		DBR = 0;	//Data bank register, holds the default bank for memory transfers
+	uint8_t		PBR = 0;	//Program Bank, holds the bank address of all instruction fetches
+	uint16_t	PC	= 0;	//Program counter 
+	uint16_t	A	= 0;	//The accumulator. This is the math register. It stores one of two operands or the result of most arithmetic and logical operations
+	uint16_t	X	= 0;	//The index registers. These can be used to reference memory, to pass data to memory, or as counters for loops
+	uint16_t	Y	= 0;	
+	uint16_t	S	= 0;	//The stack pointer, points to the next available(unused) location on the stack
+	uint16_t	D	= 0;	//Direct page register, used for direct page addressing modes
+	bool		E	= 0;	// Emulation mode flag
+};
+
+struct CpuState
+{
+	Registers registers;
+	uint64_t cycles = 0;			// Master clock cycles elapsed
+	uint8_t pendingInterrupts = 0;	// InterruptLine bits, checked once per instruction
+	bool running = false;
+};
+
+// Port latches and counters, the part of the PPU that is not a memory array
+struct PpuLatches
+{
+	uint16_t vramAddress;
+	uint16_t vramLatch;
+	uint16_t oamAddress;		// Byte address, 10 bits
+	uint8_t vramStep;
+	uint8_t vramRemap;
+	uint8_t vramIncrementHigh;
+	uint8_t cgramAddress;
+	uint8_t cgramLatch;
+	uint8_t cgramHigh;
+	uint8_t oamLatch;
+	uint8_t forcedBlank;
+	uint8_t brightness;
+	uint8_t bgMode;			// BGMODE bits 0-2
+	uint8_t mainScreen;		// TM layer enables
+	uint8_t setini;			// SETINI, bit 6 enables EXTBG
+	uint8_t m7sel;			// Screen over (bits 6-7), V flip (bit 1), H flip (bit 0)
+	uint8_t m7latch;		// Write-twice latch shared by the mode 7 registers and BG1 scroll
+	uint8_t obsel;			// Sprite sizes (bits 5-7), name gap (bits 3-4), name base (bits 0-2)
+	uint8_t objFlags;		// STAT77 range over (bit 6) and time over (bit 7), cleared each frame
+	uint8_t oamPriority;	// OAMADDH bit 7: sprite evaluation starts at oamReload
+	uint16_t oamReload;		// OAM byte address last written through OAMADD
+	uint16_t m7a;			// Matrix, signed 8.8 fixed point
+	uint16_t m7b;
+	uint16_t m7c;
+	uint16_t m7d;
+	uint16_t m7x;			// Center, signed 13 bits
+	uint16_t m7y;
+	uint16_t m7hofs;		// Scroll, signed 13 bits
+	uint16_t m7vofs;
+	uint16_t fixedColor;	// COLDATA, BGR555
+	uint8_t subScreen;		// TS layer enables
+	uint8_t mainWindow;		// TMW: layers masked by their window on the main screen
+	uint8_t subWindow;		// TSW
+	uint8_t windowSel[3];	// W12SEL, W34SEL, WOBJSEL: a nibble per layer, OBJ then color last
+	uint8_t windowEdge[4];	// WH0-WH3: window 1 left/right, window 2 left/right
+	uint8_t windowLogic[2];	// WBGLOG, WOBJLOG: OR/AND/XOR/XNOR per layer
+	uint8_t cgwsel;			// Clip to black (bits 6-7), prevent math (bits 4-5), add sub screen (bit 1)
+	uint8_t cgadsub;		// Subtract (bit 7), half (bit 6), math per layer (bits 0-5)
+};
+
+struct PpuState
+{
+	PpuLatches latches;
+	alignas(64) uint16_t cgram[256];	// BGR555 colors
+	alignas(64) uint8_t oam[544];		// 512 byte low table + 32 byte high table
+	alignas(64) uint16_t vram[0x8000];	// 32K words
+};
+
+struct InterruptState
+{
+	uint16_t htime;
+	uint16_t vtime;
+	uint8_t nmitimen;
+	uint8_t nmiFlag;	// RDNMI bit 7
+	uint8_t timeUp;		// TIMEUP bit 7
+};
+
+struct IoState
+{
+	InterruptState interrupts;
+	std::array<uint16_t, 4> joypads;
+};
+
+struct DmaChannel
+{
+	uint8_t control;		// DMAPn: direction, HDMA indirect, address step, transfer pattern
+	uint8_t bAddress;		// BBADn, $21xx register
+	uint16_t aAddress;		// A1TnL/H
+	uint8_t aBank;			// A1Bn
+	uint8_t indirectBank;	// DASBn
+	uint16_t count;			// DASnL/H: byte count, or the HDMA indirect address
+	uint16_t tableAddress;	// A2AnL/H, HDMA table position
+	uint8_t lineCounter;	// NLTRn
+	uint8_t unused;			// $43nB/$43nF
+	uint8_t doTransfer;
+	uint8_t finished;		// HDMA table ended for this frame
+};
+
+struct DmaState
+{
+	DmaChannel channels[8];
+	uint8_t hdmaEnable;		// HDMAEN
+};
+
+struct TimingState
+{
+	uint64_t frame;
+	uint64_t frameStart;				// Master clock at the start of the current frame
+	uint64_t events[size_t(Event::Count)];	// Scheduler deadlines
+};
+
+// Every piece of mutable machine state, in one block. Each group starts on a
+// cache line; the hot, small groups come first and the bulk memories last.
+//
+//     offset   size     contents
+//     0x00000  64       cpu: registers, cycle count, interrupt lines
+//     0x00040  64       timing: frame counters, scheduler deadlines
+//     0x00080  64       io: interrupt latches and joypads
+//     0x000C0  192      dma: channel registers and HDMA progress
+//     0x00180  ~65.4K   ppu: port latches, CGRAM, OAM, VRAM
+//     ...      8K       pageTable: MemoryMap region per 4 KiB page
+//     ...      128K     wram
+//
+// Host pointers (handlers, ROM, framebuffer) stay outside, so a snapshot is a
+// single memcpy between two machines running the same cartridge.
+struct alignas(64) MachineState
+{
+	static constexpr size_t PAGE_COUNT = 1 << 12;
+	static constexpr size_t WRAM_SIZE = 0x20000;
+
+	alignas(64) CpuState cpu;
+	alignas(64) TimingState timing;
+	alignas(64) IoState io;
+	alignas(64) DmaState dma;
+	alignas(64) PpuState ppu;
+	alignas(64) uint16_t pageTable[PAGE_COUNT];
+	alignas(64) uint8_t wram[WRAM_SIZE];
+};
+
+static_assert(std::is_trivially_copyable<MachineState>::value, "MachineState is copied with memcpy");
+static_assert(sizeof(CpuState) <= 64 && sizeof(TimingState) <= 64 && sizeof(IoState) <= 64, "Small groups fit one cache line");
+
+// Heap blocks for the over-aligned state groups; plain new ignores alignas(64) before C++17
+void* allocateAligned(size_t size, size_t alignment);
+void freeAligned(void* block);
+
+// Recycles arenas so short-lived machines (golden runs, pooled sessions) do not
+// fault in fresh pages every time. acquire() hands out zeroed state.
+class MachineStatePool
+{
+public:
+	struct Release
+	{
+		MachineStatePool* pool;
+		void operator()(MachineState* state) const { pool->release(state); }
+	};
+	using Handle = std::unique_ptr<MachineState, Release>;
+
+	static MachineStatePool& shared();
+
+	MachineStatePool() {}
+	~MachineStatePool();
+	MachineStatePool(const MachineStatePool&) = delete;
+	MachineStatePool& operator=(const MachineStatePool&) = delete;
+
+	Handle acquire();
+	size_t idle();
+	void trim();
+private:
+	void release(MachineState* state);
+
+	std::mutex mutex;
+	std::vector<MachineState*> free;
+};
@@ -0,0 +1,407 @@
+#include "media_dump.h"
+#include "system.h"
+#include "timing.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+constexpr size_t DumpFile::ALIGNMENT;
+constexpr size_t MediaDump::QUEUE_FRAMES;
+
+namespace
+{
+	const size_t WAV_HEADER = 44;
+	const size_t MAX_FRAME_SAMPLES = 2048;	// Stereo values; a frame carries about 1070
+
+	size_t alignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	uint64_t gcd(uint64_t a, uint64_t b)
+	{
+		while (b)
+		{
+			uint64_t r = a % b;
+			a = b;
+			b = r;
+		}
+		return a;
+	}
+
+	void put16(uint8_t* out, uint32_t value)
+	{
+		out[0] = uint8_t(value);
+		out[1] = uint8_t(value >> 8);
+	}
+
+	void put32(uint8_t* out, uint32_t value)
+	{
+		put16(out, value);
+		put16(out + 2, value >> 16);
+	}
+
+	void wavHeader(uint8_t* out, uint32_t dataBytes)
+	{
+		std::memcpy(out, "RIFF", 4);
+		put32(out + 4, 36 + dataBytes);
+		std::memcpy(out + 8, "WAVEfmt ", 8);
+		put32(out + 16, 16);
+		put16(out + 20, 1);		// PCM
+		put16(out + 22, 2);
+		put32(out + 24, timing::AUDIO_SAMPLE_RATE);
+		put32(out + 28, timing::AUDIO_SAMPLE_RATE * 4);
+		put16(out + 32, 4);
+		put16(out + 34, 16);
+		std::memcpy(out + 36, "data", 4);
+		put32(out + 40, dataBytes);
+	}
+
+	uint8_t channel(uint16_t color, int shift)
+	{
+		uint32_t c = (color >> shift) & 0x1F;
+		return uint8_t((c << 3) | (c >> 2));
+	}
+}
+
+DumpFile::~DumpFile()
+{
+	close(0);
+}
+
+bool DumpFile::open(const std::string& path, bool direct)
+{
+	close(0);
+	unbuffered = false;
+#ifdef _WIN32
+	DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN | (direct ? FILE_FLAG_NO_BUFFERING : 0);
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, flags, nullptr);
+	if (handle == INVALID_HANDLE_VALUE && direct)
+		handle = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	else
+		unbuffered = direct;
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+	file = intptr_t(handle);
+#else
+	int fd = -1;
+#ifdef O_DIRECT
+	// Filesystems without direct I/O (tmpfs, some network mounts) refuse the flag
+	if (direct)
+		fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+	unbuffered = fd >= 0;
+#endif
+	if (fd < 0)
+		fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+	file = fd;
+#endif
+	return true;
+}
+
+bool DumpFile::write(const uint8_t* data, size_t size)
+{
+	if (file == -1)
+		return false;
+#ifdef _WIN32
+	DWORD written = 0;
+	return WriteFile(HANDLE(file), data, DWORD(size), &written, nullptr) && written == size;
+#else
+	int fd = int(file);
+	while (size)
+	{
+		ssize_t written = ::write(fd, data, size);
+#ifdef O_DIRECT
+		if (written < 0 && errno == EINVAL && unbuffered)
+		{
+			// Accepted at open but not for these writes: carry on buffered
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+			unbuffered = false;
+			continue;
+		}
+#endif
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		data += written;
+		size -= size_t(written);
+	}
+	return true;
+#endif
+}
+
+bool DumpFile::close(uint64_t length)
+{
+	if (file == -1)
+		return true;
+#ifdef _WIN32
+	HANDLE handle = HANDLE(file);
+	LARGE_INTEGER end = {};
+	end.QuadPart = LONGLONG(length);
+	bool ok = SetFilePointerEx(handle, end, nullptr, FILE_BEGIN) && SetEndOfFile(handle);
+	ok = CloseHandle(handle) && ok;
+#else
+	int fd = int(file);
+	bool ok = ftruncate(fd, off_t(length)) == 0;
+	ok = ::close(fd) == 0 && ok;
+#endif
+	file = -1;
+	return ok;
+}
+
+bool MediaDump::Stream::open(const std::string& path, size_t bytes, bool direct)
+{
+	size_t wanted = alignUp(std::max<size_t>(bytes, 1), DumpFile::ALIGNMENT);
+	if (!storage || wanted != capacity)
+	{
+		capacity = wanted;
+		storage.reset(new uint8_t[capacity + DumpFile::ALIGNMENT]);
+		uintptr_t address = reinterpret_cast<uintptr_t>(storage.get());
+		block = storage.get() + (alignUp(address, DumpFile::ALIGNMENT) - address);
+	}
+	used = 0;
+	length = 0;
+	ok = file.open(path, direct);
+	return ok;
+}
+
+void MediaDump::Stream::append(const uint8_t* data, size_t size)
+{
+	while (size)
+	{
+		size_t take = std::min(size, capacity - used);
+		std::memcpy(block + used, data, take);
+		used += take;
+		length += take;
+		data += take;
+		size -= take;
+		if (used == capacity)
+		{
+			ok = file.write(block, capacity) && ok;
+			used = 0;
+		}
+	}
+}
+
+bool MediaDump::Stream::finish()
+{
+	// The tail goes out zero-padded to a whole block, then the file is cut to length
+	size_t padded = alignUp(used, DumpFile::ALIGNMENT);
+	std::memset(block + used, 0, padded - used);
+	if (padded)
+		ok = file.write(block, padded) && ok;
+	used = 0;
+	ok = file.close(length) && ok;
+	return ok;
+}
+
+MediaDump::MediaDump() : records(QUEUE_FRAMES)
+{
+	for (auto& record : records)
+	{
+		record.pixels.resize(PPU::WIDTH * PPU::HEIGHT);
+		record.samples.reserve(MAX_FRAME_SAMPLES);
+	}
+	encoded.reserve(PPU::WIDTH * PPU::HEIGHT * 3 + 6);
+}
+
+MediaDump::~MediaDump()
+{
+	close();
+}
+
+bool MediaDump::open(const DumpSettings& settings)
+{
+	close();
+	config = settings;
+	frames = 0;
+	waits = 0;
+	closing = false;
+	pending = false;
+
+	bool ok = true;
+	if (!config.videoPath.empty())
+		ok = video.open(config.videoPath, config.bufferBytes, config.direct) && ok;
+	if (!config.audioPath.empty())
+		ok = audio.open(config.audioPath, config.bufferBytes, config.direct) && ok;
+	if (!ok)
+	{
+		video.file.close(0);
+		audio.file.close(0);
+		return false;
+	}
+
+	if (video.file.isOpen() && config.video == VideoDump::Y4m)
+	{
+		// Exact NTSC rate: two master clocks per frame pair, reduced
+		uint64_t numerator = 2ull * timing::MASTER_CLOCK_HZ;
+		uint64_t denominator = timing::CLOCKS_PER_FRAME_PAIR;
+		uint64_t divisor = gcd(numerator, denominator);
+		char header[96];
+		int length = std::snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%llu:%llu Ip A8:7 C444\n",
+			PPU::WIDTH, PPU::HEIGHT, (unsigned long long)(numerator / divisor), (unsigned long long)(denominator / divisor));
+		video.append(reinterpret_cast<const uint8_t*>(header), size_t(length));
+	}
+	if (audio.file.isOpen())
+	{
+		// Sizes are filled in by close()
+		uint8_t header[WAV_HEADER] = {};
+		wavHeader(header, 0);
+		audio.append(header, WAV_HEADER);
+	}
+
+	for (auto& record : records)
+		spare.push(&record);
+	writer = std::thread(&MediaDump::loop, this);
+	return true;
+}
+
+void MediaDump::record(const System& system)
+{
+	const std::vector<int16_t>& samples = system.audioSamples();
+	addFrame(system.framebuffer().data(), samples.data(), samples.size());
+}
+
+void MediaDump::addFrame(const uint16_t* pixels, const int16_t* samples, size_t count)
+{
+	if (!isOpen())
+		return;
+
+	// Only a writer a whole queue behind makes the emulation wait; frames are never dropped
+	Record* record = nullptr;
+	if (!spare.pop(record))
+	{
+		++waits;
+		while (!spare.pop(record))
+			std::this_thread::yield();
+	}
+	std::copy(pixels, pixels + record->pixels.size(), record->pixels.begin());
+	record->samples.assign(samples, samples + std::min(count, MAX_FRAME_SAMPLES));
+	filled.push(record);
+	++frames;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		pending = true;
+	}
+	wake.notify_one();
+}
+
+bool MediaDump::close()
+{
+	if (!isOpen())
+		return true;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		closing = true;
+	}
+	wake.notify_one();
+	writer.join();
+
+	bool ok = true;
+	if (video.file.isOpen())
+		ok = video.finish() && ok;
+	if (audio.file.isOpen())
+	{
+		ok = audio.finish() && ok;
+
+		uint8_t header[WAV_HEADER];
+		wavHeader(header, uint32_t(audio.length - WAV_HEADER));
+		FILE* file = std::fopen(config.audioPath.c_str(), "r+b");
+		ok = file && std::fwrite(header, 1, WAV_HEADER, file) == WAV_HEADER && ok;
+		ok = file && std::fclose(file) == 0 && ok;
+	}
+
+	Record* record;
+	while (spare.pop(record)) {}
+	return ok;
+}
+
+DumpStats MediaDump::stats() const
+{
+	DumpStats result;
+	result.frames = frames;
+	result.videoBytes = video.length;
+	result.audioBytes = audio.length;
+	result.waits = waits;
+	result.direct = (config.videoPath.empty() || video.file.direct()) && (config.audioPath.empty() || audio.file.direct());
+	return result;
+}
+
+void MediaDump::loop()
+{
+	for (;;)
+	{
+		Record* record;
+		if (filled.pop(record))
+		{
+			encode(*record);
+			spare.push(record);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(lock);
+		if (closing && filled.empty())
+			return;
+		wake.wait(guard, [this] { return closing || pending; });
+		pending = false;
+	}
+}
+
+void MediaDump::encode(const Record& record)
+{
+	if (video.file.isOpen())
+	{
+		const size_t count = record.pixels.size();
+		encoded.clear();
+		if (config.video == VideoDump::Y4m)
+		{
+			encoded.resize(6 + count * 3);
+			std::memcpy(encoded.data(), "FRAME\n", 6);
+			uint8_t* y = encoded.data() + 6;
+			uint8_t* u = y + count;
+			uint8_t* v = u + count;
+
+			// Integer BT.601 studio range; the bias keeps every sum positive before the shift
+			for (size_t i = 0; i < count; ++i)
+			{
+				int32_t r = channel(record.pixels[i], 0), g = channel(record.pixels[i], 5), b = channel(record.pixels[i], 10);
+				y[i] = uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+				u[i] = uint8_t((-38 * r - 74 * g + 112 * b + 128 + (128 << 8)) >> 8);
+				v[i] = uint8_t((112 * r - 94 * g - 18 * b + 128 + (128 << 8)) >> 8);
+			}
+		}
+		else
+		{
+			encoded.resize(count * 3);
+			for (size_t i = 0; i < count; ++i)
+			{
+				encoded[i * 3] = channel(record.pixels[i], 0);
+				encoded[i * 3 + 1] = channel(record.pixels[i], 5);
+				encoded[i * 3 + 2] = channel(record.pixels[i], 10);
+			}
+		}
+		video.append(encoded.data(), encoded.size());
+	}
+
+	if (audio.file.isOpen())
+	{
+		encoded.resize(record.samples.size() * 2);
+		for (size_t i = 0; i < record.samples.size(); ++i)
+			put16(&encoded[i * 2], uint16_t(record.samples[i]));
+		audio.append(encoded.data(), encoded.size());
+	}
+}
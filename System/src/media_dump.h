@@ -0,0 +1,118 @@
+#pragma once
+#include "spsc_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class System;
+
+enum class VideoDump : uint8_t
+{
+	Y4m,	// YUV4MPEG2, 4:4:4 BT.601, 8:7 pixels at the exact NTSC frame rate
+	RawRgb,	// Headerless RGB24 frames
+};
+
+struct DumpSettings
+{
+	std::string videoPath;				// Empty skips video
+	std::string audioPath;				// Empty skips audio; 16-bit stereo WAV
+	VideoDump video = VideoDump::Y4m;
+	size_t bufferBytes = 4 << 20;		// Per stream, rounded up to DumpFile::ALIGNMENT
+	bool direct = true;					// Bypass the page cache where the platform allows
+};
+
+struct DumpStats
+{
+	uint64_t frames = 0;
+	uint64_t videoBytes = 0;
+	uint64_t audioBytes = 0;
+	uint64_t waits = 0;		// Frames that found every queue slot still in flight
+	bool direct = false;	// Every open stream was written unbuffered
+};
+
+// Sequential output file written in whole aligned blocks: O_DIRECT on POSIX,
+// FILE_FLAG_NO_BUFFERING on Windows, buffered where neither is accepted. The
+// padded tail is trimmed to the real length on close.
+class DumpFile
+{
+public:
+	static constexpr size_t ALIGNMENT = 4096;
+
+	~DumpFile();
+	bool open(const std::string& path, bool direct);
+	bool write(const uint8_t* data, size_t size);	// Aligned data, size a multiple of ALIGNMENT
+	bool close(uint64_t length);
+	bool isOpen() const { return file != -1; }
+	bool direct() const { return unbuffered; }
+private:
+	intptr_t file = -1;
+	bool unbuffered = false;
+};
+
+// Streams frames and audio to disk for later review. Recording only copies the
+// frame into a preallocated slot; encoding and every write happen on a
+// background writer thread. The output depends only on the frames given, so
+// identical runs produce identical files. Hook it up through
+// System::setFrameCallback with record().
+class MediaDump
+{
+public:
+	static constexpr size_t QUEUE_FRAMES = 32;
+
+	MediaDump();
+	~MediaDump();
+	MediaDump(const MediaDump&) = delete;
+	MediaDump& operator=(const MediaDump&) = delete;
+
+	bool open(const DumpSettings& settings);
+	void record(const System& system);
+	void addFrame(const uint16_t* pixels, const int16_t* samples, size_t count);	// Interleaved stereo
+	bool close();	// Drains the queue and finishes the headers; false if any write failed
+	bool isOpen() const { return writer.joinable(); }
+	DumpStats stats() const;	// Valid after close()
+private:
+	struct Record
+	{
+		std::vector<uint16_t> pixels;
+		std::vector<int16_t> samples;
+	};
+
+	struct Stream
+	{
+		DumpFile file;
+		std::unique_ptr<uint8_t[]> storage;
+		uint8_t* block = nullptr;
+		size_t capacity = 0;
+		size_t used = 0;
+		uint64_t length = 0;
+		bool ok = true;
+
+		bool open(const std::string& path, size_t bytes, bool direct);
+		void append(const uint8_t* data, size_t size);
+		bool finish();
+	};
+
+	void loop();
+	void encode(const Record& record);
+
+	DumpSettings config;
+	std::vector<Record> records;
+	SpscQueue<Record*, QUEUE_FRAMES> filled;
+	SpscQueue<Record*, QUEUE_FRAMES> spare;
+	Stream video;
+	Stream audio;
+	std::vector<uint8_t> encoded;	// One frame in the output format
+
+	std::thread writer;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool pending = false;
+	bool closing = false;
+	uint64_t frames = 0;
+	uint64_t waits = 0;
+};
@@ -1,126 +1,326 @@
 #include "memory.h"
+#include "debugger.h"
+#include <algorithm>
+#include <cassert>
+
+constexpr uint32_t MemoryMap::PAGE_SHIFT;
+constexpr uint32_t MemoryMap::PAGE_COUNT;
+constexpr uint16_t MemoryMap::PAGE_UNMAPPED;
+constexpr uint16_t MemoryMap::PAGE_MIXED;
+constexpr uint32_t MemoryMap::PROFILE_SAMPLE_INTERVAL;
+
+MemoryMap::MemoryMap() : MemoryMap(nullptr)
+{
+
+}
+
+MemoryMap::MemoryMap(uint16_t* pageTable) : pages(pageTable ? pageTable : ownPages.data())
+{
+	std::fill(pages, pages + PAGE_COUNT, PAGE_UNMAPPED);
+}
 
 void MemoryMap::map(uint32_t start, uint32_t end, MemoryHandler* handler)
 {
-	MemoryMapEntry entry = { start, end, handler, start };
+	MemoryMapEntry entry = { start, end, handler, start, &coverageSink, &coverageSink, &coverageSink, 0 };
+	uint16_t index = regions.size() < PAGE_MIXED ? uint16_t(regions.size()) : PAGE_MIXED;
 	regions.push_back(entry);
 
-	uint8_t startBank = start >> 16;
-	uint8_t endBank = end >> 16;
-
-	for (uint8_t bank = startBank; bank <= endBank; ++bank)
+	// Earlier regions win, so only pages nothing else reached yet can take the new one
+	const uint32_t pageSize = 1u << PAGE_SHIFT;
+	for (uint32_t page = start >> PAGE_SHIFT; page <= (end >> PAGE_SHIFT) && page < PAGE_COUNT; ++page)
 	{
-		if (!bankLUT[bank])
-			bankLUT[bank] = std::make_unique<std::vector<MemoryMapEntry>>();
-
-		bankLUT[bank]->push_back(entry);
+		if (pages[page] != PAGE_UNMAPPED)
+			continue;
+		uint32_t first = page << PAGE_SHIFT;
+		bool covers = start <= first && end >= first + pageSize - 1;
+		pages[page] = covers ? index : PAGE_MIXED;
 	}
+	invalidate();
+}
 
-	if (regions.size() > 8)
-		useLUT = true;
+void MemoryMap::mapIo(IoDispatcher* dispatcher)
+{
+	io = dispatcher;
+	invalidate();
+}
+
+void MemoryMap::clear()
+{
+	regions.clear();
+	std::fill(pages, pages + PAGE_COUNT, PAGE_UNMAPPED);
+	io = nullptr;
+	invalidate();
 }
 
 uint8_t MemoryMap::read(uint32_t address)
 {
-	if (useLUT)
+	PhaseProfiler::Scope phase(profiler, ProfilePhase::MemoryMap, PROFILE_SAMPLE_INTERVAL);
+	if (pageFlags(address) & WatchRead)
+		return watchedRead(address);
+	return readDirect(address);
+}
+
+uint8_t MemoryMap::fetch(uint32_t address)
+{
+	PhaseProfiler::Scope phase(profiler, ProfilePhase::MemoryMap, PROFILE_SAMPLE_INTERVAL);
+	// Instruction stream: marks executed coverage and bypasses read watchpoints
+	if (io && IoDispatcher::contains(address))
+		return readDirect(address);
+
+	const MemoryMapEntry* entry = find(address);
+	if (entry)
 	{
-		uint8_t bank = address >> 16;
-		for (auto& entry : *bankLUT[bank])
-		{
-			if (address >= entry.start && address <= entry.end)
-			{
-				lastReadData = entry.handler->read(address - entry.base);
-				return lastReadData;
-			}
-		}
+		uint32_t offset = address - entry->base;
+		lastReadData = entry->handler->read(offset);
+		markCoverage(entry->executed, entry->coverageMask, offset);
+		++counters.handlerReads;
 	}
+	return lastReadData;
+}
+
+void MemoryMap::write(uint32_t address, uint8_t value)
+{
+	PhaseProfiler::Scope phase(profiler, ProfilePhase::MemoryMap, PROFILE_SAMPLE_INTERVAL);
+	if (pageFlags(address) & WatchWrite)
+		watchedWrite(address, value);
 	else
+		writeDirect(address, value);
+}
+
+uint8_t MemoryMap::peek(uint32_t address) const
+{
+	// Registers can have read side effects, so they report open bus
+	if (io && IoDispatcher::contains(address))
+		return lastReadData;
+
+	const MemoryMapEntry* entry = find(address);
+	return entry ? entry->handler->read(address - entry->base) : lastReadData;
+}
+
+void MemoryMap::setCoverage(const MemoryHandler* handler, uint8_t* executed, uint8_t* readFrom, uint8_t* writtenTo, uint32_t mask)
+{
+	auto apply = [&](MemoryMapEntry& entry)
 	{
-		for (auto& entry : regions)
-		{
-			if (address >= entry.start && address <= entry.end)
-			{
-				lastReadData = entry.handler->read(address - entry.base);
-				return lastReadData;
-			}
-		}
+		if (entry.handler != handler)
+			return;
+		entry.executed = executed;
+		entry.readFrom = readFrom;
+		entry.writtenTo = writtenTo;
+		entry.coverageMask = mask;
+	};
+
+	for (auto& entry : regions)
+		apply(entry);
+	invalidate();
+}
+
+void MemoryMap::clearCoverage(const MemoryHandler* handler)
+{
+	setCoverage(handler, &coverageSink, &coverageSink, &coverageSink, 0);
+}
+
+void MemoryMap::invalidate()
+{
+	mapGeneration = nextGeneration();
+}
+
+uint32_t MemoryMap::nextGeneration()
+{
+	// Shared across maps so a map rebuilt at the same address never repeats a generation
+	static std::atomic<uint32_t> counter{ 0 };
+	return ++counter;
+}
+
+CodeWindow MemoryMap::codeWindow(uint32_t address) const
+{
+	const uint32_t pageSize = 1u << PAGE_SHIFT;
+	uint32_t pageStart = address & ~(pageSize - 1);
+	uint32_t pageEnd = pageStart + pageSize - 1;
+
+	CodeWindow window;
+	window.start = uint16_t(pageStart);
+	window.length = pageSize;
+
+	if (io && IoDispatcher::contains(pageStart))
+		return window;
+
+	const MemoryMapEntry* entry = find(address);
+	if (!entry)
+		return window;
+
+	uint32_t first = std::max(pageStart, entry->start);
+	uint32_t last = std::min(pageEnd, entry->end);
+	uint32_t offset = first - entry->base;
+	uint32_t available = 0;
+	const uint8_t* bytes = entry->handler->bytesAt(offset, available);
+	if (!bytes || available == 0)
+		return window;
+
+	last = std::min(last, first + available - 1);
+	if (address > last)
+	{
+		// Past the end of the backing store: fetch just this byte through the map
+		window.start = uint16_t(address);
+		window.length = 1;
+		return window;
+	}
+
+	window.bytes = bytes;
+	window.start = uint16_t(first);
+	window.length = last - first + 1;
+	window.executed = entry->executed;
+	window.coverageMask = entry->coverageMask;
+	window.coverageOffset = offset;
+	return window;
+}
+
+void MemoryMap::setPageFlags(uint32_t start, uint32_t end, uint8_t flags)
+{
+	for (uint32_t page = start >> PAGE_SHIFT; page <= (end >> PAGE_SHIFT) && page < PAGE_COUNT; ++page)
+		watchFlags[page] |= flags;
+}
+
+void MemoryMap::clearPageFlags()
+{
+	watchFlags.fill(0);
+}
+
+const MemoryMapEntry* MemoryMap::find(uint32_t address) const
+{
+	uint16_t page = pages[(address >> PAGE_SHIFT) & (PAGE_COUNT - 1)];
+	if (page == PAGE_UNMAPPED)
+		return nullptr;
+	if (page != PAGE_MIXED)
+		return &regions[page];
+
+	for (auto& entry : regions)
+	{
+		if (address >= entry.start && address <= entry.end)
+			return &entry;
+	}
+	return nullptr;
+}
+
+uint8_t MemoryMap::readDirect(uint32_t address)
+{
+	if (io && IoDispatcher::contains(address))
+	{
+		++counters.ioAccesses;
+		lastReadData = io->read(uint16_t(address), lastReadData);
+		return lastReadData;
+	}
+
+	const MemoryMapEntry* entry = find(address);
+	if (entry)
+	{
+		uint32_t offset = address - entry->base;
+		lastReadData = entry->handler->read(offset);
+		markCoverage(entry->readFrom, entry->coverageMask, offset);
+		++counters.handlerReads;
 	}
 	return lastReadData;
 }
 
-void MemoryMap::write(uint32_t address, uint8_t value)
+void MemoryMap::writeDirect(uint32_t address, uint8_t value)
 {
-	if (useLUT)
+	if (io && IoDispatcher::contains(address))
 	{
-		uint8_t bank = address >> 16;
-		for (auto& entry : *bankLUT[bank])
-		{
-			if (address >= entry.start && address <= entry.end)
-			{
-				entry.handler->write(address - entry.base, value);
-				return;
-			}
-		}
+		++counters.ioAccesses;
+		io->write(uint16_t(address), value);
+		return;
 	}
-	else
+
+	const MemoryMapEntry* entry = find(address);
+	if (entry)
 	{
-		for (auto& entry : regions)
-		{
-			if (address >= entry.start && address <= entry.end)
-			{
-				entry.handler->write(address - entry.base, value);
-				return;
-			}
-		}
+		uint32_t offset = address - entry->base;
+		entry->handler->write(offset, value);
+		markCoverage(entry->writtenTo, entry->coverageMask, offset);
+		++counters.handlerWrites;
 	}
 }
 
+uint8_t MemoryMap::watchedRead(uint32_t address)
+{
+	uint8_t value = readDirect(address);
+	if (debugger)
+		debugger->onRead(address, value);
+	return value;
+}
+
+void MemoryMap::watchedWrite(uint32_t address, uint8_t value)
+{
+	writeDirect(address, value);
+	if (debugger)
+		debugger->onWrite(address, value);
+}
+
 uint8_t RAM::read(uint32_t address)
 {
-	return data[address];
+	assert(address < length);
+	return bytes[address];
 }
 
 void RAM::write(uint32_t address, uint8_t value)
 {
-	data[address] = value;
+	assert(address < length);
+	bytes[address] = value;
+}
+
+const uint8_t* RAM::bytesAt(uint32_t offset, uint32_t& available)
+{
+	if (offset >= length)
+		return nullptr;
+	available = uint32_t(length - offset);
+	return bytes + offset;
 }
 
 void RAM::load(size_t size)
 {
-	data = std::vector<uint8_t>(size, 0xFF);
+	owned = std::vector<uint8_t>(size, 0xFF);
+	bytes = owned.data();
+	length = size;
+}
+
+bool RAM::assign(const uint8_t* source, size_t size)
+{
+	if (size != length)
+		return false;
+	std::copy(source, source + size, bytes);
+	return true;
+}
+
+void RAM::fill(uint8_t value)
+{
+	std::fill(bytes, bytes + length, value);
 }
 
 uint8_t ROM::read(uint32_t address)
 {
-	if (address < data.size())
+	if (address < length)
 	{
-		return data[address];
+		assert(bytes);
+		return bytes[address];
 	}
 	return 0xFF;
 }
 
-void ROM::load(const std::vector<uint8_t> input)
+const uint8_t* ROM::bytesAt(uint32_t offset, uint32_t& available)
 {
-	data = input;
+	if (offset >= length)
+		return nullptr;
+	available = uint32_t(length - offset);
+	return bytes + offset;
 }
 
-void Memory::init()
+void ROM::load(const std::vector<uint8_t>& input)
 {
-	wram.load(0x20000);
-	map.map(0x7E0000, 0x7FFFFF, &wram);
+	load(RomStore::instance().intern(input));
 }
 
-void Memory::loadProgram(const std::vector<uint8_t>& program)
+void ROM::load(RomImage input)
 {
-	rom.load(program);
-	map.map(0x008000, 0x008000 + rom.size() - 1, &rom);
-	mirrorWRam();
+	data = std::move(input);
+	bytes = data ? data->data() : nullptr;
+	length = data ? data->size() : 0;
 }
-
-void Memory::mirrorWRam()
-{
-	for (uint8_t bank = 0x00; bank <= 0x3F; ++bank)
-		map.map((bank << 16), (bank << 16) + 0x1FFF, &wram);
-	for (uint8_t bank = 0x80; bank <= 0xBF; ++bank)
-		map.map((bank << 16), (bank << 16) + 0x1FFF, &wram);
-}
\ No newline at end of file
@@ -3,12 +3,31 @@
 #include <vector>
 #include <array>
 #include <memory>
+#include <atomic>
+#include "rom_store.h"
+#include "io.h"
+#include "profiler.h"
+
+class Debugger;
 
 struct MemoryHandler
 {
 	virtual uint8_t read(uint32_t address) = 0;
 	virtual void write(uint32_t address, uint8_t value) = 0;
 	virtual ~MemoryHandler() = default;
+
+	// Host pointer to the backing bytes at offset, with the count available from there.
+	// Handlers with side effects or sparse storage keep the default and are always read().
+	// The pointer must stay valid while mapped; call MemoryMap::invalidate() after reallocating.
+	virtual const uint8_t* bytesAt(uint32_t offset, uint32_t& available) { return nullptr; }
+};
+
+// Accesses that reached a handler or the I/O dispatcher, for metrics
+struct MemoryCounters
+{
+	uint64_t handlerReads = 0;
+	uint64_t handlerWrites = 0;
+	uint64_t ioAccesses = 0;
 };
 
 struct MemoryMapEntry
@@ -17,58 +36,129 @@ struct MemoryMapEntry
 	uint32_t end = 0;
 	MemoryHandler* handler = nullptr;
 	uint32_t base = 0;
+
+	// Coverage bitmaps indexed by handler offset; untracked entries point at the map's sink with a zero mask
+	uint8_t* executed = nullptr;
+	uint8_t* readFrom = nullptr;
+	uint8_t* writtenTo = nullptr;
+	uint32_t coverageMask = 0;
 };
 
+// A run of instruction bytes inside one page that the CPU can fetch without going
+// through the map. bytes is null when the page has to be fetched byte by byte.
+struct CodeWindow
+{
+	const uint8_t* bytes = nullptr;
+	uint16_t start = 0;			// PC of bytes[0]
+	uint32_t length = 0;
+	uint8_t* executed = nullptr;
+	uint32_t coverageMask = 0;
+	uint32_t coverageOffset = 0;	// Handler offset of bytes[0]
+};
+
+inline void markCoverage(uint8_t* bits, uint32_t mask, uint32_t offset)
+{
+	bits[(offset & mask) >> 3] |= uint8_t(1u << (offset & 7));
+}
+
 class MemoryMap
 {
 public:
+	static constexpr uint32_t PAGE_SHIFT = 12;
+	static constexpr uint32_t PAGE_COUNT = 1 << (24 - PAGE_SHIFT);
+
+	MemoryMap();
+	explicit MemoryMap(uint16_t* pageTable);	// PAGE_COUNT entries, e.g. MachineState::pageTable; null for own storage
+	MemoryMap(const MemoryMap&) = delete;
+	MemoryMap& operator=(const MemoryMap&) = delete;
+
 	void map(uint32_t start, uint32_t end, MemoryHandler* handler);
+	void mapIo(IoDispatcher* dispatcher);
+	void clear();	// Unmaps every region and the I/O dispatcher
 	uint8_t read(uint32_t address);
+	uint8_t fetch(uint32_t address);
 	void write(uint32_t address, uint8_t value);
+	uint8_t peek(uint32_t address) const;
+	void setCoverage(const MemoryHandler* handler, uint8_t* executed, uint8_t* readFrom, uint8_t* writtenTo, uint32_t mask);
+	void clearCoverage(const MemoryHandler* handler);
+
+	// Changes whenever the mapping does; cached code windows are only valid for one generation
+	uint32_t generation() const { return mapGeneration; }
+	void invalidate();
+	CodeWindow codeWindow(uint32_t address) const;
+	void setOpenBus(uint8_t value) { lastReadData = value; }
+
+	uint8_t pageFlags(uint32_t address) const { return watchFlags[(address >> PAGE_SHIFT) & (PAGE_COUNT - 1)]; }
+	void setPageFlags(uint32_t start, uint32_t end, uint8_t flags);
+	void clearPageFlags();
 
-	bool useLUT = false;
+	Debugger* debugger = nullptr;
+	MemoryCounters counters = {};
+	PhaseProfiler* profiler = nullptr;
 private:
+	const MemoryMapEntry* find(uint32_t address) const;
+	uint8_t readDirect(uint32_t address);
+	void writeDirect(uint32_t address, uint8_t value);
+	uint8_t watchedRead(uint32_t address);
+	void watchedWrite(uint32_t address, uint8_t value);
+
+	// Page table entries: index into regions when one region covers the whole page
+	static constexpr uint16_t PAGE_UNMAPPED = 0xFFFF;
+	static constexpr uint16_t PAGE_MIXED = 0xFFFE;	// Partly covered, searched region by region
+
+	// Accesses are far too frequent to read the counters on each; one in this many is measured
+	static constexpr uint32_t PROFILE_SAMPLE_INTERVAL = 64;
+
 	std::vector<MemoryMapEntry> regions = {};
-	static constexpr size_t BANK_COUNT = 256;
-	std::array<std::unique_ptr<std::vector<MemoryMapEntry>>, BANK_COUNT> bankLUT;
+	uint16_t* pages;
+	std::array<uint16_t, PAGE_COUNT> ownPages;	// Used unless constructed on an external arena
+	IoDispatcher* io = nullptr;
 	uint8_t lastReadData = 0x00;
+	std::array<uint8_t, PAGE_COUNT> watchFlags = {};	// WatchKind bits per 4 KiB page
+	uint8_t coverageSink = 0;
+	uint32_t mapGeneration = nextGeneration();
+
+	static uint32_t nextGeneration();
 };
 
 class RAM : public MemoryHandler
 {
 public:
 	RAM() {};
-	RAM(size_t size) : data(size, 0x00) {};
+	RAM(size_t size) : owned(size, 0x00), bytes(owned.data()), length(size) {};
+	RAM(uint8_t* external, size_t size) : bytes(external), length(size) {};	// Not owned, e.g. MachineState::wram
+	RAM(RAM&&) = default;
+	RAM& operator=(RAM&&) = default;
+	RAM(const RAM&) = delete;
+	RAM& operator=(const RAM&) = delete;
 	uint8_t read(uint32_t address) override;
 	void write(uint32_t address, uint8_t value) override;
+	const uint8_t* bytesAt(uint32_t offset, uint32_t& available) override;
 	void load(size_t size);
+	void fill(uint8_t value);
+	bool assign(const uint8_t* source, size_t size);
+	size_t size() const { return length; }
+	const uint8_t* contents() const { return bytes; }
 private:
-	std::vector<uint8_t> data;
+	std::vector<uint8_t> owned;
+	uint8_t* bytes = nullptr;
+	size_t length = 0;
 };
 
 class ROM : public MemoryHandler
 {
 public:
 	ROM() {};
-	ROM(const std::vector<uint8_t>& input) : data(input) {};
+	ROM(const std::vector<uint8_t>& input) { load(input); };
 	uint8_t read(uint32_t address) override;
 	void write(uint32_t address, uint8_t value) override {}
-	size_t size() const { return data.size(); }
-	void load(const std::vector<uint8_t> input);
+	const uint8_t* bytesAt(uint32_t offset, uint32_t& available) override;
+	size_t size() const { return length; }
+	void load(const std::vector<uint8_t>& input);
+	void load(RomImage input);
+	const RomImage& image() const { return data; }
 private:
-	std::vector<uint8_t> data;
+	RomImage data;
+	const uint8_t* bytes = nullptr;
+	size_t length = 0;
 };
-
-class Memory
-{
-public:
-	Memory() {};
-	void init();
-	void loadProgram(const std::vector<uint8_t>& program);
-
-	MemoryMap map = {};
-	RAM wram = {};
-	ROM rom = {};
-private:
-	void mirrorWRam();
-};
\ No newline at end of file
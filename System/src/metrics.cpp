@@ -0,0 +1,245 @@
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+constexpr uint32_t LatencyHistogram::SUB_BITS;
+constexpr uint32_t LatencyHistogram::MAX_BITS;
+constexpr size_t LatencyHistogram::BUCKETS;
+
+namespace
+{
+	uint32_t highestBit(uint64_t value)
+	{
+		uint32_t bit = 0;
+		while (value >>= 1)
+			++bit;
+		return bit;
+	}
+}
+
+size_t LatencyHistogram::bucketOf(uint64_t value)
+{
+	const uint64_t sub = 1ull << SUB_BITS;
+	value = std::min<uint64_t>(value, (1ull << MAX_BITS) - 1);
+	if (value < 2 * sub)
+		return size_t(value);
+
+	uint32_t shift = highestBit(value) - SUB_BITS;
+	return size_t((uint64_t(shift) << SUB_BITS) + (value >> shift));
+}
+
+uint64_t LatencyHistogram::highestIn(size_t bucket)
+{
+	const uint64_t sub = 1ull << SUB_BITS;
+	if (bucket < 2 * sub)
+		return bucket;
+
+	uint32_t shift = uint32_t(bucket >> SUB_BITS) - 1;
+	uint64_t top = (bucket & (sub - 1)) + sub;
+	return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value)
+{
+	++buckets[bucketOf(value)];
+	max = std::max(max, value);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+	uint64_t total = 0;
+	for (uint64_t bucket : buckets)
+		total += bucket;
+	return total;
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+	uint64_t total = count();
+	if (!total)
+		return 0;
+
+	uint64_t rank = std::max<uint64_t>(1, uint64_t(fraction * total + 0.5));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKETS; ++i)
+	{
+		seen += buckets[i];
+		if (seen >= rank)
+			return std::min(highestIn(i), max);
+	}
+	return max;
+}
+
+double MetricsSnapshot::mips() const
+{
+	return counters.hostNs ? counters.instructions * 1e3 / counters.hostNs : 0.0;
+}
+
+double MetricsSnapshot::fastPathRatio() const
+{
+	uint64_t total = counters.windowFetches + counters.handlerReads;
+	return total ? double(counters.windowFetches) / total : 0.0;
+}
+
+std::string MetricsSnapshot::format() const
+{
+	char text[768];
+	snprintf(text, sizeof(text),
+		"frames          %llu\n"
+		"instructions    %llu\n"
+		"cycles          %llu\n"
+		"mips            %.2f\n"
+		"fast_path       %.4f\n"
+		"window_fetches  %llu\n"
+		"handler_reads   %llu\n"
+		"handler_writes  %llu\n"
+		"io_accesses     %llu\n"
+		"frame_ns_p50    %llu\n"
+		"frame_ns_p99    %llu\n"
+		"frame_ns_p999   %llu\n"
+		"frame_ns_max    %llu\n",
+		(unsigned long long)counters.frames, (unsigned long long)counters.instructions, (unsigned long long)counters.cycles,
+		mips(), fastPathRatio(),
+		(unsigned long long)counters.windowFetches, (unsigned long long)counters.handlerReads,
+		(unsigned long long)counters.handlerWrites, (unsigned long long)counters.ioAccesses,
+		(unsigned long long)frameTimes.percentile(0.5), (unsigned long long)frameTimes.percentile(0.99),
+		(unsigned long long)frameTimes.percentile(0.999), (unsigned long long)frameTimes.max);
+	return text;
+}
+
+Metrics::Metrics()
+{
+	for (auto& word : words)
+		word.store(0, std::memory_order_relaxed);
+	for (auto& bucket : buckets)
+		bucket.store(0, std::memory_order_relaxed);
+}
+
+void Metrics::publish(const MetricsCounters& counters, uint64_t frameNs)
+{
+	// Single writer, so plain load/store increments are enough and stay off the bus lock
+	std::atomic<uint64_t>& bucket = buckets[LatencyHistogram::bucketOf(frameNs)];
+	bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	if (frameNs > maxNs.load(std::memory_order_relaxed))
+		maxNs.store(frameNs, std::memory_order_relaxed);
+
+	const uint64_t* source = reinterpret_cast<const uint64_t*>(&counters);
+	uint64_t seq = sequence.load(std::memory_order_relaxed);
+	sequence.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for (size_t i = 0; i < WORDS; ++i)
+		words[i].store(source[i], std::memory_order_relaxed);
+	sequence.store(seq + 2, std::memory_order_release);
+}
+
+void Metrics::snapshot(MetricsSnapshot& out) const
+{
+	uint64_t* target = reinterpret_cast<uint64_t*>(&out.counters);
+	for (;;)
+	{
+		uint64_t before = sequence.load(std::memory_order_acquire);
+		if (before & 1)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		for (size_t i = 0; i < WORDS; ++i)
+			target[i] = words[i].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence.load(std::memory_order_relaxed) == before)
+			break;
+	}
+
+	for (size_t i = 0; i < LatencyHistogram::BUCKETS; ++i)
+		out.frameTimes.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+	out.frameTimes.max = maxNs.load(std::memory_order_relaxed);
+}
+
+MetricsDumper::MetricsDumper(const Metrics& source, Target kind, const std::string& destination)
+	: metrics(source), target(kind), path(destination)
+{
+#ifndef _WIN32
+	if (target == Target::Socket)
+		socket = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+#endif
+}
+
+MetricsDumper::~MetricsDumper()
+{
+	stop();
+#ifndef _WIN32
+	if (socket >= 0)
+		::close(int(socket));
+#endif
+}
+
+bool MetricsDumper::dumpOnce()
+{
+	MetricsSnapshot snapshot;
+	metrics.snapshot(snapshot);
+	std::string text = snapshot.format();
+
+	if (target == Target::File)
+	{
+		// Replaced atomically so a reader never sees a half-written dump
+		std::string temporary = path + ".tmp";
+		FILE* file = std::fopen(temporary.c_str(), "wb");
+		if (!file)
+			return false;
+		bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+		ok = std::fclose(file) == 0 && ok;
+		std::remove(path.c_str());
+		return ok && std::rename(temporary.c_str(), path.c_str()) == 0;
+	}
+
+#ifdef _WIN32
+	return false;	// No datagram UNIX sockets here; use Target::File
+#else
+	if (socket < 0)
+		return false;
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path))
+		return false;
+	std::copy(path.begin(), path.end(), address.sun_path);
+
+	// Never block the dump thread on a slow or absent listener
+	return ::sendto(int(socket), text.data(), text.size(), MSG_DONTWAIT,
+		reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == ssize_t(text.size());
+#endif
+}
+
+void MetricsDumper::start(uint32_t intervalMs)
+{
+	if (worker.joinable())
+		return;
+	stopping = false;
+	worker = std::thread([this, intervalMs]
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!wake.wait_for(lock, std::chrono::milliseconds(intervalMs), [this] { return stopping; }))
+		{
+			lock.unlock();
+			dumpOnce();
+			lock.lock();
+		}
+	});
+}
+
+void MetricsDumper::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	if (worker.joinable())
+		worker.join();
+}
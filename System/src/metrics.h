@@ -0,0 +1,97 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Log-linear histogram in the HDR style: exact below 128, then 64 linear steps
+// per power of two, so any recorded value is within about 1.6% of its bucket.
+class LatencyHistogram
+{
+public:
+	static constexpr uint32_t SUB_BITS = 6;
+	static constexpr uint32_t MAX_BITS = 40;	// Values clamp at about 1100 s in ns
+	static constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) << SUB_BITS;
+
+	static size_t bucketOf(uint64_t value);
+	static uint64_t highestIn(size_t bucket);
+
+	void record(uint64_t value);
+	uint64_t count() const;
+	uint64_t percentile(double fraction) const;	// 0.5 for the median
+
+	std::array<uint64_t, BUCKETS> buckets = {};
+	uint64_t max = 0;
+};
+
+// Plain counters, all uint64_t so a snapshot can be copied word by word
+struct MetricsCounters
+{
+	uint64_t instructions = 0;
+	uint64_t cycles = 0;
+	uint64_t frames = 0;
+	uint64_t hostNs = 0;			// Host time spent inside runFrame
+	uint64_t windowFetches = 0;		// Opcode bytes read straight from a code window
+	uint64_t handlerReads = 0;		// Reads and fetches resolved through the map to a handler
+	uint64_t handlerWrites = 0;
+	uint64_t ioAccesses = 0;		// Register reads and writes through the I/O dispatcher
+};
+
+struct MetricsSnapshot
+{
+	MetricsCounters counters;
+	LatencyHistogram frameTimes;
+
+	double mips() const;			// Emulated instructions per host microsecond
+	double fastPathRatio() const;	// Code-window fetches over all handler-level reads
+	std::string format() const;
+};
+
+// Written by the thread running the System after every frame; read from any
+// thread without locks. Counters go through a sequence lock, the frame-time
+// buckets are individually atomic.
+class Metrics
+{
+public:
+	Metrics();
+	void publish(const MetricsCounters& counters, uint64_t frameNs);
+	void snapshot(MetricsSnapshot& out) const;
+private:
+	static constexpr size_t WORDS = sizeof(MetricsCounters) / sizeof(uint64_t);
+	static_assert(sizeof(MetricsCounters) == WORDS * sizeof(uint64_t), "MetricsCounters must hold only uint64_t");
+
+	std::atomic<uint64_t> sequence{ 0 };
+	std::array<std::atomic<uint64_t>, WORDS> words;
+	std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKETS> buckets;
+	std::atomic<uint64_t> maxNs{ 0 };
+};
+
+// Periodically writes the formatted snapshot to a file (replaced each time) or
+// sends it as one datagram to a UNIX socket. Runs on its own thread.
+class MetricsDumper
+{
+public:
+	enum class Target { File, Socket };
+
+	MetricsDumper(const Metrics& metrics, Target target, const std::string& path);
+	~MetricsDumper();
+	MetricsDumper(const MetricsDumper&) = delete;
+	MetricsDumper& operator=(const MetricsDumper&) = delete;
+
+	bool dumpOnce();
+	void start(uint32_t intervalMs);
+	void stop();
+private:
+	const Metrics& metrics;
+	Target target;
+	std::string path;
+	intptr_t socket = -1;
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+};
@@ -0,0 +1,152 @@
+#include "mode7.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MODE7_SSE2 1
+#endif
+
+namespace
+{
+	const int32_t FIELD_MASK = ~1023;	// Set bits put a pixel outside the 128x128 tile field
+	const size_t BATCH = 8;
+
+	int32_t signExtend13(uint16_t value)
+	{
+		return int32_t(int16_t(uint16_t(value << 3))) >> 3;
+	}
+
+	// Scroll minus center, wrapped to 10 bits with the sign of bit 13
+	int32_t clip(int32_t value)
+	{
+		return (value & 0x2000) ? (value | ~1023) : (value & 1023);
+	}
+
+	// VRAM low bytes are the tile map, high bytes the 8x8 tiles' pixels
+	uint8_t sample(const uint16_t* vram, uint8_t over, bool outside, uint16_t tileIndex, uint16_t fine)
+	{
+		uint8_t tile;
+		if (!outside || over < 2)
+			tile = uint8_t(vram[tileIndex]);
+		else if (over == 2)
+			return 0;
+		else
+			tile = 0;
+		return uint8_t(vram[(tile << 6) | fine] >> 8);
+	}
+
+	void evaluateRange(const mode7::Line& line, const uint16_t* vram, uint8_t* out, size_t first, size_t last)
+	{
+		int32_t x = line.originX + line.stepX * int32_t(first);
+		int32_t y = line.originY + line.stepY * int32_t(first);
+		for (size_t i = first; i < last; ++i, x += line.stepX, y += line.stepY)
+		{
+			int32_t px = x >> 8;
+			int32_t py = y >> 8;
+			bool outside = ((px | py) & FIELD_MASK) != 0;
+			uint16_t tileIndex = uint16_t((((py >> 3) & 127) << 7) | ((px >> 3) & 127));
+			uint16_t fine = uint16_t(((py & 7) << 3) | (px & 7));
+			out[i] = sample(vram, line.over, outside, tileIndex, fine);
+		}
+	}
+}
+
+namespace mode7
+{
+	Line setup(const PpuLatches& regs, uint32_t y)
+	{
+		int32_t a = int16_t(regs.m7a);
+		int32_t b = int16_t(regs.m7b);
+		int32_t c = int16_t(regs.m7c);
+		int32_t d = int16_t(regs.m7d);
+		int32_t centerX = signExtend13(regs.m7x);
+		int32_t centerY = signExtend13(regs.m7y);
+		int32_t scrollX = clip(signExtend13(regs.m7hofs) - centerX);
+		int32_t scrollY = clip(signExtend13(regs.m7vofs) - centerY);
+		int32_t screenY = (regs.m7sel & 0x02) ? 255 - int32_t(y) : int32_t(y);
+
+		// The hardware drops the low six bits of each product before summing
+		Line line;
+		line.originX = ((a * scrollX) & ~63) + ((b * scrollY) & ~63) + ((b * screenY) & ~63) + centerX * 256;
+		line.originY = ((c * scrollX) & ~63) + ((d * scrollY) & ~63) + ((d * screenY) & ~63) + centerY * 256;
+		line.stepX = a;
+		line.stepY = c;
+		if (regs.m7sel & 0x01)
+		{
+			line.originX += 255 * a;
+			line.originY += 255 * c;
+			line.stepX = -a;
+			line.stepY = -c;
+		}
+		line.over = uint8_t(regs.m7sel >> 6);
+		return line;
+	}
+
+	void evaluateScalar(const Line& line, const uint16_t* vram, uint8_t* out, size_t width)
+	{
+		evaluateRange(line, vram, out, 0, width);
+	}
+
+	void evaluate(const Line& line, const uint16_t* vram, uint8_t* out, size_t width)
+	{
+#ifdef MODE7_SSE2
+		// Lanes hold pixels 0-3 and 4-7 of the batch
+		__m128i stepX = _mm_set1_epi32(line.stepX);
+		__m128i stepY = _mm_set1_epi32(line.stepY);
+		__m128i x0 = _mm_add_epi32(_mm_set1_epi32(line.originX), _mm_setr_epi32(0, line.stepX, 2 * line.stepX, 3 * line.stepX));
+		__m128i y0 = _mm_add_epi32(_mm_set1_epi32(line.originY), _mm_setr_epi32(0, line.stepY, 2 * line.stepY, 3 * line.stepY));
+		__m128i x1 = _mm_add_epi32(x0, _mm_slli_epi32(stepX, 2));
+		__m128i y1 = _mm_add_epi32(y0, _mm_slli_epi32(stepY, 2));
+		__m128i batchX = _mm_slli_epi32(stepX, 3);
+		__m128i batchY = _mm_slli_epi32(stepY, 3);
+
+		const __m128i fieldMask = _mm_set1_epi32(FIELD_MASK);
+		const __m128i mask127 = _mm_set1_epi32(127);
+		const __m128i mask7 = _mm_set1_epi32(7);
+		const __m128i zero = _mm_setzero_si128();
+
+		alignas(16) uint16_t tileIndex[BATCH];
+		alignas(16) uint16_t fine[BATCH];
+		alignas(16) uint16_t outside[BATCH];
+
+		size_t done = 0;
+		for (; width - done >= BATCH; done += BATCH)
+		{
+			__m128i px0 = _mm_srai_epi32(x0, 8), px1 = _mm_srai_epi32(x1, 8);
+			__m128i py0 = _mm_srai_epi32(y0, 8), py1 = _mm_srai_epi32(y1, 8);
+
+			__m128i out0 = _mm_cmpeq_epi32(_mm_and_si128(_mm_or_si128(px0, py0), fieldMask), zero);
+			__m128i out1 = _mm_cmpeq_epi32(_mm_and_si128(_mm_or_si128(px1, py1), fieldMask), zero);
+			_mm_store_si128(reinterpret_cast<__m128i*>(outside), _mm_xor_si128(_mm_packs_epi32(out0, out1), _mm_set1_epi32(-1)));
+
+			__m128i tile0 = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(_mm_srai_epi32(py0, 3), mask127), 7), _mm_and_si128(_mm_srai_epi32(px0, 3), mask127));
+			__m128i tile1 = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(_mm_srai_epi32(py1, 3), mask127), 7), _mm_and_si128(_mm_srai_epi32(px1, 3), mask127));
+			_mm_store_si128(reinterpret_cast<__m128i*>(tileIndex), _mm_packs_epi32(tile0, tile1));
+
+			__m128i fine0 = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(py0, mask7), 3), _mm_and_si128(px0, mask7));
+			__m128i fine1 = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(py1, mask7), 3), _mm_and_si128(px1, mask7));
+			_mm_store_si128(reinterpret_cast<__m128i*>(fine), _mm_packs_epi32(fine0, fine1));
+
+			// No gather in SSE2: the VRAM lookups stay scalar
+			for (size_t i = 0; i < BATCH; ++i)
+				out[done + i] = sample(vram, line.over, outside[i] != 0, tileIndex[i], fine[i]);
+
+			x0 = _mm_add_epi32(x0, batchX);
+			x1 = _mm_add_epi32(x1, batchX);
+			y0 = _mm_add_epi32(y0, batchY);
+			y1 = _mm_add_epi32(y1, batchY);
+		}
+		evaluateRange(line, vram, out, done, width);
+#else
+		evaluateScalar(line, vram, out, width);
+#endif
+	}
+
+	bool simd()
+	{
+#ifdef MODE7_SSE2
+		return true;
+#else
+		return false;
+#endif
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "machine_state.h"
+#include <cstddef>
+#include <cstdint>
+
+// Mode 7 affine background. The matrix, center and scroll registers reduce to
+// one fixed-point origin and per-pixel step for each line, so the per-pixel
+// work is two adds; SSE2 evaluates eight pixels per step. Both paths give
+// identical results.
+namespace mode7
+{
+	struct Line
+	{
+		int32_t originX = 0;	// Playfield position of screen x = 0, 8 fractional bits
+		int32_t originY = 0;
+		int32_t stepX = 0;		// Added per screen pixel
+		int32_t stepY = 0;
+		uint8_t over = 0;		// M7SEL bits 6-7: 0/1 wrap, 2 transparent, 3 tile 0 outside the 1024x1024 field
+	};
+
+	// y is the hardware line, 1-224
+	Line setup(const PpuLatches& regs, uint32_t y);
+
+	// Writes the 8-bit color index of each pixel, 0 where transparent
+	void evaluate(const Line& line, const uint16_t* vram, uint8_t* out, size_t width);
+	void evaluateScalar(const Line& line, const uint16_t* vram, uint8_t* out, size_t width);
+	bool simd();	// True when evaluate() runs the SSE2 path
+}
@@ -0,0 +1,41 @@
+#include "opcode_info.h"
+
+uint8_t operandLength(AddrMode mode, bool accumulator8Bit, bool index8Bit)
+{
+	switch (mode)
+	{
+	case AddrMode::Implied:
+	case AddrMode::Accumulator:
+		return 0;
+	case AddrMode::ImmediateM:
+		return accumulator8Bit ? 1 : 2;
+	case AddrMode::ImmediateX:
+		return index8Bit ? 1 : 2;
+	case AddrMode::Immediate8:
+	case AddrMode::Relative:
+	case AddrMode::DirectPage:
+	case AddrMode::DirectPageX:
+	case AddrMode::DirectPageY:
+	case AddrMode::DpIndirect:
+	case AddrMode::DpIndirectX:
+	case AddrMode::DpIndirectY:
+	case AddrMode::DpIndirectLong:
+	case AddrMode::DpIndirectLongY:
+	case AddrMode::StackRelative:
+	case AddrMode::StackRelativeIndirectY:
+		return 1;
+	case AddrMode::RelativeLong:
+	case AddrMode::Absolute:
+	case AddrMode::AbsoluteX:
+	case AddrMode::AbsoluteY:
+	case AddrMode::AbsoluteIndirect:
+	case AddrMode::AbsoluteIndexedIndirect:
+	case AddrMode::AbsoluteIndirectLong:
+	case AddrMode::BlockMove:
+		return 2;
+	case AddrMode::AbsoluteLong:
+	case AddrMode::AbsoluteLongX:
+		return 3;
+	}
+	return 0;
+}
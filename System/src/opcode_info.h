@@ -0,0 +1,46 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+enum class AddrMode : uint8_t
+{
+	Implied,
+	Accumulator,
+	ImmediateM,					// Operand size follows the M flag
+	ImmediateX,					// Operand size follows the X flag
+	Immediate8,
+	Relative,
+	RelativeLong,
+	DirectPage,
+	DirectPageX,
+	DirectPageY,
+	DpIndirect,
+	DpIndirectX,
+	DpIndirectY,
+	DpIndirectLong,
+	DpIndirectLongY,
+	Absolute,
+	AbsoluteX,
+	AbsoluteY,
+	AbsoluteLong,
+	AbsoluteLongX,
+	AbsoluteIndirect,
+	AbsoluteIndexedIndirect,
+	AbsoluteIndirectLong,
+	StackRelative,
+	StackRelativeIndirectY,
+	BlockMove
+};
+
+struct OpcodeInfo
+{
+	const char* mnemonic;
+	AddrMode mode;
+	uint8_t cycles;				// Base CPU cycles, 8-bit registers, no penalties
+};
+
+// Built from the opcode table in opcodes.cpp, which also builds the dispatch table
+extern const std::array<OpcodeInfo, 256> opcodeInfo;
+
+// Operand bytes following the opcode
+uint8_t operandLength(AddrMode mode, bool accumulator8Bit, bool index8Bit);
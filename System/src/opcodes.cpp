@@ -1,316 +1,467 @@
 #include "opcodes.h"
 #include "cpu.h"
 #include "AddressingModes.h"
-#include <iostream>
+#include <type_traits>
+#include <utility>
 
-void register_opcodes(CPU& cpu)
+namespace
 {
-#pragma region LDA
-	// LDA DP Indexed Indirect, X
-	cpu.opcodeTable[0xA1] = [](CPU& cpu)
-	{
-		uint32_t address = dpIndirectX(cpu);
-		cpu.setA(cpu.memory->read(address));
-	};
-	// LDA Stack Relative
-	cpu.opcodeTable[0xA3] = [](CPU& cpu)
-	{
-		uint32_t addr = stackRelative(cpu);
-		cpu.setA(cpu.memory->read(addr));
-	};
-	// LDA Direct Page
-	cpu.opcodeTable[0xA5] = [](CPU& cpu)
-	{
-		uint32_t address = directPage(cpu);
-		cpu.setA(cpu.memory->read(address));
-	};
-	// LDA DP Indirect Long
-	cpu.opcodeTable[0xA7] = [](CPU& cpu)
-	{
-		uint32_t address = dpIndirectLong(cpu);
-		cpu.setA(cpu.memory->read(address));
-	};
-	// LDA Immediate
-	cpu.opcodeTable[0xA9] = [](CPU& cpu)
-	{
-		cpu.setA(immediate(cpu, cpu.isAccumulator8Bit()));
-	};
-	// LDA Absolute
-	cpu.opcodeTable[0xAD] = [](CPU& cpu)
-	{
-		uint32_t address = absolute(cpu);
-		cpu.setA(cpu.memory->read(address));
-	};
-	// LDA AbsoluteLong
-	cpu.opcodeTable[0xAF] = [](CPU& cpu)
-	{
-		uint32_t address = absoluteLong(cpu);
-		cpu.setA(cpu.memory->read(address));
-	};
-	// LDA DP Indirect Indexed, Y
-	cpu.opcodeTable[0xB1] = [](CPU& cpu)
-	{
-		uint32_t address = dpIndirectY(cpu);
-		cpu.setA(cpu.memory->read(address));
-	};
-	// LDA DP Indirect
-	cpu.opcodeTable[0xB2] = [](CPU& cpu)
-	{
-		uint32_t address = dpIndirect(cpu);
-		cpu.setA(cpu.memory->read(address));
-	};
-	// LDA SR Indirect Indexed,Y
-	cpu.opcodeTable[0xB3] = [](CPU& cpu)
-	{
-		uint32_t addr = stackRelativeIndirectY(cpu);
-		cpu.setA(cpu.memory->read(addr));
-	};
-	// LDA Direct Page Indexed, X
-	cpu.opcodeTable[0xB5] = [](CPU& cpu)
-	{
-		uint32_t address = directPage(cpu, cpu.registers.X);
-		cpu.setA(cpu.memory->read(address));
-	};
-	// LDA DP Indirect Long Indexed,Y
-	cpu.opcodeTable[0xB7] = [](CPU& cpu)
-	{
-		uint32_t address = dpIndirectLong(cpu, cpu.registers.Y);
-		cpu.setA(cpu.memory->read(address));
-	};
-	// LDA Absolute Indexed,Y
-	cpu.opcodeTable[0xB9] = [](CPU& cpu)
-	{
-		uint32_t address = absolute(cpu, cpu.registers.Y);
-		cpu.setA(cpu.memory->read(address));
-	};
-	// LDA Absolute Indexed,X
-	cpu.opcodeTable[0xBD] = [](CPU& cpu)
-	{
-		uint32_t address = absolute(cpu, cpu.registers.X);
-		cpu.setA(cpu.memory->read(address));
-	};
-	// LDA AbsoluteLong Indexed,X
-	cpu.opcodeTable[0xBF] = [](CPU& cpu)
-	{
-		uint32_t address = absoluteLong(cpu, cpu.registers.X);
-		cpu.setA(cpu.memory->read(address));
-	};
-#pragma endregion
-#pragma region LDX
-	// LDX Absolute
-	cpu.opcodeTable[0xAE] = [](CPU& cpu)
-	{
-		uint32_t address = absolute(cpu);
-		cpu.setIndex(cpu.registers.X, cpu.memory->read(address));
-	};
-	// LDX Immediate
-	cpu.opcodeTable[0xA2] = [](CPU& cpu)
-	{
-		cpu.setIndex(cpu.registers.X, immediate(cpu, cpu.isIndex8Bit()));
-	};
-	// LDX Direct Page
-	cpu.opcodeTable[0xA6] = [](CPU& cpu)
-	{
-		uint32_t address = directPage(cpu);
-		cpu.setIndex(cpu.registers.X,  cpu.memory->read(address));
-	};
-	// LDX Direct Page Indexed,Y
-	cpu.opcodeTable[0xB6] = [](CPU& cpu)
-	{
-		uint32_t address = directPage(cpu, cpu.registers.Y);
-		cpu.setIndex(cpu.registers.X,  cpu.memory->read(address));
-	};
-	// LDX Absolute Indexed,Y
-	cpu.opcodeTable[0xBE] = [](CPU& cpu)
-	{
-		uint32_t address = absolute(cpu, cpu.registers.Y);
-		cpu.setIndex(cpu.registers.X,  cpu.memory->read(address));
-	};
-#pragma endregion
-#pragma region LDY
-	// LDY Immediate
-	cpu.opcodeTable[0xA0] = [](CPU& cpu)
-	{
-			cpu.setIndex(cpu.registers.Y, immediate(cpu, cpu.isIndex8Bit()));
-	};
-	// LDY Absolute
-	cpu.opcodeTable[0xAC] = [](CPU& cpu)
-	{
-			uint32_t address = absolute(cpu);
-			cpu.setIndex(cpu.registers.Y,  cpu.memory->read(address));
-	};
-	// LDY Direct Page
-	cpu.opcodeTable[0xA4] = [](CPU& cpu)
-	{
-			uint32_t address = directPage(cpu);
-			cpu.setIndex(cpu.registers.Y,  cpu.memory->read(address));
-	};
-	// LDY Direct Page Indexed,X
-	cpu.opcodeTable[0xB4] = [](CPU& cpu)
-	{
-			uint32_t address = directPage(cpu, cpu.registers.X);
-			cpu.setIndex(cpu.registers.Y,  cpu.memory->read(address));
-	};
-	// LDY Absolute Indexed,X
-	cpu.opcodeTable[0xBC] = [](CPU& cpu)
-	{
-			uint32_t address = absolute(cpu, cpu.registers.X);
-			cpu.setIndex(cpu.registers.Y,  cpu.memory->read(address));
-	};
-#pragma endregion
-#pragma region STA
-	// STA DP Indexed Indirect,X
-	cpu.opcodeTable[0x81] = [](CPU& cpu)
+	using OpcodeHandler = void(*)(CPU&);
+
+#pragma region Operations
+	// Each operation is written once and instantiated per addressing mode
+	struct LDA
 	{
-		uint32_t address = dpIndirectX(cpu);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu) { cpu.setA(Mode::load(cpu, cpu.isAccumulator8Bit())); }
 	};
-	// STA Stack Relative
-	cpu.opcodeTable[0x83] = [](CPU& cpu)
+	struct LDX
 	{
-		uint32_t address = stackRelative(cpu);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu) { cpu.setIndex(cpu.registers.X, Mode::load(cpu, cpu.isIndex8Bit())); }
 	};
-	// STA Direct Page
-	cpu.opcodeTable[0x85] = [](CPU& cpu)
+	struct LDY
 	{
-		uint32_t address = directPage(cpu);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu) { cpu.setIndex(cpu.registers.Y, Mode::load(cpu, cpu.isIndex8Bit())); }
 	};
-	// STA DP Indirect Long
-	cpu.opcodeTable[0x87] = [](CPU& cpu)
+	struct STA
 	{
-		uint32_t address = dpIndirectLong(cpu);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu) { Mode::store(cpu, cpu.registers.A & 0xFF); }
 	};
-	// STA Absolute
-	cpu.opcodeTable[0x8D] = [](CPU& cpu)
+	struct STX
 	{
-		uint32_t address = absolute(cpu);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu) { Mode::store(cpu, cpu.registers.X & 0xFF); }
 	};
-	// STA Absolute Long
-	cpu.opcodeTable[0x8F] = [](CPU& cpu)
+	struct STY
 	{
-		uint32_t address = absoluteLong(cpu);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu) { Mode::store(cpu, cpu.registers.Y & 0xFF); }
 	};
-	// STA DP Indirect Indexed,Y
-	cpu.opcodeTable[0x91] = [](CPU& cpu)
+	struct REP
 	{
-		uint32_t address = dpIndirectY(cpu);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu)
+		{
+			cpu.registers.P &= ~uint8_t(Mode::load(cpu, true));
+			cpu.updateRegisterSizes();
+		}
 	};
-	// STA DP Indirect
-	cpu.opcodeTable[0x92] = [](CPU& cpu)
+	struct SEP
 	{
-		uint32_t address = dpIndirect(cpu);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu)
+		{
+			cpu.registers.P |= uint8_t(Mode::load(cpu, true));
+			cpu.updateRegisterSizes();
+		}
 	};
-	// STA SR Indirect Indexed,Y
-	cpu.opcodeTable[0x93] = [](CPU& cpu)
+	struct RTI
 	{
-		uint32_t address = stackRelativeIndirectY(cpu);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu)
+		{
+			cpu.registers.P = cpu.pull8();
+			cpu.updateRegisterSizes();
+			cpu.registers.PC = cpu.pull16();
+			if (!cpu.registers.E)
+				cpu.registers.PBR = cpu.pull8();
+		}
 	};
-	// STA DP Indexed,X
-	cpu.opcodeTable[0x95] = [](CPU& cpu)
+	struct CLI
 	{
-		uint32_t address = directPage(cpu, cpu.registers.X);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu) { cpu.setFlag(I, false); }
 	};
-	// STA DP Indirect Long Indexed,Y
-	cpu.opcodeTable[0x97] = [](CPU& cpu)
+	struct SEI
 	{
-		uint32_t address = dpIndirectLong(cpu, cpu.registers.Y);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu) { cpu.setFlag(I, true); }
 	};
-	// STA Absolute Indexed,Y
-	cpu.opcodeTable[0x99] = [](CPU& cpu)
+	struct BRA
 	{
-		uint32_t address = absolute(cpu, cpu.registers.Y);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu) { cpu.registers.PC = Mode::target(cpu); }
 	};
-	// STA Absolute Indexed,X
-	cpu.opcodeTable[0x9D] = [](CPU& cpu)
+	struct JML
 	{
-		uint32_t address = absolute(cpu, cpu.registers.X);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu)
+		{
+			uint32_t target = Mode::address(cpu);
+			cpu.registers.PBR = uint8_t(target >> 16);
+			cpu.registers.PC = uint16_t(target);
+		}
 	};
-	// STA Absolute Long Indexed,X
-	cpu.opcodeTable[0x9F] = [](CPU& cpu)
+	struct JSL
 	{
-		uint32_t address = absoluteLong(cpu, cpu.registers.X);
-		cpu.memory->write(address, cpu.registers.A & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu)
+		{
+			uint32_t target = Mode::address(cpu);
+			cpu.push8(cpu.registers.PBR);
+			cpu.push16(uint16_t(cpu.registers.PC - 1));
+			cpu.registers.PBR = uint8_t(target >> 16);
+			cpu.registers.PC = uint16_t(target);
+		}
 	};
-#pragma endregion
-#pragma region STX
-	// STX Direct Page
-	cpu.opcodeTable[0x86] = [](CPU& cpu)
+	struct RTL
 	{
-		uint32_t address = directPage(cpu);
-		cpu.memory->write(address, cpu.registers.X & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu)
+		{
+			cpu.registers.PC = uint16_t(cpu.pull16() + 1);
+			cpu.registers.PBR = cpu.pull8();
+		}
 	};
-	// STX Absolute
-	cpu.opcodeTable[0x8E] = [](CPU& cpu)
+	struct NOP
 	{
-		uint32_t address = absolute(cpu);
-		cpu.memory->write(address, cpu.registers.X & 0xFF);
+		template <class Mode>
+		static void execute(CPU&) {}
 	};
-	// STX DP Indexed,Y
-	cpu.opcodeTable[0x96] = [](CPU& cpu)
+	// BRK and the $FF fatal marker end a run rather than taking the BRK vector
+	struct BRK
 	{
-		uint32_t address = directPage(cpu, cpu.registers.Y);
-		cpu.memory->write(address, cpu.registers.X & 0xFF);
+		template <class Mode>
+		static void execute(CPU& cpu) { cpu.running = false; }
 	};
+
+	// Operations the CPU does not execute yet: listed so the table below can name them
+	struct Unimplemented {};
+#define UNIMPLEMENTED(name) struct name : Unimplemented {}
+	UNIMPLEMENTED(ADC); UNIMPLEMENTED(AND); UNIMPLEMENTED(ASL); UNIMPLEMENTED(BCC); UNIMPLEMENTED(BCS);
+	UNIMPLEMENTED(BEQ); UNIMPLEMENTED(BIT); UNIMPLEMENTED(BMI); UNIMPLEMENTED(BNE); UNIMPLEMENTED(BPL);
+	UNIMPLEMENTED(BRL); UNIMPLEMENTED(BVC); UNIMPLEMENTED(BVS); UNIMPLEMENTED(CLC); UNIMPLEMENTED(CLD);
+	UNIMPLEMENTED(CLV); UNIMPLEMENTED(CMP); UNIMPLEMENTED(COP); UNIMPLEMENTED(CPX); UNIMPLEMENTED(CPY);
+	UNIMPLEMENTED(DEC); UNIMPLEMENTED(DEX); UNIMPLEMENTED(DEY); UNIMPLEMENTED(EOR); UNIMPLEMENTED(INC);
+	UNIMPLEMENTED(INX); UNIMPLEMENTED(INY); UNIMPLEMENTED(JMP); UNIMPLEMENTED(JSR); UNIMPLEMENTED(LSR);
+	UNIMPLEMENTED(MVN); UNIMPLEMENTED(MVP); UNIMPLEMENTED(ORA); UNIMPLEMENTED(PEA); UNIMPLEMENTED(PEI);
+	UNIMPLEMENTED(PER); UNIMPLEMENTED(PHA); UNIMPLEMENTED(PHB); UNIMPLEMENTED(PHD); UNIMPLEMENTED(PHK);
+	UNIMPLEMENTED(PHP); UNIMPLEMENTED(PHX); UNIMPLEMENTED(PHY); UNIMPLEMENTED(PLA); UNIMPLEMENTED(PLB);
+	UNIMPLEMENTED(PLD); UNIMPLEMENTED(PLP); UNIMPLEMENTED(PLX); UNIMPLEMENTED(PLY); UNIMPLEMENTED(ROL);
+	UNIMPLEMENTED(ROR); UNIMPLEMENTED(RTS); UNIMPLEMENTED(SBC); UNIMPLEMENTED(SEC); UNIMPLEMENTED(SED);
+	UNIMPLEMENTED(STP); UNIMPLEMENTED(STZ); UNIMPLEMENTED(TAX); UNIMPLEMENTED(TAY); UNIMPLEMENTED(TCD);
+	UNIMPLEMENTED(TCS); UNIMPLEMENTED(TDC); UNIMPLEMENTED(TRB); UNIMPLEMENTED(TSB); UNIMPLEMENTED(TSC);
+	UNIMPLEMENTED(TSX); UNIMPLEMENTED(TXA); UNIMPLEMENTED(TXS); UNIMPLEMENTED(TXY); UNIMPLEMENTED(TYA);
+	UNIMPLEMENTED(TYX); UNIMPLEMENTED(WAI); UNIMPLEMENTED(WDM); UNIMPLEMENTED(XBA); UNIMPLEMENTED(XCE);
+#undef UNIMPLEMENTED
 #pragma endregion
-#pragma region STY
-	// STY Direct Page
-	cpu.opcodeTable[0x84] = [](CPU& cpu)
+
+	template <class Operation, class Mode>
+	void execute(CPU& cpu)
 	{
-		uint32_t address = directPage(cpu);
-		cpu.memory->write(address, cpu.registers.Y & 0xFF);
-	};
-	// STY Absolute
-	cpu.opcodeTable[0x8C] = [](CPU& cpu)
+		Operation::template execute<Mode>(cpu);
+	}
+
+	template <class Operation, class Mode, bool = std::is_base_of<Unimplemented, Operation>::value>
+	struct Dispatch
 	{
-		uint32_t address = absolute(cpu);
-		cpu.memory->write(address, cpu.registers.Y & 0xFF);
+		static constexpr OpcodeHandler handler() { return &execute<Operation, Mode>; }
 	};
-	// STY DP Indexed,X
-	cpu.opcodeTable[0x94] = [](CPU& cpu)
+
+	template <class Operation, class Mode>
+	struct Dispatch<Operation, Mode, true>
 	{
-		uint32_t address = directPage(cpu, cpu.registers.X);
-		cpu.memory->write(address, cpu.registers.Y & 0xFF);
+		static constexpr OpcodeHandler handler() { return nullptr; }
 	};
+
+	template <unsigned Opcode>
+	struct Entry;
+
+	// One row per opcode. The handler and the disassembler/cycle information are
+	// both derived from it, so they cannot disagree.
+#define OPCODE(code, operation, addressingMode, cycles) \
+	template <> struct Entry<code> \
+	{ \
+		static constexpr OpcodeHandler handler() { return Dispatch<operation, mode::addressingMode>::handler(); } \
+		static constexpr OpcodeInfo info() { return { #operation, mode::addressingMode::addressing, cycles }; } \
+	}
+
+#pragma region Opcode table
+	OPCODE(0x00, BRK, Immediate8, 7);
+	OPCODE(0x01, ORA, DpIndirectX, 6);
+	OPCODE(0x02, COP, Immediate8, 7);
+	OPCODE(0x03, ORA, StackRelative, 4);
+	OPCODE(0x04, TSB, DirectPage, 5);
+	OPCODE(0x05, ORA, DirectPage, 3);
+	OPCODE(0x06, ASL, DirectPage, 5);
+	OPCODE(0x07, ORA, DpIndirectLong, 6);
+	OPCODE(0x08, PHP, Implied, 3);
+	OPCODE(0x09, ORA, ImmediateM, 2);
+	OPCODE(0x0A, ASL, Accumulator, 2);
+	OPCODE(0x0B, PHD, Implied, 4);
+	OPCODE(0x0C, TSB, Absolute, 6);
+	OPCODE(0x0D, ORA, Absolute, 4);
+	OPCODE(0x0E, ASL, Absolute, 6);
+	OPCODE(0x0F, ORA, AbsoluteLong, 5);
+	OPCODE(0x10, BPL, Relative, 2);
+	OPCODE(0x11, ORA, DpIndirectY, 5);
+	OPCODE(0x12, ORA, DpIndirect, 5);
+	OPCODE(0x13, ORA, StackRelativeIndirectY, 7);
+	OPCODE(0x14, TRB, DirectPage, 5);
+	OPCODE(0x15, ORA, DirectPageX, 4);
+	OPCODE(0x16, ASL, DirectPageX, 6);
+	OPCODE(0x17, ORA, DpIndirectLongY, 6);
+	OPCODE(0x18, CLC, Implied, 2);
+	OPCODE(0x19, ORA, AbsoluteY, 4);
+	OPCODE(0x1A, INC, Accumulator, 2);
+	OPCODE(0x1B, TCS, Implied, 2);
+	OPCODE(0x1C, TRB, Absolute, 6);
+	OPCODE(0x1D, ORA, AbsoluteX, 4);
+	OPCODE(0x1E, ASL, AbsoluteX, 7);
+	OPCODE(0x1F, ORA, AbsoluteLongX, 5);
+	OPCODE(0x20, JSR, Absolute, 6);
+	OPCODE(0x21, AND, DpIndirectX, 6);
+	OPCODE(0x22, JSL, AbsoluteLong, 8);
+	OPCODE(0x23, AND, StackRelative, 4);
+	OPCODE(0x24, BIT, DirectPage, 3);
+	OPCODE(0x25, AND, DirectPage, 3);
+	OPCODE(0x26, ROL, DirectPage, 5);
+	OPCODE(0x27, AND, DpIndirectLong, 6);
+	OPCODE(0x28, PLP, Implied, 4);
+	OPCODE(0x29, AND, ImmediateM, 2);
+	OPCODE(0x2A, ROL, Accumulator, 2);
+	OPCODE(0x2B, PLD, Implied, 5);
+	OPCODE(0x2C, BIT, Absolute, 4);
+	OPCODE(0x2D, AND, Absolute, 4);
+	OPCODE(0x2E, ROL, Absolute, 6);
+	OPCODE(0x2F, AND, AbsoluteLong, 5);
+	OPCODE(0x30, BMI, Relative, 2);
+	OPCODE(0x31, AND, DpIndirectY, 5);
+	OPCODE(0x32, AND, DpIndirect, 5);
+	OPCODE(0x33, AND, StackRelativeIndirectY, 7);
+	OPCODE(0x34, BIT, DirectPageX, 4);
+	OPCODE(0x35, AND, DirectPageX, 4);
+	OPCODE(0x36, ROL, DirectPageX, 6);
+	OPCODE(0x37, AND, DpIndirectLongY, 6);
+	OPCODE(0x38, SEC, Implied, 2);
+	OPCODE(0x39, AND, AbsoluteY, 4);
+	OPCODE(0x3A, DEC, Accumulator, 2);
+	OPCODE(0x3B, TSC, Implied, 2);
+	OPCODE(0x3C, BIT, AbsoluteX, 4);
+	OPCODE(0x3D, AND, AbsoluteX, 4);
+	OPCODE(0x3E, ROL, AbsoluteX, 7);
+	OPCODE(0x3F, AND, AbsoluteLongX, 5);
+	OPCODE(0x40, RTI, Implied, 6);
+	OPCODE(0x41, EOR, DpIndirectX, 6);
+	OPCODE(0x42, WDM, Immediate8, 2);
+	OPCODE(0x43, EOR, StackRelative, 4);
+	OPCODE(0x44, MVP, BlockMove, 7);
+	OPCODE(0x45, EOR, DirectPage, 3);
+	OPCODE(0x46, LSR, DirectPage, 5);
+	OPCODE(0x47, EOR, DpIndirectLong, 6);
+	OPCODE(0x48, PHA, Implied, 3);
+	OPCODE(0x49, EOR, ImmediateM, 2);
+	OPCODE(0x4A, LSR, Accumulator, 2);
+	OPCODE(0x4B, PHK, Implied, 3);
+	OPCODE(0x4C, JMP, Absolute, 3);
+	OPCODE(0x4D, EOR, Absolute, 4);
+	OPCODE(0x4E, LSR, Absolute, 6);
+	OPCODE(0x4F, EOR, AbsoluteLong, 5);
+	OPCODE(0x50, BVC, Relative, 2);
+	OPCODE(0x51, EOR, DpIndirectY, 5);
+	OPCODE(0x52, EOR, DpIndirect, 5);
+	OPCODE(0x53, EOR, StackRelativeIndirectY, 7);
+	OPCODE(0x54, MVN, BlockMove, 7);
+	OPCODE(0x55, EOR, DirectPageX, 4);
+	OPCODE(0x56, LSR, DirectPageX, 6);
+	OPCODE(0x57, EOR, DpIndirectLongY, 6);
+	OPCODE(0x58, CLI, Implied, 2);
+	OPCODE(0x59, EOR, AbsoluteY, 4);
+	OPCODE(0x5A, PHY, Implied, 3);
+	OPCODE(0x5B, TCD, Implied, 2);
+	OPCODE(0x5C, JML, AbsoluteLong, 4);
+	OPCODE(0x5D, EOR, AbsoluteX, 4);
+	OPCODE(0x5E, LSR, AbsoluteX, 7);
+	OPCODE(0x5F, EOR, AbsoluteLongX, 5);
+	OPCODE(0x60, RTS, Implied, 6);
+	OPCODE(0x61, ADC, DpIndirectX, 6);
+	OPCODE(0x62, PER, RelativeLong, 6);
+	OPCODE(0x63, ADC, StackRelative, 4);
+	OPCODE(0x64, STZ, DirectPage, 3);
+	OPCODE(0x65, ADC, DirectPage, 3);
+	OPCODE(0x66, ROR, DirectPage, 5);
+	OPCODE(0x67, ADC, DpIndirectLong, 6);
+	OPCODE(0x68, PLA, Implied, 4);
+	OPCODE(0x69, ADC, ImmediateM, 2);
+	OPCODE(0x6A, ROR, Accumulator, 2);
+	OPCODE(0x6B, RTL, Implied, 6);
+	OPCODE(0x6C, JMP, AbsoluteIndirect, 5);
+	OPCODE(0x6D, ADC, Absolute, 4);
+	OPCODE(0x6E, ROR, Absolute, 6);
+	OPCODE(0x6F, ADC, AbsoluteLong, 5);
+	OPCODE(0x70, BVS, Relative, 2);
+	OPCODE(0x71, ADC, DpIndirectY, 5);
+	OPCODE(0x72, ADC, DpIndirect, 5);
+	OPCODE(0x73, ADC, StackRelativeIndirectY, 7);
+	OPCODE(0x74, STZ, DirectPageX, 4);
+	OPCODE(0x75, ADC, DirectPageX, 4);
+	OPCODE(0x76, ROR, DirectPageX, 6);
+	OPCODE(0x77, ADC, DpIndirectLongY, 6);
+	OPCODE(0x78, SEI, Implied, 2);
+	OPCODE(0x79, ADC, AbsoluteY, 4);
+	OPCODE(0x7A, PLY, Implied, 4);
+	OPCODE(0x7B, TDC, Implied, 2);
+	OPCODE(0x7C, JMP, AbsoluteIndexedIndirect, 6);
+	OPCODE(0x7D, ADC, AbsoluteX, 4);
+	OPCODE(0x7E, ROR, AbsoluteX, 7);
+	OPCODE(0x7F, ADC, AbsoluteLongX, 5);
+	OPCODE(0x80, BRA, Relative, 3);
+	OPCODE(0x81, STA, DpIndirectX, 6);
+	OPCODE(0x82, BRL, RelativeLong, 4);
+	OPCODE(0x83, STA, StackRelative, 4);
+	OPCODE(0x84, STY, DirectPage, 3);
+	OPCODE(0x85, STA, DirectPage, 3);
+	OPCODE(0x86, STX, DirectPage, 3);
+	OPCODE(0x87, STA, DpIndirectLong, 6);
+	OPCODE(0x88, DEY, Implied, 2);
+	OPCODE(0x89, BIT, ImmediateM, 2);
+	OPCODE(0x8A, TXA, Implied, 2);
+	OPCODE(0x8B, PHB, Implied, 3);
+	OPCODE(0x8C, STY, Absolute, 4);
+	OPCODE(0x8D, STA, Absolute, 4);
+	OPCODE(0x8E, STX, Absolute, 4);
+	OPCODE(0x8F, STA, AbsoluteLong, 5);
+	OPCODE(0x90, BCC, Relative, 2);
+	OPCODE(0x91, STA, DpIndirectY, 6);
+	OPCODE(0x92, STA, DpIndirect, 5);
+	OPCODE(0x93, STA, StackRelativeIndirectY, 7);
+	OPCODE(0x94, STY, DirectPageX, 4);
+	OPCODE(0x95, STA, DirectPageX, 4);
+	OPCODE(0x96, STX, DirectPageY, 4);
+	OPCODE(0x97, STA, DpIndirectLongY, 6);
+	OPCODE(0x98, TYA, Implied, 2);
+	OPCODE(0x99, STA, AbsoluteY, 5);
+	OPCODE(0x9A, TXS, Implied, 2);
+	OPCODE(0x9B, TXY, Implied, 2);
+	OPCODE(0x9C, STZ, Absolute, 4);
+	OPCODE(0x9D, STA, AbsoluteX, 5);
+	OPCODE(0x9E, STZ, AbsoluteX, 5);
+	OPCODE(0x9F, STA, AbsoluteLongX, 5);
+	OPCODE(0xA0, LDY, ImmediateX, 2);
+	OPCODE(0xA1, LDA, DpIndirectX, 6);
+	OPCODE(0xA2, LDX, ImmediateX, 2);
+	OPCODE(0xA3, LDA, StackRelative, 4);
+	OPCODE(0xA4, LDY, DirectPage, 3);
+	OPCODE(0xA5, LDA, DirectPage, 3);
+	OPCODE(0xA6, LDX, DirectPage, 3);
+	OPCODE(0xA7, LDA, DpIndirectLong, 6);
+	OPCODE(0xA8, TAY, Implied, 2);
+	OPCODE(0xA9, LDA, ImmediateM, 2);
+	OPCODE(0xAA, TAX, Implied, 2);
+	OPCODE(0xAB, PLB, Implied, 4);
+	OPCODE(0xAC, LDY, Absolute, 4);
+	OPCODE(0xAD, LDA, Absolute, 4);
+	OPCODE(0xAE, LDX, Absolute, 4);
+	OPCODE(0xAF, LDA, AbsoluteLong, 5);
+	OPCODE(0xB0, BCS, Relative, 2);
+	OPCODE(0xB1, LDA, DpIndirectY, 5);
+	OPCODE(0xB2, LDA, DpIndirect, 5);
+	OPCODE(0xB3, LDA, StackRelativeIndirectY, 7);
+	OPCODE(0xB4, LDY, DirectPageX, 4);
+	OPCODE(0xB5, LDA, DirectPageX, 4);
+	OPCODE(0xB6, LDX, DirectPageY, 4);
+	OPCODE(0xB7, LDA, DpIndirectLongY, 6);
+	OPCODE(0xB8, CLV, Implied, 2);
+	OPCODE(0xB9, LDA, AbsoluteY, 4);
+	OPCODE(0xBA, TSX, Implied, 2);
+	OPCODE(0xBB, TYX, Implied, 2);
+	OPCODE(0xBC, LDY, AbsoluteX, 4);
+	OPCODE(0xBD, LDA, AbsoluteX, 4);
+	OPCODE(0xBE, LDX, AbsoluteY, 4);
+	OPCODE(0xBF, LDA, AbsoluteLongX, 5);
+	OPCODE(0xC0, CPY, ImmediateX, 2);
+	OPCODE(0xC1, CMP, DpIndirectX, 6);
+	OPCODE(0xC2, REP, Immediate8, 3);
+	OPCODE(0xC3, CMP, StackRelative, 4);
+	OPCODE(0xC4, CPY, DirectPage, 3);
+	OPCODE(0xC5, CMP, DirectPage, 3);
+	OPCODE(0xC6, DEC, DirectPage, 5);
+	OPCODE(0xC7, CMP, DpIndirectLong, 6);
+	OPCODE(0xC8, INY, Implied, 2);
+	OPCODE(0xC9, CMP, ImmediateM, 2);
+	OPCODE(0xCA, DEX, Implied, 2);
+	OPCODE(0xCB, WAI, Implied, 3);
+	OPCODE(0xCC, CPY, Absolute, 4);
+	OPCODE(0xCD, CMP, Absolute, 4);
+	OPCODE(0xCE, DEC, Absolute, 6);
+	OPCODE(0xCF, CMP, AbsoluteLong, 5);
+	OPCODE(0xD0, BNE, Relative, 2);
+	OPCODE(0xD1, CMP, DpIndirectY, 5);
+	OPCODE(0xD2, CMP, DpIndirect, 5);
+	OPCODE(0xD3, CMP, StackRelativeIndirectY, 7);
+	OPCODE(0xD4, PEI, DpIndirect, 6);
+	OPCODE(0xD5, CMP, DirectPageX, 4);
+	OPCODE(0xD6, DEC, DirectPageX, 6);
+	OPCODE(0xD7, CMP, DpIndirectLongY, 6);
+	OPCODE(0xD8, CLD, Implied, 2);
+	OPCODE(0xD9, CMP, AbsoluteY, 4);
+	OPCODE(0xDA, PHX, Implied, 3);
+	OPCODE(0xDB, STP, Implied, 3);
+	OPCODE(0xDC, JML, AbsoluteIndirectLong, 6);
+	OPCODE(0xDD, CMP, AbsoluteX, 4);
+	OPCODE(0xDE, DEC, AbsoluteX, 7);
+	OPCODE(0xDF, CMP, AbsoluteLongX, 5);
+	OPCODE(0xE0, CPX, ImmediateX, 2);
+	OPCODE(0xE1, SBC, DpIndirectX, 6);
+	OPCODE(0xE2, SEP, Immediate8, 3);
+	OPCODE(0xE3, SBC, StackRelative, 4);
+	OPCODE(0xE4, CPX, DirectPage, 3);
+	OPCODE(0xE5, SBC, DirectPage, 3);
+	OPCODE(0xE6, INC, DirectPage, 5);
+	OPCODE(0xE7, SBC, DpIndirectLong, 6);
+	OPCODE(0xE8, INX, Implied, 2);
+	OPCODE(0xE9, SBC, ImmediateM, 2);
+	OPCODE(0xEA, NOP, Implied, 2);
+	OPCODE(0xEB, XBA, Implied, 3);
+	OPCODE(0xEC, CPX, Absolute, 4);
+	OPCODE(0xED, SBC, Absolute, 4);
+	OPCODE(0xEE, INC, Absolute, 6);
+	OPCODE(0xEF, SBC, AbsoluteLong, 5);
+	OPCODE(0xF0, BEQ, Relative, 2);
+	OPCODE(0xF1, SBC, DpIndirectY, 5);
+	OPCODE(0xF2, SBC, DpIndirect, 5);
+	OPCODE(0xF3, SBC, StackRelativeIndirectY, 7);
+	OPCODE(0xF4, PEA, Absolute, 5);
+	OPCODE(0xF5, SBC, DirectPageX, 4);
+	OPCODE(0xF6, INC, DirectPageX, 6);
+	OPCODE(0xF7, SBC, DpIndirectLongY, 6);
+	OPCODE(0xF8, SED, Implied, 2);
+	OPCODE(0xF9, SBC, AbsoluteY, 4);
+	OPCODE(0xFA, PLX, Implied, 4);
+	OPCODE(0xFB, XCE, Implied, 2);
+	OPCODE(0xFC, JSR, AbsoluteIndexedIndirect, 8);
+	OPCODE(0xFD, SBC, AbsoluteX, 4);
+	OPCODE(0xFE, INC, AbsoluteX, 7);
+	OPCODE(0xFF, SBC, AbsoluteLongX, 5);
 #pragma endregion
-#pragma region REP/SEP
-	// REP
-	cpu.opcodeTable[0xC2] = [](CPU& cpu)
+
+#undef OPCODE
+
+	// $FF is read as SBC long,X but executes as the fatal marker
+	template <unsigned Opcode>
+	constexpr OpcodeHandler handler() { return Opcode == 0xFF ? &execute<BRK, mode::Implied> : Entry<Opcode>::handler(); }
+
+	template <size_t... Opcodes>
+	constexpr std::array<OpcodeHandler, 256> buildTable(std::index_sequence<Opcodes...>)
 	{
-		uint8_t value = immediate(cpu, true);
-		cpu.registers.P &= ~value;
-		cpu.updateRegisterSizes();
-	};
-	// SEP
-	cpu.opcodeTable[0xE2] = [](CPU& cpu)
+		return { { handler<Opcodes>()... } };
+	}
+
+	template <size_t... Opcodes>
+	constexpr std::array<OpcodeInfo, 256> buildInfo(std::index_sequence<Opcodes...>)
 	{
-		uint8_t value = immediate(cpu, true);
-		cpu.registers.P |= value;
-		cpu.updateRegisterSizes();
-	};
-#pragma endregion
-#pragma region Misc
-	// BRK
-	cpu.opcodeTable[0x00] = [](CPU& cpu)
-		{
-			cpu.running = false;
-		};
+		return { { Entry<Opcodes>::info()... } };
+	}
 
-	// FATAL
-	cpu.opcodeTable[0xFF] = [](CPU& cpu)
-		{
-			cpu.running = false;
-		};
-#pragma endregion
+	constexpr std::array<OpcodeHandler, 256> opcodeHandlers = buildTable(std::make_index_sequence<256>());
+}
+
+const std::array<OpcodeInfo, 256> opcodeInfo = buildInfo(std::make_index_sequence<256>());
+
+void register_opcodes(CPU& cpu)
+{
+	cpu.opcodeTable = opcodeHandlers;
 }
@@ -0,0 +1,276 @@
+#include "post_process.h"
+#include "ppu.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+	const uint32_t WIDTH = PPU::WIDTH;
+	const uint32_t HEIGHT = PPU::HEIGHT;
+
+	struct Rgb
+	{
+		int32_t r, g, b;
+	};
+
+	Rgb expand(uint16_t color)
+	{
+		int32_t r = color & 0x1F, g = (color >> 5) & 0x1F, b = (color >> 10) & 0x1F;
+		return Rgb{ (r << 3) | (r >> 2), (g << 3) | (g >> 2), (b << 3) | (b >> 2) };
+	}
+
+	uint32_t pack(const Rgb& c)
+	{
+		return uint32_t(c.r << 16 | c.g << 8 | c.b);
+	}
+
+	int32_t clampChannel(int32_t value)
+	{
+		return value < 0 ? 0 : value > 255 ? 255 : value;
+	}
+
+	PostSettings sanitize(PostSettings settings)
+	{
+		settings.scale = settings.filter == PostFilter::Xbr ? 2 : std::min(std::max(settings.scale, 1u), 4u);
+		settings.threads = std::max(settings.threads, 1u);
+		settings.bandRows = std::max(settings.bandRows, 1u);
+		return settings;
+	}
+
+	// Copies each finished output row down to fill the rest of its scale x scale block
+	void repeatRows(uint32_t* row, uint32_t width, uint32_t count)
+	{
+		for (uint32_t i = 1; i < count; ++i)
+			std::copy(row, row + width, row + i * width);
+	}
+
+	void scaleRows(const uint16_t* in, uint32_t* out, uint32_t scale, uint32_t first, uint32_t last)
+	{
+		uint32_t width = WIDTH * scale;
+		for (uint32_t y = first; y < last; ++y)
+		{
+			uint32_t* row = out + y * scale * width;
+			for (uint32_t x = 0; x < WIDTH; ++x)
+				std::fill(row + x * scale, row + (x + 1) * scale, pack(expand(in[y * WIDTH + x])));
+			repeatRows(row, width, scale);
+		}
+	}
+
+	// YIQ in 8.8 fixed point. Luma gets a 1-2-1 blur, chroma a wider 5-tap one so
+	// colors bleed past sharp edges; the last row of each block is dimmed to 3/4.
+	void ntscRows(const uint16_t* in, uint32_t* out, uint32_t scale, uint32_t first, uint32_t last)
+	{
+		uint32_t width = WIDTH * scale;
+		int32_t luma[WIDTH], inPhase[WIDTH], quadrature[WIDTH];
+		for (uint32_t y = first; y < last; ++y)
+		{
+			for (uint32_t x = 0; x < WIDTH; ++x)
+			{
+				Rgb c = expand(in[y * WIDTH + x]);
+				luma[x] = 77 * c.r + 150 * c.g + 29 * c.b;
+				inPhase[x] = 153 * c.r - 70 * c.g - 83 * c.b;
+				quadrature[x] = 54 * c.r - 134 * c.g + 80 * c.b;
+			}
+
+			uint32_t* row = out + y * scale * width;
+			for (uint32_t x = 0; x < WIDTH; ++x)
+			{
+				auto at = [](const int32_t* line, int32_t x) { return line[std::min(std::max(x, 0), int32_t(WIDTH) - 1)]; };
+				int32_t i = int32_t(x);
+				int32_t yy = (at(luma, i - 1) + 2 * luma[x] + at(luma, i + 1)) / 4;
+				int32_t ii = (at(inPhase, i - 2) + 2 * at(inPhase, i - 1) + 2 * inPhase[x] + 2 * at(inPhase, i + 1) + at(inPhase, i + 2)) / 8;
+				int32_t qq = (at(quadrature, i - 2) + 2 * at(quadrature, i - 1) + 2 * quadrature[x] + 2 * at(quadrature, i + 1) + at(quadrature, i + 2)) / 8;
+
+				Rgb c = {
+					clampChannel((yy * 256 + 245 * ii + 159 * qq) / 65536),
+					clampChannel((yy * 256 - 70 * ii - 166 * qq) / 65536),
+					clampChannel((yy * 256 - 283 * ii + 436 * qq) / 65536)
+				};
+				std::fill(row + x * scale, row + (x + 1) * scale, pack(c));
+			}
+			repeatRows(row, width, scale);
+
+			if (scale > 1)
+			{
+				uint32_t* dim = row + (scale - 1) * width;
+				for (uint32_t x = 0; x < width; ++x)
+					dim[x] = (dim[x] >> 2 & 0x3F3F3F) * 3;
+			}
+		}
+	}
+
+	// Luma-weighted YUV distance, as xBR compares colors
+	int32_t distance(const Rgb& a, const Rgb& b)
+	{
+		int32_t dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+		return 48 * std::abs(77 * dr + 150 * dg + 29 * db)
+			+ 7 * std::abs(-43 * dr - 85 * dg + 128 * db)
+			+ 6 * std::abs(128 * dr - 107 * dg - 21 * db);
+	}
+
+	// One output corner of center pixel e. s1 and s2 are the orthogonal neighbours
+	// on the corner's sides, diag the one across it, n1/n2 the far corners next to
+	// s1/s2 and o1/o2 the neighbours opposite s2/s1. An edge running between s1 and
+	// s2 cuts the corner off, and it takes the closer of the two blended with e.
+	Rgb corner(const Rgb& e, const Rgb& s1, const Rgb& s2, const Rgb& diag, const Rgb& n1, const Rgb& n2, const Rgb& o1, const Rgb& o2)
+	{
+		int32_t toS1 = distance(e, s1);
+		int32_t toS2 = distance(e, s2);
+		if (toS1 == 0 || toS2 == 0)
+			return e;
+
+		int32_t across = distance(e, n1) + distance(e, n2) + 4 * distance(s2, s1);
+		int32_t along = distance(s2, o2) + distance(s1, o1) + 4 * distance(e, diag);
+		if (across >= along)
+			return e;
+
+		const Rgb& pick = toS1 <= toS2 ? s1 : s2;
+		return Rgb{ (e.r + pick.r) >> 1, (e.g + pick.g) >> 1, (e.b + pick.b) >> 1 };
+	}
+
+	void xbrRows(const uint16_t* in, uint32_t* out, uint32_t first, uint32_t last)
+	{
+		uint32_t width = WIDTH * 2;
+		auto at = [in](int32_t x, int32_t y)
+		{
+			x = std::min(std::max(x, 0), int32_t(WIDTH) - 1);
+			y = std::min(std::max(y, 0), int32_t(HEIGHT) - 1);
+			return expand(in[y * WIDTH + x]);
+		};
+
+		for (uint32_t y = first; y < last; ++y)
+		{
+			uint32_t* top = out + y * 2 * width;
+			uint32_t* bottom = top + width;
+			for (uint32_t x = 0; x < WIDTH; ++x)
+			{
+				int32_t cx = int32_t(x), cy = int32_t(y);
+				// A B C
+				// D E F
+				// G H I
+				Rgb a = at(cx - 1, cy - 1), b = at(cx, cy - 1), c = at(cx + 1, cy - 1);
+				Rgb d = at(cx - 1, cy), e = at(cx, cy), f = at(cx + 1, cy);
+				Rgb g = at(cx - 1, cy + 1), h = at(cx, cy + 1), i = at(cx + 1, cy + 1);
+
+				top[x * 2] = pack(corner(e, d, b, a, g, c, h, f));
+				top[x * 2 + 1] = pack(corner(e, b, f, c, a, i, d, h));
+				bottom[x * 2] = pack(corner(e, h, d, g, i, a, f, b));
+				bottom[x * 2 + 1] = pack(corner(e, f, h, i, c, g, b, d));
+			}
+		}
+	}
+
+	struct BandJob
+	{
+		const PostSettings* settings;
+		const uint16_t* in;
+		uint32_t* out;
+	};
+}
+
+PostProcessor::PostProcessor(const PostSettings& settings)
+	: config(sanitize(settings)), pool(config.threads),
+	input(SourceFrame{ std::vector<uint16_t>(WIDTH * HEIGHT, 0), 0 }),
+	output(PostFrame{ std::vector<uint32_t>(size_t(outputWidth()) * outputHeight(), 0), outputWidth(), outputHeight(), 0 })
+{
+
+}
+
+PostProcessor::~PostProcessor()
+{
+	stop();
+}
+
+uint32_t PostProcessor::outputWidth() const
+{
+	return WIDTH * config.scale;
+}
+
+uint32_t PostProcessor::outputHeight() const
+{
+	return HEIGHT * config.scale;
+}
+
+void PostProcessor::start()
+{
+	if (worker.joinable())
+		return;
+	stopping = false;
+	pending = false;
+	worker = std::thread(&PostProcessor::loop, this);
+}
+
+void PostProcessor::stop()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_one();
+	if (worker.joinable())
+		worker.join();
+}
+
+void PostProcessor::submit(const uint16_t* pixels, uint64_t number)
+{
+	SourceFrame& slot = input.back();
+	std::copy(pixels, pixels + WIDTH * HEIGHT, slot.pixels.begin());
+	slot.number = number;
+	input.publish();
+
+	// The lock is only ever held for the flag, never across filtering
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		pending = true;
+	}
+	wake.notify_one();
+}
+
+void PostProcessor::process(const uint16_t* pixels, PostFrame& out)
+{
+	out.pixels.resize(size_t(outputWidth()) * outputHeight());
+	out.width = outputWidth();
+	out.height = outputHeight();
+
+	BandJob job = { &config, pixels, out.pixels.data() };
+	pool.run((HEIGHT + config.bandRows - 1) / config.bandRows, processBand, &job);
+}
+
+void PostProcessor::processBand(void* ctx, size_t band)
+{
+	const BandJob& job = *static_cast<const BandJob*>(ctx);
+	const PostSettings& settings = *job.settings;
+	uint32_t first = uint32_t(band) * settings.bandRows;
+	uint32_t last = std::min(first + settings.bandRows, HEIGHT);
+
+	switch (settings.filter)
+	{
+	case PostFilter::Scale: scaleRows(job.in, job.out, settings.scale, first, last); break;
+	case PostFilter::Ntsc: ntscRows(job.in, job.out, settings.scale, first, last); break;
+	case PostFilter::Xbr: xbrRows(job.in, job.out, first, last); break;
+	}
+}
+
+void PostProcessor::loop()
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this] { return stopping || pending; });
+			if (stopping)
+				return;
+			pending = false;
+		}
+
+		// Emulation is already running the next frame while this one is filtered
+		if (!input.poll())
+			continue;
+		const SourceFrame& source = input.front();
+		PostFrame& out = output.back();
+		process(source.pixels.data(), out);
+		out.number = source.number;
+		output.publish();
+		processed.fetch_add(1, std::memory_order_release);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "band_pool.h"
+#include "triple_buffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class PostFilter : uint8_t
+{
+	Scale,	// Nearest neighbour integer scale
+	Ntsc,	// Composite-style luma softening, chroma bleed and scanlines
+	Xbr,	// Edge-directed 2x in the xBR style
+};
+
+struct PostSettings
+{
+	PostFilter filter = PostFilter::Scale;
+	uint32_t scale = 2;		// 1-4 for Scale and Ntsc; Xbr is always 2x
+	uint32_t threads = 2;	// Including the post-processing thread itself
+	uint32_t bandRows = 16;	// Source rows per band handed to the pool
+};
+
+struct PostFrame
+{
+	std::vector<uint32_t> pixels;	// XRGB8888, width * height
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t number = 0;
+};
+
+// Optional output stage between the emulation thread and the display. Frames
+// are submitted without waiting and filtered on a separate thread one frame
+// behind emulation, each split into row bands across a BandPool. All buffers
+// are sized up front, so a frame costs no allocation; when the filters fall
+// behind, older submitted frames are dropped.
+class PostProcessor
+{
+	struct SourceFrame
+	{
+		std::vector<uint16_t> pixels;
+		uint64_t number = 0;
+	};
+public:
+	explicit PostProcessor(const PostSettings& settings = PostSettings());
+	~PostProcessor();
+	PostProcessor(const PostProcessor&) = delete;
+	PostProcessor& operator=(const PostProcessor&) = delete;
+
+	void start();
+	void stop();
+
+	// Producer side: copies a BGR555 PPU frame into a spare slot
+	void submit(const uint16_t* pixels, uint64_t number);
+
+	// Consumer side: true if a newer filtered frame was published since the last poll
+	bool poll() { return output.poll(); }
+	const PostFrame& frame() const { return output.front(); }
+	uint64_t framesProcessed() const { return processed.load(std::memory_order_acquire); }
+
+	// Filters one frame on the calling thread and the pool; not while started
+	void process(const uint16_t* pixels, PostFrame& out);
+
+	const PostSettings& settings() const { return config; }
+	uint32_t outputWidth() const;
+	uint32_t outputHeight() const;
+private:
+	void loop();
+	static void processBand(void* ctx, size_t band);
+
+	PostSettings config;
+	BandPool pool;
+	TripleBuffer<SourceFrame> input;
+	TripleBuffer<PostFrame> output;
+
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool pending = false;
+	bool stopping = false;
+	std::atomic<uint64_t> processed{ 0 };
+};
@@ -0,0 +1,535 @@
+#include "ppu.h"
+#include "mode7.h"
+#include <algorithm>
+#include <new>
+
+PPU::PPU()
+	: ownState(new (allocateAligned(sizeof(PpuState), alignof(PpuState))) PpuState()), framebuffer(WIDTH * HEIGHT, 0x0000),
+	vram(ownState->vram, 0x8000), cgram(ownState->cgram, 256), oam(ownState->oam, 544), regs(ownState->latches)
+{
+	powerOn();
+}
+
+PPU::PPU(PpuState& state)
+	: framebuffer(WIDTH * HEIGHT, 0x0000),
+	vram(state.vram, 0x8000), cgram(state.cgram, 256), oam(state.oam, 544), regs(state.latches)
+{
+	powerOn();
+}
+
+void PPU::powerOn()
+{
+	regs = PpuLatches();
+	regs.vramStep = 1;
+	regs.forcedBlank = 1;
+	std::fill(vram.begin(), vram.end(), uint16_t(0));
+	std::fill(cgram.begin(), cgram.end(), uint16_t(0));
+	std::fill(oam.begin(), oam.end(), uint8_t(0));
+}
+
+void PPU::attach(IoDispatcher& io)
+{
+	// INIDISP
+	io.registerWrite(0x2100, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.regs.forcedBlank = value & 0x80;
+		ppu.regs.brightness = value & 0x0F;
+	}, this);
+
+	// OBSEL
+	io.registerWrite(0x2101, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static_cast<PPU*>(ctx)->regs.obsel = value;
+	}, this);
+	// OAMADDL/OAMADDH
+	io.registerWrite(0x2102, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.regs.oamAddress = uint16_t((ppu.regs.oamAddress & 0x200) | (value << 1));
+		ppu.regs.oamReload = ppu.regs.oamAddress;
+	}, this);
+	io.registerWrite(0x2103, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.regs.oamAddress = uint16_t(((value & 0x01) << 9) | (ppu.regs.oamAddress & 0x1FE));
+		ppu.regs.oamReload = ppu.regs.oamAddress;
+		ppu.regs.oamPriority = value & 0x80;
+	}, this);
+	// OAMDATA
+	io.registerWrite(0x2104, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		uint16_t address = ppu.regs.oamAddress;
+		if (address < 0x200)
+		{
+			// Low table words are committed on the odd byte
+			if (address & 1)
+			{
+				ppu.oam[address - 1] = ppu.regs.oamLatch;
+				ppu.oam[address] = value;
+				ppu.sprites.touch(address >> 2);
+			}
+			else
+			{
+				ppu.regs.oamLatch = value;
+			}
+		}
+		else
+		{
+			ppu.oam[0x200 | (address & 0x1F)] = value;
+			for (uint32_t sprite = (address & 0x1Fu) * 4; sprite < (address & 0x1Fu) * 4 + 4; ++sprite)
+				ppu.sprites.touch(sprite);
+		}
+		ppu.regs.oamAddress = (address + 1) & 0x3FF;
+	}, this);
+	// OAMDATAREAD
+	io.registerRead(0x2138, [](void* ctx, uint16_t) -> uint8_t
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		uint16_t address = ppu.regs.oamAddress;
+		uint8_t value = ppu.oam[address < 0x200 ? address : 0x200 | (address & 0x1F)];
+		ppu.regs.oamAddress = (address + 1) & 0x3FF;
+		return value;
+	}, this);
+
+	// STAT77, PPU1 version 1
+	io.registerRead(0x213E, [](void* ctx, uint16_t) -> uint8_t
+	{
+		return uint8_t(static_cast<PPU*>(ctx)->regs.objFlags | 0x01);
+	}, this);
+
+	// VMAIN
+	io.registerWrite(0x2115, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static const uint8_t steps[4] = { 1, 32, 128, 128 };
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.regs.vramIncrementHigh = value & 0x80;
+		ppu.regs.vramRemap = (value >> 2) & 0x03;
+		ppu.regs.vramStep = steps[value & 0x03];
+	}, this);
+	// VMADDL/VMADDH
+	io.registerWrite(0x2116, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.regs.vramAddress = uint16_t((ppu.regs.vramAddress & 0xFF00) | value);
+		ppu.prefetchVram();
+	}, this);
+	io.registerWrite(0x2117, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.regs.vramAddress = uint16_t((value << 8) | (ppu.regs.vramAddress & 0x00FF));
+		ppu.prefetchVram();
+	}, this);
+	// VMDATAL/VMDATAH
+	io.registerWrite(0x2118, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		uint16_t& word = ppu.vram[ppu.vramWordAddress()];
+		word = uint16_t((word & 0xFF00) | value);
+		if (!ppu.regs.vramIncrementHigh)
+			ppu.stepVram();
+	}, this);
+	io.registerWrite(0x2119, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		uint16_t& word = ppu.vram[ppu.vramWordAddress()];
+		word = uint16_t((value << 8) | (word & 0x00FF));
+		if (ppu.regs.vramIncrementHigh)
+			ppu.stepVram();
+	}, this);
+	// VMDATALREAD/VMDATAHREAD
+	io.registerRead(0x2139, [](void* ctx, uint16_t) -> uint8_t
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		uint8_t value = uint8_t(ppu.regs.vramLatch);
+		if (!ppu.regs.vramIncrementHigh)
+		{
+			ppu.prefetchVram();
+			ppu.stepVram();
+		}
+		return value;
+	}, this);
+	io.registerRead(0x213A, [](void* ctx, uint16_t) -> uint8_t
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		uint8_t value = uint8_t(ppu.regs.vramLatch >> 8);
+		if (ppu.regs.vramIncrementHigh)
+		{
+			ppu.prefetchVram();
+			ppu.stepVram();
+		}
+		return value;
+	}, this);
+
+	// BGMODE
+	io.registerWrite(0x2105, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static_cast<PPU*>(ctx)->regs.bgMode = value & 0x07;
+	}, this);
+	// BG1HOFS/BG1VOFS, which double as the mode 7 scroll
+	io.registerWrite(0x210D, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.writeMode7(ppu.regs.m7hofs, value);
+	}, this);
+	io.registerWrite(0x210E, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.writeMode7(ppu.regs.m7vofs, value);
+	}, this);
+
+	// M7SEL
+	io.registerWrite(0x211A, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static_cast<PPU*>(ctx)->regs.m7sel = value & 0xC3;
+	}, this);
+	// M7A-M7D, M7X, M7Y: low byte then high byte through the shared latch
+	io.registerWrite(0x211B, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.writeMode7(ppu.regs.m7a, value);
+	}, this);
+	io.registerWrite(0x211C, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.writeMode7(ppu.regs.m7b, value);
+	}, this);
+	io.registerWrite(0x211D, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.writeMode7(ppu.regs.m7c, value);
+	}, this);
+	io.registerWrite(0x211E, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.writeMode7(ppu.regs.m7d, value);
+	}, this);
+	io.registerWrite(0x211F, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.writeMode7(ppu.regs.m7x, value);
+	}, this);
+	io.registerWrite(0x2120, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.writeMode7(ppu.regs.m7y, value);
+	}, this);
+	// MPYL/MPYM/MPYH: signed M7A times the signed high byte of M7B
+	for (uint16_t port = 0x2134; port <= 0x2136; ++port)
+	{
+		io.registerRead(port, [](void* ctx, uint16_t address) -> uint8_t
+		{
+			const PpuLatches& regs = static_cast<PPU*>(ctx)->regs;
+			int32_t product = int16_t(regs.m7a) * int8_t(regs.m7b >> 8);
+			return uint8_t(product >> (8 * (address - 0x2134)));
+		}, this);
+	}
+
+	// TM
+	io.registerWrite(0x212C, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static_cast<PPU*>(ctx)->regs.mainScreen = value & 0x1F;
+	}, this);
+	// TS, TMW, TSW
+	io.registerWrite(0x212D, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static_cast<PPU*>(ctx)->regs.subScreen = value & 0x1F;
+	}, this);
+	io.registerWrite(0x212E, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static_cast<PPU*>(ctx)->regs.mainWindow = value & 0x1F;
+	}, this);
+	io.registerWrite(0x212F, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static_cast<PPU*>(ctx)->regs.subWindow = value & 0x1F;
+	}, this);
+	// W12SEL/W34SEL/WOBJSEL, WH0-WH3, WBGLOG/WOBJLOG
+	for (uint16_t port = 0x2123; port <= 0x2125; ++port)
+	{
+		io.registerWrite(port, [](void* ctx, uint16_t address, uint8_t value)
+		{
+			static_cast<PPU*>(ctx)->regs.windowSel[address - 0x2123] = value;
+		}, this);
+	}
+	for (uint16_t port = 0x2126; port <= 0x2129; ++port)
+	{
+		io.registerWrite(port, [](void* ctx, uint16_t address, uint8_t value)
+		{
+			static_cast<PPU*>(ctx)->regs.windowEdge[address - 0x2126] = value;
+		}, this);
+	}
+	for (uint16_t port = 0x212A; port <= 0x212B; ++port)
+	{
+		io.registerWrite(port, [](void* ctx, uint16_t address, uint8_t value)
+		{
+			static_cast<PPU*>(ctx)->regs.windowLogic[address - 0x212A] = value;
+		}, this);
+	}
+	// CGWSEL, CGADSUB
+	io.registerWrite(0x2130, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static_cast<PPU*>(ctx)->regs.cgwsel = value;
+	}, this);
+	io.registerWrite(0x2131, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static_cast<PPU*>(ctx)->regs.cgadsub = value;
+	}, this);
+	// COLDATA: bits 5-7 pick which of red, green and blue take the intensity
+	io.registerWrite(0x2132, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		uint16_t color = ppu.regs.fixedColor;
+		for (uint32_t channel = 0; channel < 3; ++channel)
+		{
+			if (value & (0x20 << channel))
+				color = uint16_t((color & ~(0x1F << (channel * 5))) | ((value & 0x1F) << (channel * 5)));
+		}
+		ppu.regs.fixedColor = color;
+	}, this);
+	// SETINI
+	io.registerWrite(0x2133, [](void* ctx, uint16_t, uint8_t value)
+	{
+		static_cast<PPU*>(ctx)->regs.setini = value;
+	}, this);
+
+	// CGADD
+	io.registerWrite(0x2121, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		ppu.regs.cgramAddress = value;
+		ppu.regs.cgramHigh = false;
+	}, this);
+	// CGDATA
+	io.registerWrite(0x2122, [](void* ctx, uint16_t, uint8_t value)
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		if (ppu.regs.cgramHigh)
+			ppu.cgram[ppu.regs.cgramAddress++] = uint16_t(((value & 0x7F) << 8) | ppu.regs.cgramLatch);
+		else
+			ppu.regs.cgramLatch = value;
+		ppu.regs.cgramHigh = !ppu.regs.cgramHigh;
+	}, this);
+	// CGDATAREAD
+	io.registerRead(0x213B, [](void* ctx, uint16_t) -> uint8_t
+	{
+		PPU& ppu = *static_cast<PPU*>(ctx);
+		uint16_t color = ppu.cgram[ppu.regs.cgramAddress];
+		uint8_t value = ppu.regs.cgramHigh ? uint8_t((color >> 8) & 0x7F) : uint8_t(color);
+		if (ppu.regs.cgramHigh)
+			++ppu.regs.cgramAddress;
+		ppu.regs.cgramHigh = !ppu.regs.cgramHigh;
+		return value;
+	}, this);
+}
+
+void PPU::startFrame()
+{
+	// The sprite overflow flags clear at the end of vblank
+	regs.objFlags = 0;
+}
+
+void PPU::renderScanline(uint32_t line)
+{
+	uint16_t* out = &framebuffer[line * WIDTH];
+	if (regs.forcedBlank)
+	{
+		std::fill(out, out + WIDTH, uint16_t(0));
+		return;
+	}
+
+	// Layers are read as the registers stand now, so HDMA writes between lines take effect per line
+	evaluateSprites(line);
+	uint8_t layers = regs.mainScreen | regs.subScreen;
+	if (layers & 0x10)
+		drawSprites();
+	else
+		objLine.fill(0);
+
+	if (regs.bgMode == 7 && (layers & 0x03))
+	{
+		mode7::Line setup = mode7::setup(regs, line + 1);
+		mode7::evaluate(setup, vram.data(), layerLine.data(), WIDTH);
+	}
+	else
+	{
+		layerLine.fill(0);
+	}
+
+	buildWindows();
+
+	// Main screen pixels from layers with math enabled; OBJ palettes 0-3 never take part
+	bool addSub = (regs.cgwsel & 0x02) != 0;
+	colormath::LineMask mainMath = composeScreen(regs.mainScreen, regs.mainWindow, cgram[0], mainLine.data(), regs.cgadsub & 0x3F);
+	colormath::LineMask subOpaque = colormath::none();
+	if (addSub)
+		subOpaque = composeScreen(regs.subScreen, regs.subWindow, regs.fixedColor, subLine.data(), 0x5F);
+	else
+		subLine.fill(regs.fixedColor);
+
+	colormath::Line blend;
+	blend.main = mainLine.data();
+	blend.sub = subLine.data();
+	blend.clip = colorRegion(regs.cgwsel >> 6);
+	blend.math = mainMath & ~colorRegion((regs.cgwsel >> 4) & 0x03);
+	blend.subtract = (regs.cgadsub & 0x80) != 0;
+	blend.brightness = regs.brightness;
+
+	// Halving is skipped where main was clipped to black or the sub screen shows its backdrop
+	if (regs.cgadsub & 0x40)
+		blend.half = blend.math & ~blend.clip & (addSub ? subOpaque : colormath::all());
+	colormath::blend(blend, out);
+}
+
+void PPU::evaluateSprites(uint32_t line)
+{
+	if (regs.forcedBlank)
+		return;
+	sprites.evaluate(line, oam.data(), regs, spriteLine);
+	regs.objFlags |= spriteLine.flags;
+}
+
+void PPU::drawSprites()
+{
+	objLine.fill(0);
+
+	// Slivers come highest priority first, so the first opaque pixel at each x stays
+	for (size_t i = 0; i < spriteLine.tileCount; ++i)
+	{
+		const SpriteEvaluator::Tile& tile = spriteLine.tiles[i];
+		uint16_t planes01 = vram[tile.address];
+		uint16_t planes23 = vram[(tile.address + 8) & 0x7FFF];
+		for (int32_t px = 0; px < 8; ++px)
+		{
+			int32_t x = tile.x + px;
+			if (x < 0 || x >= int32_t(WIDTH) || objLine[x])
+				continue;
+
+			uint32_t bit = tile.flip ? px : 7 - px;
+			uint8_t color = uint8_t(((planes01 >> bit) & 1) | (((planes01 >> (bit + 8)) & 1) << 1)
+				| (((planes23 >> bit) & 1) << 2) | (((planes23 >> (bit + 8)) & 1) << 3));
+			if (color)
+			{
+				objLine[x] = uint8_t(tile.palette + color);
+				objPriority[x] = tile.priority;
+			}
+		}
+	}
+}
+
+void PPU::buildWindows()
+{
+	colormath::LineMask window1 = colormath::range(regs.windowEdge[0], regs.windowEdge[1]);
+	colormath::LineMask window2 = colormath::range(regs.windowEdge[2], regs.windowEdge[3]);
+	for (uint32_t layer = 0; layer < windows.size(); ++layer)
+	{
+		uint8_t settings = (regs.windowSel[layer / 2] >> ((layer & 1) * 4)) & 0x0F;
+		uint8_t logic = (regs.windowLogic[layer / 4] >> ((layer & 3) * 2)) & 0x03;
+		windows[layer] = colormath::window(window1, window2, settings, logic);
+	}
+}
+
+colormath::LineMask PPU::colorRegion(uint8_t region) const
+{
+	// CGWSEL regions: nowhere, outside the color window, inside it, everywhere
+	switch (region & 0x03)
+	{
+	case 0: return colormath::none();
+	case 1: return ~windows[5];
+	case 2: return windows[5];
+	default: return colormath::all();
+	}
+}
+
+colormath::LineMask PPU::composeScreen(uint8_t layers, uint8_t masked, uint16_t backdrop, uint16_t* out, uint8_t select) const
+{
+	// Each layer drops out where its window covers it, if TMW/TSW masks it on this screen
+	colormath::LineMask hidden[5];
+	for (uint32_t layer = 0; layer < 5; ++layer)
+		hidden[layer] = (masked >> layer) & 1 ? windows[layer] : colormath::none();
+
+	bool m7 = regs.bgMode == 7;
+	bool bg1 = m7 && (layers & 0x01);
+	bool bg2 = m7 && (layers & 0x02) && (regs.setini & 0x40);
+	bool obj = (layers & 0x10) != 0;
+
+	// Front to back: OBJ 3, OBJ 2, BG2 high, OBJ 1, BG1, OBJ 0, BG2 low. EXTBG's BG2 shows
+	// the same pixels as BG1 with bit 7 as its priority. Other modes have no backgrounds yet.
+	static const uint8_t OBJ_DEPTH[4] = { 2, 4, 6, 7 };
+	colormath::LineMask selected = colormath::none();
+	for (uint32_t x = 0; x < WIDTH; ++x)
+	{
+		uint8_t pixel = layerLine[x];
+		uint8_t low = pixel & 0x7F;
+		uint8_t index = 0;
+		uint8_t depth = 0;
+		uint8_t source = 0x20;	// Backdrop
+		if (bg2 && (pixel & 0x80) && low && !colormath::test(hidden[1], x))
+		{
+			index = low;
+			depth = 5;
+			source = 0x02;
+		}
+		else if (bg1 && pixel && !colormath::test(hidden[0], x))
+		{
+			index = pixel;
+			depth = 3;
+			source = 0x01;
+		}
+		else if (bg2 && low && !colormath::test(hidden[1], x))
+		{
+			index = low;
+			depth = 1;
+			source = 0x02;
+		}
+		if (obj && objLine[x] && OBJ_DEPTH[objPriority[x]] > depth && !colormath::test(hidden[4], x))
+		{
+			index = objLine[x];
+			source = index >= 0xC0 ? 0x10 : 0x40;
+		}
+
+		out[x] = index ? cgram[index] : backdrop;
+		if (source & select)
+			colormath::set(selected, x);
+	}
+	return selected;
+}
+
+void PPU::writeMode7(uint16_t& target, uint8_t value)
+{
+	target = uint16_t((value << 8) | regs.m7latch);
+	regs.m7latch = value;
+}
+
+uint16_t PPU::vramWordAddress() const
+{
+	uint16_t a = regs.vramAddress;
+	switch (regs.vramRemap)
+	{
+	case 1: a = uint16_t((a & 0xFF00) | ((a & 0x001F) << 3) | ((a >> 5) & 0x07)); break;
+	case 2: a = uint16_t((a & 0xFE00) | ((a & 0x003F) << 3) | ((a >> 6) & 0x07)); break;
+	case 3: a = uint16_t((a & 0xFC00) | ((a & 0x007F) << 3) | ((a >> 7) & 0x07)); break;
+	}
+	return a & 0x7FFF;
+}
+
+void PPU::prefetchVram()
+{
+	regs.vramLatch = vram[vramWordAddress()];
+}
+
+void PPU::stepVram()
+{
+	regs.vramAddress = uint16_t(regs.vramAddress + regs.vramStep);
+}
+
+PPU::Latches PPU::latches() const
+{
+	return regs;
+}
+
+void PPU::restore(const Latches& state)
+{
+	regs = state;
+	invalidate();
+}
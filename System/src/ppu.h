@@ -0,0 +1,64 @@
+#pragma once
+#include "color_math.h"
+#include "io.h"
+#include "machine_state.h"
+#include "sprites.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class PPU
+{
+	struct FreeState
+	{
+		void operator()(PpuState* state) const { freeAligned(state); }
+	};
+	std::unique_ptr<PpuState, FreeState> ownState;	// Set only for a PPU built on its own; System binds it to the arena
+public:
+	static constexpr uint32_t WIDTH = 256;
+	static constexpr uint32_t HEIGHT = 224;
+
+	using Latches = PpuLatches;
+
+	PPU();
+	explicit PPU(PpuState& state);
+	PPU(const PPU&) = delete;
+	PPU& operator=(const PPU&) = delete;
+	void attach(IoDispatcher& io);
+	void startFrame();
+	void renderScanline(uint32_t line);
+
+	// Sprite evaluation for a line that is not rendered, to keep the STAT77 flags exact
+	void evaluateSprites(uint32_t line);
+
+	// Call after OAM or the latches were overwritten other than through the ports
+	void invalidate() { sprites.touchAll(); }
+	Latches latches() const;
+	void restore(const Latches& state);
+
+	std::vector<uint16_t> framebuffer;	// BGR555, WIDTH * HEIGHT
+	Span<uint16_t> vram;				// 32K words
+	Span<uint16_t> cgram;				// 256 BGR555 colors
+	Span<uint8_t> oam;					// 512 byte low table + 32 byte high table
+	PpuLatches& regs;
+private:
+	void powerOn();
+	void drawSprites();
+	void buildWindows();
+	colormath::LineMask colorRegion(uint8_t region) const;
+	colormath::LineMask composeScreen(uint8_t layers, uint8_t masked, uint16_t backdrop, uint16_t* out, uint8_t select) const;
+	void writeMode7(uint16_t& target, uint8_t value);
+	uint16_t vramWordAddress() const;
+	void prefetchVram();
+	void stepVram();
+
+	std::array<uint8_t, WIDTH> layerLine = {};	// Scratch color indices for one layer
+	std::array<uint8_t, WIDTH> objLine = {};		// Sprite color index per pixel, 0 where none
+	std::array<uint8_t, WIDTH> objPriority = {};
+	std::array<uint16_t, WIDTH> mainLine = {};	// Composited screens ahead of color math
+	std::array<uint16_t, WIDTH> subLine = {};
+	std::array<colormath::LineMask, 6> windows = {};	// BG1-BG4, OBJ, color window for this line
+	SpriteEvaluator sprites;
+	SpriteEvaluator::Line spriteLine;
+};
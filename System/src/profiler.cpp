@@ -0,0 +1,211 @@
+#include "profiler.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char* phaseName(size_t phase)
+	{
+		static const char* names[] = { "cpu dispatch", "memory map", "render", "audio" };
+		return names[phase];
+	}
+
+#ifdef __linux__
+	const uint64_t EVENTS[PhaseProfiler::CounterCount] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_BRANCH_MISSES,
+		PERF_COUNT_HW_CACHE_MISSES
+	};
+
+	// Reads a counter from its mmap page with rdpmc where the kernel allows it, else
+	// through read(). Sequence loop as documented for perf_event_mmap_page.
+	uint64_t readCounter(int fd, void* page)
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		if (page)
+		{
+			volatile perf_event_mmap_page* info = static_cast<perf_event_mmap_page*>(page);
+			uint32_t seq;
+			uint64_t value;
+			bool direct;
+			do
+			{
+				seq = info->lock;
+				__sync_synchronize();
+				uint32_t index = info->index;
+				value = info->offset;
+				direct = info->cap_user_rdpmc && index;
+				if (direct)
+				{
+					uint32_t low, high;
+					__asm__ volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(index - 1));
+					uint32_t width = info->pmc_width;
+					int64_t pmc = int64_t((uint64_t(high) << 32) | low);
+					pmc <<= 64 - width;
+					pmc >>= 64 - width;
+					value += pmc;
+				}
+				__sync_synchronize();
+			} while (info->lock != seq);
+			if (direct)
+				return value;
+		}
+#endif
+		uint64_t value = 0;
+		if (::read(fd, &value, sizeof(value)) != ssize_t(sizeof(value)))
+			return 0;
+		return value;
+	}
+#endif
+}
+
+PhaseProfiler::~PhaseProfiler()
+{
+	close();
+}
+
+bool PhaseProfiler::open()
+{
+	close();
+#ifdef __linux__
+	for (size_t i = 0; i < CounterCount; ++i)
+	{
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = EVENTS[i];
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		// Counts this thread only, the one running the System
+		fds[i] = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+		if (fds[i] < 0)
+		{
+			close();
+			return false;
+		}
+		void* page = mmap(nullptr, size_t(sysconf(_SC_PAGESIZE)), PROT_READ, MAP_SHARED, fds[i], 0);
+		pages[i] = page == MAP_FAILED ? nullptr : page;
+	}
+	for (int fd : fds)
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	enabled = true;
+	reset();
+	return true;
+#else
+	return false;
+#endif
+}
+
+void PhaseProfiler::close()
+{
+#ifdef __linux__
+	for (size_t i = 0; i < CounterCount; ++i)
+	{
+		if (pages[i])
+			munmap(pages[i], size_t(sysconf(_SC_PAGESIZE)));
+		if (fds[i] >= 0)
+			::close(fds[i]);
+		pages[i] = nullptr;
+		fds[i] = -1;
+	}
+#endif
+	enabled = false;
+}
+
+void PhaseProfiler::reset()
+{
+	std::memset(totals, 0, sizeof(totals));
+	std::memset(visits, 0, sizeof(visits));
+	std::memset(skipped, 0, sizeof(skipped));
+	depth = 0;
+	if (enabled)
+		sample(last);
+}
+
+void PhaseProfiler::sample(uint64_t* values)
+{
+#ifdef __linux__
+	for (size_t i = 0; i < CounterCount; ++i)
+		values[i] = readCounter(fds[i], pages[i]);
+#else
+	std::memset(values, 0, sizeof(uint64_t) * CounterCount);
+#endif
+}
+
+void PhaseProfiler::charge()
+{
+	uint64_t now[CounterCount];
+	sample(now);
+	if (depth)
+	{
+		size_t top = (depth < MAX_DEPTH ? depth : MAX_DEPTH) - 1;
+		const Frame& frame = stack[top];
+		uint64_t* phase = totals[size_t(frame.phase)];
+		for (size_t i = 0; i < CounterCount; ++i)
+			phase[i] += (now[i] - last[i]) * frame.weight;
+
+		// The visits that were not measured ran, and were charged, in the outer phase
+		if (frame.weight > 1 && top)
+		{
+			uint64_t* outer = totals[size_t(stack[top - 1].phase)];
+			for (size_t i = 0; i < CounterCount; ++i)
+				outer[i] -= (now[i] - last[i]) * (frame.weight - 1);
+		}
+	}
+	std::memcpy(last, now, sizeof(last));
+}
+
+void PhaseProfiler::enter(ProfilePhase phase, uint32_t weight)
+{
+	if (!enabled)
+		return;
+	charge();
+	visits[size_t(phase)] += weight;
+	if (depth < MAX_DEPTH)
+		stack[depth] = { phase, weight };
+	++depth;
+}
+
+void PhaseProfiler::exit()
+{
+	if (!enabled || !depth)
+		return;
+	charge();
+	--depth;
+}
+
+std::string PhaseProfiler::report() const
+{
+	uint64_t allCycles = 0;
+	for (size_t phase = 0; phase < size_t(ProfilePhase::Count); ++phase)
+		allCycles += totals[phase][Cycles];
+
+	std::string text;
+	char line[200];
+	snprintf(line, sizeof(line), "%-13s %14s %14s %6s %12s %12s %6s\n",
+		"phase", "cycles", "instructions", "ipc", "branch miss", "cache miss", "share");
+	text += line;
+	for (size_t phase = 0; phase < size_t(ProfilePhase::Count); ++phase)
+	{
+		const uint64_t* counts = totals[phase];
+		double ipc = counts[Cycles] ? double(counts[Instructions]) / counts[Cycles] : 0.0;
+		double share = allCycles ? 100.0 * counts[Cycles] / allCycles : 0.0;
+		snprintf(line, sizeof(line), "%-13s %14llu %14llu %6.2f %12llu %12llu %5.1f%%\n",
+			phaseName(phase), (unsigned long long)counts[Cycles], (unsigned long long)counts[Instructions], ipc,
+			(unsigned long long)counts[BranchMisses], (unsigned long long)counts[CacheMisses], share);
+		text += line;
+	}
+	return text;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+
+enum class ProfilePhase : uint8_t
+{
+	CpuDispatch,	// Fetch, decode and the opcode handler call, excluding map accesses
+	MemoryMap,		// MemoryMap read/write/fetch: lookup plus the handler
+	Render,
+	Audio,
+	Count
+};
+
+// Hardware counters (Linux perf_event) attributed to emulator phases. Phases
+// nest; time in an inner phase is not charged to the outer one. Counting is
+// user space only. Where perf is unavailable open() fails and nothing is recorded.
+// A phase entered very often can be sampled: only every Nth visit reads the
+// counters, and its charge is scaled by N and taken back out of the outer phase.
+class PhaseProfiler
+{
+public:
+	enum Counter
+	{
+		Cycles,
+		Instructions,
+		BranchMisses,
+		CacheMisses,
+		CounterCount
+	};
+
+	PhaseProfiler() {}
+	virtual ~PhaseProfiler();
+	PhaseProfiler(const PhaseProfiler&) = delete;
+	PhaseProfiler& operator=(const PhaseProfiler&) = delete;
+
+	bool open();
+	void close();
+	bool active() const { return enabled; }
+	void reset();
+
+	void enter(ProfilePhase phase, uint32_t weight = 1);
+	void exit();
+
+	// True on every `every`th call for the phase, when the visit should be measured
+	bool due(ProfilePhase phase, uint32_t every)
+	{
+		if (!enabled || ++skipped[size_t(phase)] < every)
+			return false;
+		skipped[size_t(phase)] = 0;
+		return true;
+	}
+
+	// Sampled estimates can dip below zero on a short run; report those as zero
+	uint64_t count(ProfilePhase phase, Counter counter) const
+	{
+		uint64_t total = totals[size_t(phase)][counter];
+		return int64_t(total) < 0 ? 0 : total;
+	}
+	uint64_t entries(ProfilePhase phase) const { return visits[size_t(phase)]; }
+	std::string report() const;
+
+	class Scope
+	{
+	public:
+		Scope(PhaseProfiler* profiler, ProfilePhase phase, uint32_t every = 1)
+			: profiler(profiler && profiler->due(phase, every) ? profiler : nullptr)
+		{
+			if (this->profiler)
+				this->profiler->enter(phase, every);
+		}
+		~Scope()
+		{
+			if (profiler)
+				profiler->exit();
+		}
+	private:
+		PhaseProfiler* profiler;
+	};
+protected:
+	// Current value of every counter; overridden by tests
+	virtual void sample(uint64_t* values);
+	bool enabled = false;
+private:
+	void charge();
+
+	struct Frame
+	{
+		ProfilePhase phase;
+		uint32_t weight;
+	};
+
+	static constexpr size_t MAX_DEPTH = 8;
+	std::array<Frame, MAX_DEPTH> stack = {};
+	size_t depth = 0;
+	uint64_t last[CounterCount] = {};
+	uint64_t totals[size_t(ProfilePhase::Count)][CounterCount] = {};
+	uint64_t visits[size_t(ProfilePhase::Count)] = {};
+	uint32_t skipped[size_t(ProfilePhase::Count)] = {};
+
+	int fds[CounterCount] = { -1, -1, -1, -1 };
+	void* pages[CounterCount] = {};
+};
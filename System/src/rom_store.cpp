@@ -0,0 +1,60 @@
+#include "rom_store.h"
+
+RomStore& RomStore::instance()
+{
+	static RomStore store;
+	return store;
+}
+
+RomImage RomStore::intern(const std::vector<uint8_t>& data, uint64_t* hashed)
+{
+	uint64_t key = hash(data);
+	if (hashed)
+		*hashed = key;
+	std::lock_guard<std::mutex> lock(mutex);
+	prune();
+
+	auto range = images.equal_range(key);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		RomImage image = it->second.lock();
+		if (image && *image == data)
+			return image;
+	}
+
+	// Not make_shared: the bytes must be freed with the last user, not the last weak reference
+	RomImage image(new std::vector<uint8_t>(data));
+	images.emplace(key, image);
+	return image;
+}
+
+size_t RomStore::liveImages()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	prune();
+	return images.size();
+}
+
+// Drops entries whose image every System has released, whatever their key. Called with the mutex held.
+void RomStore::prune()
+{
+	for (auto it = images.begin(); it != images.end();)
+	{
+		if (it->second.expired())
+			it = images.erase(it);
+		else
+			++it;
+	}
+}
+
+uint64_t RomStore::hash(const std::vector<uint8_t>& data)
+{
+	// FNV-1a
+	uint64_t h = 0xCBF29CE484222325ull;
+	for (uint8_t byte : data)
+	{
+		h ^= byte;
+		h *= 0x100000001B3ull;
+	}
+	return h ^ data.size();
+}
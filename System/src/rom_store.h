@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+using RomImage = std::shared_ptr<const std::vector<uint8_t>>;
+
+// Process-wide store of read-only cartridge images. Loading the same game into
+// any number of System instances maps one shared copy of its bytes.
+class RomStore
+{
+public:
+	static RomStore& instance();
+
+	// Stores hash(data) in hashed, if given, so callers need not hash the image again
+	RomImage intern(const std::vector<uint8_t>& data, uint64_t* hashed = nullptr);
+	size_t liveImages();
+	static uint64_t hash(const std::vector<uint8_t>& data);
+private:
+	RomStore() {}
+	void prune();
+
+	std::mutex mutex;
+	std::unordered_multimap<uint64_t, std::weak_ptr<const std::vector<uint8_t>>> images;
+};
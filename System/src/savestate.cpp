@@ -0,0 +1,238 @@
+#include "savestate.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char MAGIC[8] = { 'S', 'N', 'S', 'T', 'A', 'T', 'E', '\0' };
+
+	size_t alignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+constexpr uint32_t SaveStateWriter::VERSION;
+constexpr size_t SaveStateWriter::ALIGNMENT;
+constexpr size_t SaveStateWriter::MAX_SECTIONS;
+
+bool SaveStateWriter::add(uint32_t id, uint32_t version, const void* data, size_t size)
+{
+	if (count == MAX_SECTIONS)
+		return false;
+	sections[count++] = { id, version, data, size };
+	return true;
+}
+
+void SaveStateWriter::build(std::vector<uint8_t>& out) const
+{
+	size_t tableEnd = sizeof(SaveStateHeader) + count * sizeof(SaveStateSection);
+	size_t total = alignUp(tableEnd, ALIGNMENT);
+	for (size_t i = 0; i < count; ++i)
+		total = alignUp(total + sections[i].size, ALIGNMENT);
+
+	out.resize(total);
+	std::memset(out.data(), 0, alignUp(tableEnd, ALIGNMENT));
+
+	SaveStateHeader header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.sectionCount = uint32_t(count);
+	header.fileSize = total;
+	std::memcpy(out.data(), &header, sizeof(header));
+
+	size_t offset = alignUp(tableEnd, ALIGNMENT);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Pending& pending = sections[i];
+		SaveStateSection entry = {};
+		entry.id = pending.id;
+		entry.version = pending.version;
+		entry.offset = offset;
+		entry.size = pending.size;
+		std::memcpy(out.data() + sizeof(header) + i * sizeof(entry), &entry, sizeof(entry));
+
+		size_t next = alignUp(offset + pending.size, ALIGNMENT);
+		if (pending.size)
+			std::memcpy(out.data() + offset, pending.data, pending.size);
+		std::memset(out.data() + offset + pending.size, 0, next - offset - pending.size);
+		offset = next;
+	}
+}
+
+bool SaveStateWriter::writeFile(const std::string& path, const std::vector<uint8_t>& bytes)
+{
+	// Written beside the target and renamed, so a crash never leaves a torn checkpoint
+	std::string temporary = path + ".tmp";
+	FILE* file = std::fopen(temporary.c_str(), "wb");
+	if (!file)
+		return false;
+	bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	ok = std::fclose(file) == 0 && ok;
+	if (!ok)
+	{
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	std::remove(path.c_str());
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+SaveStateView::~SaveStateView()
+{
+	close();
+}
+
+bool SaveStateView::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size = {};
+	GetFileSizeEx(handle, &size);
+	HANDLE view = size.QuadPart > 0 ? CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	if (view)
+		mapping = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+	if (mapping)
+	{
+		file = intptr_t(handle);
+		section = intptr_t(view);
+		base = static_cast<const uint8_t*>(mapping);
+		length = size_t(size.QuadPart);
+	}
+	else
+	{
+		if (view)
+			CloseHandle(view);
+		CloseHandle(handle);
+	}
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info = {};
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+	{
+		void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view != MAP_FAILED)
+		{
+			mapping = view;
+			file = fd;
+			base = static_cast<const uint8_t*>(view);
+			length = size_t(info.st_size);
+		}
+	}
+	if (!mapping)
+		::close(fd);
+#endif
+
+	if (!mapping)
+	{
+		FILE* in = std::fopen(path.c_str(), "rb");
+		if (!in)
+			return false;
+		std::fseek(in, 0, SEEK_END);
+		long size = std::ftell(in);
+		std::fseek(in, 0, SEEK_SET);
+		buffer.resize(size > 0 ? size_t(size) : 0);
+		bool ok = std::fread(buffer.data(), 1, buffer.size(), in) == buffer.size();
+		std::fclose(in);
+		if (!ok)
+			return false;
+		base = buffer.data();
+		length = buffer.size();
+	}
+
+	if (!validate())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool SaveStateView::open(const uint8_t* data, size_t size)
+{
+	close();
+	base = data;
+	length = size;
+	if (!validate())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void SaveStateView::close()
+{
+	if (mapping)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(mapping);
+		CloseHandle(HANDLE(section));
+		CloseHandle(HANDLE(file));
+#else
+		munmap(mapping, length);
+		::close(int(file));
+#endif
+	}
+	mapping = nullptr;
+	file = -1;
+	section = 0;
+	buffer.clear();
+	base = nullptr;
+	length = 0;
+}
+
+const void* SaveStateView::find(uint32_t id, uint32_t version, size_t size) const
+{
+	if (!base)
+		return nullptr;
+
+	const SaveStateHeader* header = reinterpret_cast<const SaveStateHeader*>(base);
+	const SaveStateSection* table = reinterpret_cast<const SaveStateSection*>(base + sizeof(SaveStateHeader));
+	for (uint32_t i = 0; i < header->sectionCount; ++i)
+	{
+		if (table[i].id == id)
+			return table[i].version == version && table[i].size == size ? base + table[i].offset : nullptr;
+	}
+	return nullptr;
+}
+
+bool SaveStateView::validate()
+{
+	// Everything find() relies on is checked once here
+	if (length < sizeof(SaveStateHeader))
+		return false;
+
+	const SaveStateHeader* header = reinterpret_cast<const SaveStateHeader*>(base);
+	if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != SaveStateWriter::VERSION || header->fileSize != length)
+		return false;
+	if (header->sectionCount > (length - sizeof(SaveStateHeader)) / sizeof(SaveStateSection))
+		return false;
+
+	const SaveStateSection* table = reinterpret_cast<const SaveStateSection*>(base + sizeof(SaveStateHeader));
+	for (uint32_t i = 0; i < header->sectionCount; ++i)
+	{
+		const SaveStateSection& entry = table[i];
+		if (entry.offset % SaveStateWriter::ALIGNMENT != 0 || entry.offset > length || entry.size > length - entry.offset)
+			return false;
+	}
+	return true;
+}
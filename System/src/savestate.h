@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string>
+#include <vector>
+
+// On-disk save states: a 64 byte header, a section table, then each section's
+// raw bytes at a 64 byte aligned offset. Loading maps the file and hands out
+// pointers into it, so restoring is a bounds check and one copy per section.
+//
+//   header   "SNSTATE\0", format version, section count, file size
+//   table    { id, section version, offset, size } per section
+//   data     CPU, TIME, PPU, WRAM, VRAM, CGRM, OAM, SRAM, ROM sections
+
+constexpr uint32_t sectionId(const char (&tag)[5])
+{
+	return uint32_t(uint8_t(tag[0])) | (uint32_t(uint8_t(tag[1])) << 8) | (uint32_t(uint8_t(tag[2])) << 16) | (uint32_t(uint8_t(tag[3])) << 24);
+}
+
+struct SaveStateHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t sectionCount;
+	uint64_t fileSize;
+	uint8_t reserved[40];
+};
+
+struct SaveStateSection
+{
+	uint32_t id;
+	uint32_t version;
+	uint64_t offset;
+	uint64_t size;
+	uint64_t reserved;
+};
+
+static_assert(sizeof(SaveStateHeader) == 64, "header layout is part of the file format");
+static_assert(sizeof(SaveStateSection) == 32, "section layout is part of the file format");
+
+// Collects section pointers (the data must outlive build) and lays them out.
+// Building into a buffer that already has the capacity does not allocate.
+class SaveStateWriter
+{
+public:
+	static constexpr uint32_t VERSION = 1;
+	static constexpr size_t ALIGNMENT = 64;
+	static constexpr size_t MAX_SECTIONS = 16;
+
+	bool add(uint32_t id, uint32_t version, const void* data, size_t size);
+	void build(std::vector<uint8_t>& out) const;
+	static bool writeFile(const std::string& path, const std::vector<uint8_t>& bytes);
+private:
+	struct Pending
+	{
+		uint32_t id;
+		uint32_t version;
+		const void* data;
+		size_t size;
+	};
+	std::array<Pending, MAX_SECTIONS> sections = {};
+	size_t count = 0;
+};
+
+// Read-only view of a state file or buffer. Cheap to share: any number of
+// machines can restore from one open view.
+class SaveStateView
+{
+public:
+	SaveStateView() {}
+	~SaveStateView();
+	SaveStateView(const SaveStateView&) = delete;
+	SaveStateView& operator=(const SaveStateView&) = delete;
+
+	bool open(const std::string& path);
+	bool open(const uint8_t* data, size_t size);	// Caller keeps data alive
+	void close();
+
+	// Null unless the section exists with this version and exact size
+	const void* find(uint32_t id, uint32_t version, size_t size) const;
+
+	template <class T>
+	const T* find(uint32_t id, uint32_t version) const
+	{
+		return static_cast<const T*>(find(id, version, sizeof(T)));
+	}
+private:
+	bool validate();
+
+	const uint8_t* base = nullptr;
+	size_t length = 0;
+	void* mapping = nullptr;
+	intptr_t file = -1;
+	intptr_t section = 0;
+	std::vector<uint8_t> buffer;	// Used when the file cannot be mapped
+};
@@ -0,0 +1,67 @@
+#include "scheduler.h"
+#include "cpu.h"
+#include <algorithm>
+
+constexpr uint64_t Scheduler::NEVER;
+
+Scheduler::Scheduler() : Scheduler(nullptr)
+{
+
+}
+
+Scheduler::Scheduler(uint64_t* deadlines) : times(deadlines ? deadlines : ownTimes.data())
+{
+	std::fill(times, times + size_t(Event::Count), NEVER);
+}
+
+void Scheduler::setHandler(Event event, EventHandler handler, void* context)
+{
+	Slot& slot = slots[size_t(event)];
+	slot.handler = handler;
+	slot.context = context;
+}
+
+void Scheduler::schedule(Event event, uint64_t time)
+{
+	times[size_t(event)] = time;
+	updateNext();
+}
+
+void Scheduler::cancel(Event event)
+{
+	schedule(event, NEVER);
+}
+
+void Scheduler::dispatch(uint64_t now)
+{
+	while (nextTime <= now)
+	{
+		size_t due = 0;
+		while (times[due] != nextTime)
+			++due;
+
+		// One-shot: the handler reschedules itself if it repeats
+		uint64_t time = times[due];
+		times[due] = NEVER;
+		updateNext();
+		const Slot& slot = slots[due];
+		if (slot.handler)
+			slot.handler(slot.context, time);
+	}
+}
+
+void Scheduler::run(CPU& cpu, uint64_t target)
+{
+	while (cpu.running && cpu.cycles < target)
+	{
+		cpu.runUntil(std::min(target, nextTime));
+		dispatch(cpu.cycles);
+	}
+}
+
+void Scheduler::updateNext()
+{
+	nextTime = NEVER;
+	for (size_t i = 0; i < size_t(Event::Count); ++i)
+		nextTime = std::min(nextTime, times[i]);
+}
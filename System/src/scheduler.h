@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <cstddef>
+
+class CPU;
+
+enum class Event : uint8_t
+{
+	VBlankStart,
+	VBlankEnd,
+	HvTimer,
+	Count
+};
+
+using EventHandler = void(*)(void* context, uint64_t time);
+
+// Timed hardware events on the master clock. The CPU runs freely up to the
+// next event instead of polling timers every instruction.
+class Scheduler
+{
+	std::array<uint64_t, size_t(Event::Count)> ownTimes;	// Used unless constructed on an external arena
+public:
+	static constexpr uint64_t NEVER = ~uint64_t(0);
+
+	Scheduler();
+	explicit Scheduler(uint64_t* deadlines);	// Event::Count entries, e.g. TimingState::events; null for own storage
+	Scheduler(const Scheduler&) = delete;
+	Scheduler& operator=(const Scheduler&) = delete;
+
+	void setHandler(Event event, EventHandler handler, void* context);
+	void schedule(Event event, uint64_t time);
+	void cancel(Event event);
+	uint64_t next() const { return nextTime; }
+	uint64_t time(Event event) const { return times[size_t(event)]; }
+
+	// Recomputes the next deadline after the times were overwritten in place
+	void resync() { updateNext(); }
+
+	// Fires every event due at or before now, in time order
+	void dispatch(uint64_t now);
+
+	// Runs the CPU to target, servicing events as they come due
+	void run(CPU& cpu, uint64_t target);
+private:
+	struct Slot
+	{
+		EventHandler handler = nullptr;
+		void* context = nullptr;
+	};
+
+	void updateNext();
+
+	uint64_t* times;
+	std::array<Slot, size_t(Event::Count)> slots = {};
+	uint64_t nextTime = NEVER;
+};
@@ -0,0 +1,189 @@
+#include "sprites.h"
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+constexpr size_t SpriteEvaluator::SPRITES;
+constexpr size_t SpriteEvaluator::LINE_SPRITES;
+constexpr size_t SpriteEvaluator::LINE_TILES;
+constexpr uint8_t SpriteEvaluator::RANGE_OVER;
+constexpr uint8_t SpriteEvaluator::TIME_OVER;
+
+namespace
+{
+	uint32_t lowestBit(uint64_t bits)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, bits);
+		return uint32_t(index);
+#else
+		return uint32_t(__builtin_ctzll(bits));
+#endif
+	}
+
+	struct Entry
+	{
+		int32_t x;			// -256 to 255
+		uint8_t y;
+		uint16_t tile;		// Name select bit and tile number
+		uint8_t attributes;	// vhoopppN
+		bool large;
+	};
+
+	Entry readEntry(const uint8_t* oam, uint32_t sprite)
+	{
+		const uint8_t* low = oam + sprite * 4;
+		uint8_t high = uint8_t(oam[0x200 + (sprite >> 2)] >> ((sprite & 3) * 2));
+
+		Entry entry;
+		entry.x = int32_t(low[0] | ((high & 0x01) << 8));
+		if (entry.x >= 256)
+			entry.x -= 512;
+		entry.y = low[1];
+		entry.tile = uint16_t(low[2] | ((low[3] & 0x01) << 8));
+		entry.attributes = low[3];
+		entry.large = (high & 0x02) != 0;
+		return entry;
+	}
+
+	// On screen for the range check; X = -256 counts even though none of it is visible
+	bool inRange(int32_t x, uint8_t width)
+	{
+		return (x > -int32_t(width) && x < 256) || x == -256;
+	}
+}
+
+SpriteEvaluator::SpriteEvaluator()
+{
+	for (auto& line : lines)
+		line.fill(0);
+	touchAll();
+}
+
+void SpriteEvaluator::evaluate(uint32_t line, const uint8_t* oam, const PpuLatches& regs, Line& out)
+{
+	refresh(oam, regs.obsel);
+
+	out.tileCount = 0;
+	out.spriteCount = 0;
+	out.flags = 0;
+
+	// Priority rotation starts the walk at the sprite OAMADD pointed to
+	uint32_t first = regs.oamPriority ? (regs.oamReload >> 2) & 0x7F : 0;
+	const std::array<uint64_t, 2>& onLine = lines[line & 0xFF];
+	std::array<uint8_t, LINE_SPRITES> selected;
+
+	for (uint32_t pass = 0; pass < 2 && !(out.flags & RANGE_OVER); ++pass)
+	{
+		uint32_t from = pass ? 0 : first;
+		uint32_t to = pass ? first : uint32_t(SPRITES);
+		for (uint32_t word = from >> 6; word < 2 && word * 64 < to; ++word)
+		{
+			uint64_t bits = onLine[word];
+			if (word * 64 < from)
+				bits &= ~uint64_t(0) << (from & 63);
+			if (to < (word + 1) * 64)
+				bits &= (uint64_t(1) << (to & 63)) - 1;
+
+			for (; bits; bits &= bits - 1)
+			{
+				if (out.spriteCount == LINE_SPRITES)
+				{
+					out.flags |= RANGE_OVER;
+					break;
+				}
+				selected[out.spriteCount++] = uint8_t(word * 64 + lowestBit(bits));
+			}
+			if (out.flags & RANGE_OVER)
+				break;
+		}
+	}
+
+	// Slivers are fetched from the last selected sprite back to the first, so time over drops the front ones
+	uint8_t obsel = regs.obsel;
+	uint32_t nameBase = uint32_t(obsel & 0x07) << 13;
+	uint32_t nameGap = uint32_t(((obsel >> 3) & 0x03) + 1) << 12;
+	const SpriteSize* sizes = SPRITE_SIZES[obsel >> 5];
+	for (size_t i = out.spriteCount; i-- > 0 && !(out.flags & TIME_OVER);)
+	{
+		Entry entry = readEntry(oam, selected[i]);
+		SpriteSize size = sizes[entry.large];
+		uint32_t row = (line - entry.y) & 0xFF;
+		if (entry.attributes & 0x80)
+			row = size.height - 1 - row;
+		bool flip = (entry.attributes & 0x40) != 0;
+		uint32_t columns = size.width / 8;
+
+		for (uint32_t column = 0; column < columns; ++column)
+		{
+			int32_t x = entry.x + int32_t(column * 8);
+			if (x <= -8 || x >= 256)
+				continue;
+			if (out.tileCount == LINE_TILES)
+			{
+				out.flags |= TIME_OVER;
+				break;
+			}
+
+			// Tiles wrap within their 16x16 block of the name table
+			uint32_t tileColumn = flip ? columns - 1 - column : column;
+			uint32_t tile = (entry.tile & 0x100)
+				| ((((entry.tile >> 4) + (row >> 3)) & 0x0F) << 4)
+				| ((entry.tile + tileColumn) & 0x0F);
+			uint32_t address = nameBase + ((tile & 0x100) ? nameGap : 0) + (tile & 0xFF) * 16 + (row & 7);
+
+			Tile& sliver = out.tiles[out.tileCount++];
+			sliver.x = int16_t(x);
+			sliver.address = uint16_t(address & 0x7FFF);
+			sliver.palette = uint8_t(0x80 + ((entry.attributes >> 1) & 0x07) * 16);
+			sliver.priority = (entry.attributes >> 4) & 0x03;
+			sliver.flip = flip;
+		}
+	}
+	std::reverse(out.tiles.begin(), out.tiles.begin() + out.tileCount);
+}
+
+void SpriteEvaluator::refresh(const uint8_t* oam, uint8_t obsel)
+{
+	uint8_t setting = obsel >> 5;
+	if (setting != sizeSetting)
+	{
+		sizeSetting = setting;
+		touchAll();
+	}
+
+	for (uint32_t word = 0; word < 2; ++word)
+	{
+		for (uint64_t bits = dirty[word]; bits; bits &= bits - 1)
+			place(word * 64 + lowestBit(bits), oam, setting);
+		dirty[word] = 0;
+	}
+}
+
+void SpriteEvaluator::place(uint32_t sprite, const uint8_t* oam, uint8_t setting)
+{
+	setLines(sprite, placements[sprite], false);
+
+	Entry entry = readEntry(oam, sprite);
+	SpriteSize size = SPRITE_SIZES[setting][entry.large];
+	Placement placement;
+	if (inRange(entry.x, size.width))
+	{
+		placement.top = entry.y;
+		placement.height = size.height;
+	}
+	placements[sprite] = placement;
+	setLines(sprite, placement, true);
+}
+
+void SpriteEvaluator::setLines(uint32_t sprite, const Placement& placement, bool on)
+{
+	uint64_t bit = uint64_t(1) << (sprite & 63);
+	for (uint32_t i = 0; i < placement.height; ++i)
+	{
+		uint64_t& word = lines[(placement.top + i) & 0xFF][sprite >> 6];
+		word = on ? (word | bit) : (word & ~bit);
+	}
+}
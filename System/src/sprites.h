@@ -0,0 +1,78 @@
+#pragma once
+#include "machine_state.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct SpriteSize
+{
+	uint8_t width;
+	uint8_t height;
+};
+
+// Small and large sprite dimensions for each OBSEL size setting (bits 5-7)
+constexpr SpriteSize SPRITE_SIZES[8][2] = {
+	{ { 8, 8 }, { 16, 16 } },
+	{ { 8, 8 }, { 32, 32 } },
+	{ { 8, 8 }, { 64, 64 } },
+	{ { 16, 16 }, { 32, 32 } },
+	{ { 16, 16 }, { 64, 64 } },
+	{ { 32, 32 }, { 64, 64 } },
+	{ { 16, 32 }, { 32, 64 } },
+	{ { 16, 32 }, { 32, 32 } },
+};
+
+// Per-line sprite lists built from OAM. Each sprite's line coverage is kept as
+// a 128-bit set per line, so a line walks only the sprites on it. Coverage is
+// updated only for sprites whose OAM entry changed since the last line, which
+// after the first frame means only when OAM is written.
+class SpriteEvaluator
+{
+public:
+	static constexpr size_t SPRITES = 128;
+	static constexpr size_t LINE_SPRITES = 32;	// More in range sets range over
+	static constexpr size_t LINE_TILES = 34;	// More fetched slivers sets time over
+	static constexpr uint8_t RANGE_OVER = 0x40;	// STAT77 bits
+	static constexpr uint8_t TIME_OVER = 0x80;
+
+	// One 8-pixel sliver of a sprite row
+	struct Tile
+	{
+		int16_t x;
+		uint16_t address;	// VRAM word address of the row's planes 0/1; planes 2/3 follow 8 words later
+		uint8_t palette;	// CGRAM index of color 0
+		uint8_t priority;
+		uint8_t flip;		// Horizontal flip
+	};
+
+	struct Line
+	{
+		std::array<Tile, LINE_TILES> tiles;	// In OAM order, highest priority first
+		size_t tileCount = 0;
+		size_t spriteCount = 0;
+		uint8_t flags = 0;					// RANGE_OVER | TIME_OVER
+	};
+
+	SpriteEvaluator();
+
+	void touch(uint32_t sprite) { dirty[sprite >> 6] |= uint64_t(1) << (sprite & 63); }
+	void touchAll() { dirty.fill(~uint64_t(0)); }
+
+	// Builds the sprite list for a framebuffer line (hardware line + 1)
+	void evaluate(uint32_t line, const uint8_t* oam, const PpuLatches& regs, Line& out);
+private:
+	struct Placement
+	{
+		uint8_t top = 0;
+		uint8_t height = 0;		// 0 while not on any line
+	};
+
+	void refresh(const uint8_t* oam, uint8_t obsel);
+	void place(uint32_t sprite, const uint8_t* oam, uint8_t sizeSetting);
+	void setLines(uint32_t sprite, const Placement& placement, bool on);
+
+	std::array<std::array<uint64_t, 2>, 256> lines;
+	std::array<Placement, SPRITES> placements;
+	std::array<uint64_t, 2> dirty;
+	uint8_t sizeSetting = 0;
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded single-producer/single-consumer ring. push() is only called from one
+// thread and pop() from one other; neither blocks or allocates.
+template <class T, size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity && !(Capacity & (Capacity - 1)), "Capacity must be a power of two");
+public:
+	bool push(const T& value)
+	{
+		size_t tail = tailIndex.load(std::memory_order_relaxed);
+		if (tail - headCache == Capacity)
+		{
+			headCache = headIndex.load(std::memory_order_acquire);
+			if (tail - headCache == Capacity)
+				return false;
+		}
+		slots[tail & (Capacity - 1)] = value;
+		tailIndex.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& value)
+	{
+		size_t head = headIndex.load(std::memory_order_relaxed);
+		if (head == tailCache)
+		{
+			tailCache = tailIndex.load(std::memory_order_acquire);
+			if (head == tailCache)
+				return false;
+		}
+		value = slots[head & (Capacity - 1)];
+		headIndex.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const
+	{
+		return headIndex.load(std::memory_order_acquire) == tailIndex.load(std::memory_order_acquire);
+	}
+private:
+	// Producer and consumer state on separate cache lines so they do not false-share
+	alignas(64) std::atomic<size_t> tailIndex{ 0 };
+	size_t headCache = 0;		// Producer's last view of headIndex
+	alignas(64) std::atomic<size_t> headIndex{ 0 };
+	size_t tailCache = 0;		// Consumer's last view of tailIndex
+	alignas(64) std::array<T, Capacity> slots = {};
+};
@@ -0,0 +1,244 @@
+#include "sram.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SRAM::~SRAM()
+{
+	close();
+}
+
+uint32_t SRAM::pageSize()
+{
+	static const uint32_t size = []
+	{
+#ifdef _WIN32
+		SYSTEM_INFO info = {};
+		GetSystemInfo(&info);
+		return uint32_t(info.dwAllocationGranularity);
+#else
+		long page = sysconf(_SC_PAGESIZE);
+		return page > 0 ? uint32_t(page) : 4096u;
+#endif
+	}();
+	return size;
+}
+
+bool SRAM::open(const std::string& path, uint32_t size)
+{
+	close();
+
+	length = 1;
+	while (length < size)
+		length <<= 1;
+	mask = length - 1;
+	dirty.assign((length + pageSize() - 1) / pageSize(), false);
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER current = {};
+		GetFileSizeEx(handle, &current);
+		// CreateFileMapping grows the file when the mapping is larger
+		HANDLE view = CreateFileMappingA(handle, nullptr, PAGE_READWRITE, 0, current.QuadPart > length ? DWORD(current.QuadPart) : length, nullptr);
+		if (view)
+		{
+			mapping = MapViewOfFile(view, FILE_MAP_ALL_ACCESS, 0, 0, length);
+			if (mapping)
+			{
+				file = intptr_t(handle);
+				section = intptr_t(view);
+			}
+			else
+			{
+				CloseHandle(view);
+			}
+		}
+		if (!mapping)
+			CloseHandle(handle);
+	}
+#else
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd >= 0)
+	{
+		struct stat info = {};
+		bool sized = fstat(fd, &info) == 0 && (info.st_size >= off_t(length) || ftruncate(fd, length) == 0);
+		void* view = sized ? mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+		if (view != MAP_FAILED)
+		{
+			mapping = view;
+			file = fd;
+		}
+		else
+		{
+			::close(fd);
+		}
+	}
+#endif
+
+	if (mapping)
+	{
+		bytes = static_cast<uint8_t*>(mapping);
+		return true;
+	}
+
+	fallback.assign(length, 0x00);
+	bytes = fallback.data();
+	return false;
+}
+
+void SRAM::close()
+{
+	if (mapping)
+	{
+		flush(true);
+		unmap();
+	}
+	fallback.clear();
+	bytes = nullptr;
+	committed = nullptr;
+	length = 0;
+	mask = 0;
+	dirtyCount = 0;
+	framesSinceSync = 0;
+	if (map)
+		map->invalidate();
+}
+
+void SRAM::write(uint32_t address, uint8_t value)
+{
+	uint32_t offset = address & mask;
+	if (!length || bytes[offset] == value)
+		return;
+
+	bytes[offset] = value;
+	if (committed)
+		return;
+	size_t page = offset / pageSize();
+	if (!dirty[page])
+	{
+		dirty[page] = true;
+		++dirtyCount;
+	}
+}
+
+bool SRAM::assign(const uint8_t* source, uint32_t size)
+{
+	if (size != length)
+		return false;
+	// Through write() so only the pages that differ are marked for write-back
+	for (uint32_t i = 0; i < size; ++i)
+		write(i, source[i]);
+	return true;
+}
+
+void SRAM::speculate(uint8_t* scratch)
+{
+	if (committed || !length)
+		return;
+	std::copy(bytes, bytes + length, scratch);
+	committed = bytes;
+	bytes = scratch;
+	if (map)
+		map->invalidate();
+}
+
+void SRAM::endSpeculation()
+{
+	if (!committed)
+		return;
+	bytes = committed;
+	committed = nullptr;
+	if (map)
+		map->invalidate();
+}
+
+const uint8_t* SRAM::bytesAt(uint32_t offset, uint32_t& available)
+{
+	if (offset >= length)
+		return nullptr;
+	available = length - offset;
+	return bytes + offset;
+}
+
+void SRAM::endFrame()
+{
+	if (++framesSinceSync < syncInterval)
+		return;
+	framesSinceSync = 0;
+	if (dirtyCount)
+		flush(false);
+}
+
+bool SRAM::flush(bool wait)
+{
+	if (!mapping)
+	{
+		dirty.assign(dirty.size(), false);
+		dirtyCount = 0;
+		return true;
+	}
+
+	// Write back contiguous runs of dirty pages only
+	const size_t pageBytes = pageSize();
+	bool ok = true;
+	size_t pages = dirty.size();
+	for (size_t page = 0; page < pages && dirtyCount; ++page)
+	{
+		if (!dirty[page])
+			continue;
+
+		size_t last = page;
+		while (last + 1 < pages && dirty[last + 1])
+			++last;
+
+		uint8_t* start = bytes + page * pageBytes;
+		size_t size = std::min<size_t>((last + 1) * pageBytes, length) - page * pageBytes;
+#ifdef _WIN32
+		bool written = FlushViewOfFile(start, size) != 0;
+#else
+		bool written = msync(start, size, wait ? MS_SYNC : MS_ASYNC) == 0;
+#endif
+		// Failed runs stay dirty so the next flush tries them again
+		if (written)
+		{
+			for (size_t i = page; i <= last; ++i)
+				dirty[i] = false;
+			dirtyCount -= last - page + 1;
+		}
+		ok = ok && written;
+		page = last;
+	}
+
+#ifdef _WIN32
+	// FlushViewOfFile only queues the writes; make them durable on shutdown
+	if (wait && !FlushFileBuffers(HANDLE(file)))
+		ok = false;
+#endif
+	return ok;
+}
+
+void SRAM::unmap()
+{
+#ifdef _WIN32
+	UnmapViewOfFile(mapping);
+	CloseHandle(HANDLE(section));
+	CloseHandle(HANDLE(file));
+#else
+	munmap(mapping, length);
+	::close(int(file));
+#endif
+	mapping = nullptr;
+	file = -1;
+	section = 0;
+}
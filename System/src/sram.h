@@ -0,0 +1,59 @@
+#pragma once
+#include "memory.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Battery-backed cartridge RAM. The save file is mapped into memory, so writes
+// land in the page cache; dirty pages are written back every syncInterval
+// frames (asynchronously) and synchronously on close. Pages are the host's
+// (the allocation granularity on Windows). Reads before open() return 0.
+class SRAM : public MemoryHandler
+{
+public:
+	SRAM() {}
+	~SRAM();
+	SRAM(const SRAM&) = delete;
+	SRAM& operator=(const SRAM&) = delete;
+
+	// Size is rounded up to a power of two for mirroring. Falls back to
+	// unsaved memory and returns false if the file cannot be mapped.
+	bool open(const std::string& path, uint32_t size);
+	void close();
+
+	uint8_t read(uint32_t address) override { return length ? bytes[address & mask] : 0; }
+	void write(uint32_t address, uint8_t value) override;
+	const uint8_t* bytesAt(uint32_t offset, uint32_t& available) override;
+
+	// Called once per emulated frame; flushes when the interval has elapsed
+	void endFrame();
+	bool flush(bool wait = false);	// False if the OS reported a write-back error; the pages stay dirty
+	bool assign(const uint8_t* source, uint32_t size);
+
+	// Until endSpeculation(), accesses go to a copy in scratch (size() bytes) and
+	// nothing is marked dirty, so the save file never sees writes that get rewound
+	void speculate(uint8_t* scratch);
+	void endSpeculation();
+
+	uint32_t size() const { return length; }
+	const uint8_t* contents() const { return bytes; }
+	bool persistent() const { return mapping != nullptr; }
+	size_t dirtyPages() const { return dirtyCount; }
+	static uint32_t pageSize();
+	uint32_t syncInterval = 60;	// Frames between write-backs
+	MemoryMap* map = nullptr;		// Invalidated by close(), so no code window outlives the storage
+private:
+	void unmap();
+
+	uint8_t* bytes = nullptr;
+	uint8_t* committed = nullptr;	// The real storage while speculating
+	uint32_t length = 0;
+	uint32_t mask = 0;
+	void* mapping = nullptr;
+	intptr_t file = -1;
+	intptr_t section = 0;			// Windows file mapping handle
+	std::vector<uint8_t> fallback;
+	std::vector<bool> dirty;
+	size_t dirtyCount = 0;
+	uint32_t framesSinceSync = 0;
+};
@@ -1,21 +1,248 @@
 #include <iostream>
+#include <chrono>
 #include "system.h"
+#include "timing.h"
+#include "coverage.h"
+#include <cstring>
 
-System::System()
+namespace
 {
+	// Section layouts; bump a section's version when its struct changes
+	struct CpuSection
+	{
+		Registers registers;
+		uint64_t cycles;
+		uint8_t pendingInterrupts;
+		uint8_t running;
+	};
+
+	struct TimingSection
+	{
+		uint64_t frame;
+		uint64_t frameStart;
+		uint64_t events[size_t(Event::Count)];
+		uint16_t htime;
+		uint16_t vtime;
+		uint8_t nmitimen;
+		uint8_t nmiFlag;
+		uint8_t timeUp;
+		uint8_t reserved;
+	};
+
+	struct RomSection
+	{
+		uint64_t hash;
+		uint64_t size;
+	};
+
+	const uint32_t CPU_SECTION = sectionId("CPU ");
+	const uint32_t TIMING_SECTION = sectionId("TIME");
+	const uint32_t PPU_SECTION = sectionId("PPU ");
+	const uint32_t DMA_SECTION = sectionId("DMA ");
+	const uint32_t WRAM_SECTION = sectionId("WRAM");
+	const uint32_t VRAM_SECTION = sectionId("VRAM");
+	const uint32_t CGRAM_SECTION = sectionId("CGRM");
+	const uint32_t OAM_SECTION = sectionId("OAM ");
+	const uint32_t SRAM_SECTION = sectionId("SRAM");
+	const uint32_t ROM_SECTION = sectionId("ROM ");
+
+	// Current PPU section version; loadState upgrades the older layouts below
+	const uint32_t PPU_VERSION = 4;
+
+	// Version 1: VRAM, CGRAM and OAM ports and INIDISP
+	struct PpuLatchesV1
+	{
+		uint16_t vramAddress;
+		uint16_t vramLatch;
+		uint16_t oamAddress;
+		uint8_t vramStep;
+		uint8_t vramRemap;
+		uint8_t vramIncrementHigh;
+		uint8_t cgramAddress;
+		uint8_t cgramLatch;
+		uint8_t cgramHigh;
+		uint8_t oamLatch;
+		uint8_t forcedBlank;
+		uint8_t brightness;
+		uint8_t reserved;
+	};
+
+	template <class T>
+	void upgradePorts(const T& in, PpuLatches& out)
+	{
+		out.vramAddress = in.vramAddress;
+		out.vramLatch = in.vramLatch;
+		out.oamAddress = in.oamAddress;
+		out.vramStep = in.vramStep;
+		out.vramRemap = in.vramRemap;
+		out.vramIncrementHigh = in.vramIncrementHigh;
+		out.cgramAddress = in.cgramAddress;
+		out.cgramLatch = in.cgramLatch;
+		out.cgramHigh = in.cgramHigh;
+		out.oamLatch = in.oamLatch;
+		out.forcedBlank = in.forcedBlank;
+		out.brightness = in.brightness;
+	}
+
+	// Version 2 added BGMODE, TM, SETINI and the mode 7 registers
+	struct PpuLatchesV2
+	{
+		uint16_t vramAddress;
+		uint16_t vramLatch;
+		uint16_t oamAddress;
+		uint8_t vramStep;
+		uint8_t vramRemap;
+		uint8_t vramIncrementHigh;
+		uint8_t cgramAddress;
+		uint8_t cgramLatch;
+		uint8_t cgramHigh;
+		uint8_t oamLatch;
+		uint8_t forcedBlank;
+		uint8_t brightness;
+		uint8_t bgMode;
+		uint8_t mainScreen;
+		uint8_t setini;
+		uint8_t m7sel;
+		uint8_t m7latch;
+		uint8_t reserved;
+		uint16_t m7a;
+		uint16_t m7b;
+		uint16_t m7c;
+		uint16_t m7d;
+		uint16_t m7x;
+		uint16_t m7y;
+		uint16_t m7hofs;
+		uint16_t m7vofs;
+	};
+
+	static_assert(sizeof(PpuLatchesV1) == 16 && sizeof(PpuLatchesV2) == 38, "Old section layouts are fixed by files on disk");
+
+	template <class T>
+	void upgradeMode7(const T& in, PpuLatches& out)
+	{
+		upgradePorts(in, out);
+		out.bgMode = in.bgMode;
+		out.mainScreen = in.mainScreen;
+		out.setini = in.setini;
+		out.m7sel = in.m7sel;
+		out.m7latch = in.m7latch;
+		out.m7a = in.m7a;
+		out.m7b = in.m7b;
+		out.m7c = in.m7c;
+		out.m7d = in.m7d;
+		out.m7x = in.m7x;
+		out.m7y = in.m7y;
+		out.m7hofs = in.m7hofs;
+		out.m7vofs = in.m7vofs;
+	}
+
+	// Version 3 added OBSEL, STAT77 and the OAM priority rotation latches
+	struct PpuLatchesV3
+	{
+		uint16_t vramAddress;
+		uint16_t vramLatch;
+		uint16_t oamAddress;
+		uint8_t vramStep;
+		uint8_t vramRemap;
+		uint8_t vramIncrementHigh;
+		uint8_t cgramAddress;
+		uint8_t cgramLatch;
+		uint8_t cgramHigh;
+		uint8_t oamLatch;
+		uint8_t forcedBlank;
+		uint8_t brightness;
+		uint8_t bgMode;
+		uint8_t mainScreen;
+		uint8_t setini;
+		uint8_t m7sel;
+		uint8_t m7latch;
+		uint8_t obsel;
+		uint8_t objFlags;
+		uint8_t oamPriority;
+		uint16_t oamReload;
+		uint16_t m7a;
+		uint16_t m7b;
+		uint16_t m7c;
+		uint16_t m7d;
+		uint16_t m7x;
+		uint16_t m7y;
+		uint16_t m7hofs;
+		uint16_t m7vofs;
+	};
+
+	static_assert(sizeof(PpuLatchesV3) == 42, "Old section layouts are fixed by files on disk");
+
+	void upgradeSprites(const PpuLatchesV3& in, PpuLatches& out)
+	{
+		upgradeMode7(in, out);
+		out.obsel = in.obsel;
+		out.objFlags = in.objFlags;
+		out.oamPriority = in.oamPriority;
+		out.oamReload = in.oamReload;
+	}
+
+	// Latches an older section lacks stay zero, as after power on
+	bool readPpuLatches(const SaveStateView& state, PpuLatches& out)
+	{
+		out = PpuLatches();
+		if (auto current = state.find<PpuLatches>(PPU_SECTION, PPU_VERSION))
+		{
+			out = *current;
+			return true;
+		}
+		if (auto v3 = state.find<PpuLatchesV3>(PPU_SECTION, 3))
+		{
+			upgradeSprites(*v3, out);
+			return true;
+		}
+		if (auto v2 = state.find<PpuLatchesV2>(PPU_SECTION, 2))
+		{
+			upgradeMode7(*v2, out);
+			return true;
+		}
+		if (auto v1 = state.find<PpuLatchesV1>(PPU_SECTION, 1))
+		{
+			upgradePorts(*v1, out);
+			return true;
+		}
+		return false;
+	}
 
 }
 
+static_assert(MemoryMap::PAGE_COUNT == MachineState::PAGE_COUNT, "Page table lives in the arena");
+
+System::System()
+	: state(MachineStatePool::shared().acquire()),
+	cpu(state->cpu),
+	ppu(state->ppu),
+	scheduler(state->timing.events),
+	interrupts(state->io.interrupts),
+	dma(state->dma),
+	bus(*state),
+	controllers(state->io.joypads),
+	frame(state->timing.frame),
+	frameStart(state->timing.frameStart)
+{
+	sram.map = &bus.map;
+}
+
 void System::init()
 {
-	ram.load(0x20000);
+	bus.wram.fill(0xFF);
 
-	memory.map(0x7E0000, 0x7FFFFF, &ram);
-	memory.map(0x008000, 0x008000 + rom.size() - 1, &rom);
+	ppu.attach(bus.io);
+	interrupts.attach(cpu, bus.io, scheduler);
+	dma.attach(cpu, bus.io, bus.map);
+	controllers.attach(bus.io);
 
-	cpu.memory = &memory;
+	cpu.memory = &bus.map;
 	cpu.registers.PC = 0x008000;
 	cpu.registers.DBR = 0x7E;
+	cpu.reset();
+
+	// Sized once so mixing a frame's audio never reallocates
+	audio.reserve(size_t(2 * (uint64_t(timing::CLOCKS_PER_FRAME) * timing::AUDIO_SAMPLE_RATE / timing::MASTER_CLOCK_HZ + 1)));
 }
 
 void System::start()
@@ -26,5 +253,312 @@ void System::start()
 
 void System::loadRom(const std::vector<uint8_t>& input)
 {
-	rom.load(input);
-}
\ No newline at end of file
+	// Interning hashes the image; every save and load compares against that key
+	bus.loadRom(RomStore::instance().intern(input, &romHash));
+	romSize = input.size();
+}
+
+bool System::loadSram(const std::string& path, uint32_t size)
+{
+	bool persistent = sram.open(path, size);
+	// The storage moved; code windows cached from the old one must be refetched
+	bus.map.invalidate();
+	if (aheadFrames)
+		aheadSram.resize(sram.size());
+
+	// LoROM cartridge RAM: the low half of banks $70-$7D, mirrored by the handler's mask
+	for (uint32_t bank = 0x70; bank <= 0x7D; ++bank)
+		bus.mapCartridge(bank << 16, (bank << 16) | 0x7FFF, &sram);
+	return persistent;
+}
+
+void System::runFrame(bool render)
+{
+	auto begin = std::chrono::steady_clock::now();
+
+	if (render && aheadFrames)
+	{
+		runFrameAhead();
+	}
+	else
+	{
+		emulateFrame(render);
+		sram.endFrame();
+
+		if (render)
+		{
+			mixAudio(frame - 1);
+			if (frameCallback)
+				frameCallback(*this);
+		}
+	}
+
+	publishMetrics(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count()));
+}
+
+void System::publishMetrics(uint64_t frameNs)
+{
+	hostNs += frameNs;
+
+	MetricsCounters counters;
+	counters.instructions = cpu.instructions;
+	counters.cycles = cpu.cycles;
+	counters.frames = frame;
+	counters.hostNs = hostNs;
+	counters.windowFetches = cpu.windowFetches;
+	counters.handlerReads = bus.map.counters.handlerReads;
+	counters.handlerWrites = bus.map.counters.handlerWrites;
+	counters.ioAccesses = bus.map.counters.ioAccesses;
+	runtimeMetrics.publish(counters, frameNs);
+}
+
+void System::emulateFrame(bool render)
+{
+	dma.startFrame();
+	ppu.startFrame();
+	for (uint32_t line = 0; line < timing::SCANLINES_PER_FRAME; ++line)
+	{
+		scheduler.run(cpu, frameStart + uint64_t(line + 1) * timing::CLOCKS_PER_SCANLINE);
+
+		if (line >= 1 && line <= PPU::HEIGHT)
+		{
+			PhaseProfiler::Scope phase(profiler, ProfilePhase::Render);
+			if (render)
+				ppu.renderScanline(line - 1);
+			else
+				ppu.evaluateSprites(line - 1);
+		}
+
+		// HDMA runs in every line's hblank up to the last visible one, rendered or not
+		if (line <= PPU::HEIGHT)
+			dma.hblank();
+	}
+	frameStart += timing::CLOCKS_PER_FRAME;
+	++frame;
+}
+
+void System::runFrameAhead()
+{
+	using clock = std::chrono::steady_clock;
+	auto begin = clock::now();
+
+	// The committed frame: audio and cartridge RAM come from the real timeline only
+	emulateFrame(false);
+	sram.endFrame();
+	mixAudio(frame - 1);
+	auto committed = clock::now();
+
+	// Speculate with the same input and show the last frame, then rewind.
+	// The arena is copied into a buffer held since setRunAhead. Cartridge RAM runs on a scratch copy,
+	// sized by setRunAhead and loadSram, so nothing here allocates and the save file is never touched.
+	snapshot(*aheadState);
+	if (aheadSram.size() != sram.size())
+		aheadSram.resize(sram.size());
+	sram.speculate(aheadSram.data());
+	auto saved = clock::now();
+	for (uint32_t i = 1; i <= aheadFrames; ++i)
+		emulateFrame(i == aheadFrames);
+	auto speculated = clock::now();
+	restore(*aheadState);
+	sram.endSpeculation();
+	auto end = clock::now();
+
+	++aheadStats.frames;
+	aheadStats.aheadFrames += aheadFrames;
+	aheadStats.frameSeconds += std::chrono::duration<double>(committed - begin).count();
+	aheadStats.aheadSeconds += std::chrono::duration<double>(speculated - saved).count();
+	aheadStats.stateSeconds += std::chrono::duration<double>((saved - committed) + (end - speculated)).count();
+
+	if (frameCallback)
+		frameCallback(*this);
+}
+
+FastForwardStats System::fastForward(uint64_t frames, uint32_t frameSkip)
+{
+	FastForwardStats stats;
+	auto begin = std::chrono::steady_clock::now();
+
+	for (uint64_t i = 0; i < frames && cpu.running; ++i)
+	{
+		bool render = (i % (uint64_t(frameSkip) + 1)) == frameSkip;
+		runFrame(render);
+
+		++stats.frames;
+		if (render)
+			++stats.renderedFrames;
+	}
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	stats.fps = stats.seconds > 0.0 ? stats.frames / stats.seconds : 0.0;
+	return stats;
+}
+
+void System::setFrameCallback(std::function<void(const System&)> callback)
+{
+	frameCallback = std::move(callback);
+}
+
+void System::setInput(size_t port, uint16_t buttons)
+{
+	if (port < Controllers::PORTS)
+		controllers.buttons[port] = buttons;
+}
+
+void System::setRunAhead(uint32_t frames)
+{
+	aheadFrames = frames;
+
+	// Acquire the snapshot buffers now so later frames reuse them
+	if (frames && !aheadState)
+		aheadState = MachineStatePool::shared().acquire();
+	if (frames)
+		aheadSram.resize(sram.size());
+}
+
+void System::attachCoverage(Coverage& coverage)
+{
+	coverage.attach(bus.map, &bus.rom, &bus.wram);
+}
+
+void System::attachProfiler(PhaseProfiler* target)
+{
+	profiler = target;
+	cpu.profiler = target;
+	bus.map.profiler = target;
+}
+
+void System::snapshot(MachineState& out) const
+{
+	std::memcpy(&out, state.get(), sizeof(MachineState));
+}
+
+void System::restore(const MachineState& in)
+{
+	std::memcpy(state.get(), &in, sizeof(MachineState));
+	scheduler.resync();
+	ppu.invalidate();
+}
+
+void System::saveState(std::vector<uint8_t>& out) const
+{
+	SaveStateWriter writer;
+
+	CpuSection cpuState{};
+	cpuState.registers = cpu.registers;
+	cpuState.cycles = cpu.cycles;
+	cpuState.pendingInterrupts = cpu.pendingInterrupts;
+	cpuState.running = cpu.running;
+	writer.add(CPU_SECTION, 1, &cpuState, sizeof(cpuState));
+
+	TimingSection timingState{};
+	timingState.frame = frame;
+	timingState.frameStart = frameStart;
+	for (size_t i = 0; i < size_t(Event::Count); ++i)
+		timingState.events[i] = scheduler.time(Event(i));
+	timingState.htime = interrupts.htime;
+	timingState.vtime = interrupts.vtime;
+	timingState.nmitimen = interrupts.nmitimen;
+	timingState.nmiFlag = interrupts.nmiFlag;
+	timingState.timeUp = interrupts.timeUp;
+	writer.add(TIMING_SECTION, 1, &timingState, sizeof(timingState));
+
+	PPU::Latches latches = ppu.latches();
+	writer.add(PPU_SECTION, PPU_VERSION, &latches, sizeof(latches));
+	writer.add(DMA_SECTION, 1, &dma.state, sizeof(DmaState));
+
+	writer.add(WRAM_SECTION, 1, bus.wram.contents(), bus.wram.size());
+	writer.add(VRAM_SECTION, 1, ppu.vram.data(), ppu.vram.size() * sizeof(uint16_t));
+	writer.add(CGRAM_SECTION, 1, ppu.cgram.data(), ppu.cgram.size() * sizeof(uint16_t));
+	writer.add(OAM_SECTION, 1, ppu.oam.data(), ppu.oam.size());
+
+	writer.add(SRAM_SECTION, 1, sram.contents(), sram.size());
+
+	RomSection identity = { romHash, romSize };
+	writer.add(ROM_SECTION, 1, &identity, sizeof(identity));
+	writer.build(out);
+}
+
+bool System::saveState(const std::string& path) const
+{
+	std::vector<uint8_t> bytes;
+	saveState(bytes);
+	return SaveStateWriter::writeFile(path, bytes);
+}
+
+std::vector<uint8_t> System::saveState() const
+{
+	std::vector<uint8_t> bytes;
+	saveState(bytes);
+	return bytes;
+}
+
+bool System::loadState(const std::string& path)
+{
+	SaveStateView view;
+	return view.open(path) && loadState(view);
+}
+
+bool System::loadState(const SaveStateView& state)
+{
+	size_t wramSize = bus.wram.size();
+
+	// Resolve every section before touching the machine, so a bad file changes nothing
+	auto cpuState = state.find<CpuSection>(CPU_SECTION, 1);
+	auto timingState = state.find<TimingSection>(TIMING_SECTION, 1);
+	PPU::Latches latches;
+	bool ppuFound = readPpuLatches(state, latches);
+	auto channels = state.find<DmaState>(DMA_SECTION, 1);
+	auto identity = state.find<RomSection>(ROM_SECTION, 1);
+	auto wram = static_cast<const uint8_t*>(state.find(WRAM_SECTION, 1, wramSize));
+	auto vram = static_cast<const uint16_t*>(state.find(VRAM_SECTION, 1, ppu.vram.size() * sizeof(uint16_t)));
+	auto cgram = static_cast<const uint16_t*>(state.find(CGRAM_SECTION, 1, ppu.cgram.size() * sizeof(uint16_t)));
+	auto oam = static_cast<const uint8_t*>(state.find(OAM_SECTION, 1, ppu.oam.size()));
+	auto save = static_cast<const uint8_t*>(state.find(SRAM_SECTION, 1, sram.size()));
+	if (!cpuState || !timingState || !ppuFound || !identity || !vram || !cgram || !oam || (wramSize && !wram) || (sram.size() && !save))
+		return false;
+
+	if (identity->hash != romHash || identity->size != romSize)
+		return false;
+
+	cpu.registers = cpuState->registers;
+	cpu.cycles = cpuState->cycles;
+	cpu.pendingInterrupts = cpuState->pendingInterrupts;
+	cpu.running = cpuState->running != 0;
+
+	frame = timingState->frame;
+	frameStart = timingState->frameStart;
+	interrupts.htime = timingState->htime;
+	interrupts.vtime = timingState->vtime;
+	interrupts.nmitimen = timingState->nmitimen;
+	interrupts.nmiFlag = timingState->nmiFlag != 0;
+	interrupts.timeUp = timingState->timeUp != 0;
+	for (size_t i = 0; i < size_t(Event::Count); ++i)
+		scheduler.schedule(Event(i), timingState->events[i]);
+
+	// States from before DMA was emulated have no channels in flight
+	ppu.restore(latches);
+	dma.state = channels ? *channels : DmaState();
+	if (wram)
+		bus.wram.assign(wram, wramSize);
+	std::copy(vram, vram + ppu.vram.size(), ppu.vram.begin());
+	std::copy(cgram, cgram + ppu.cgram.size(), ppu.cgram.begin());
+	std::copy(oam, oam + ppu.oam.size(), ppu.oam.begin());
+	if (save)
+		sram.assign(save, sram.size());
+	return true;
+}
+
+void System::mixAudio(uint64_t index)
+{
+	PhaseProfiler::Scope phase(profiler, ProfilePhase::Audio);
+
+	// Sample count is derived from the frame number so skipped frames keep the stream aligned
+	auto samplesAt = [](uint64_t f)
+	{
+		return f * timing::CLOCKS_PER_FRAME * timing::AUDIO_SAMPLE_RATE / timing::MASTER_CLOCK_HZ;
+	};
+	size_t count = size_t(samplesAt(index + 1) - samplesAt(index));
+
+	// No S-DSP yet, the frame's stereo sample slots are emitted as silence
+	audio.assign(count * 2, 0);
+}
@@ -1,5 +1,39 @@
 #pragma once
 #include "cpu.h"
+#include "ppu.h"
+#include "scheduler.h"
+#include "interrupts.h"
+#include "dma.h"
+#include "sram.h"
+#include "controller.h"
+#include "metrics.h"
+#include "savestate.h"
+#include "bus.h"
+#include <functional>
+
+class Coverage;
+
+struct FastForwardStats
+{
+	uint64_t frames = 0;
+	uint64_t renderedFrames = 0;
+	double seconds = 0.0;
+	double fps = 0.0;
+};
+
+// Cost of run-ahead: time spent on the committed frames against the extra
+// snapshot, speculative emulation and restore work done for each of them
+struct RunAheadStats
+{
+	uint64_t frames = 0;
+	uint64_t aheadFrames = 0;
+	double frameSeconds = 0.0;
+	double aheadSeconds = 0.0;
+	double stateSeconds = 0.0;
+
+	// Extra CPU time per committed frame, as a fraction of the frame's own cost
+	double overhead() const { return frameSeconds > 0.0 ? (aheadSeconds + stateSeconds) / frameSeconds : 0.0; }
+};
 
 class System
 {
@@ -8,9 +42,72 @@ public:
 	void init();
 	void start();
 	void loadRom(const std::vector<uint8_t>& input);
+	bool loadSram(const std::string& path, uint32_t size);
+	void runFrame(bool render = true);
+	FastForwardStats fastForward(uint64_t frames, uint32_t frameSkip);
+	void setFrameCallback(std::function<void(const System&)> callback);
+	void setInput(size_t port, uint16_t buttons);
+
+	// Rendered frames are shown this many frames early; 0 disables run-ahead
+	void setRunAhead(uint32_t frames);
+	uint32_t runAhead() const { return aheadFrames; }
+	const RunAheadStats& runAheadStats() const { return aheadStats; }
+
+	// Safe to snapshot from any thread while frames run
+	const Metrics& metrics() const { return runtimeMetrics; }
+	void resetRunAheadStats() { aheadStats = {}; }
+	void attachCoverage(Coverage& coverage);
+	void attachProfiler(PhaseProfiler* profiler);	// Null detaches
+
+	// Raw copy of the machine arena, for snapshots that never leave this process.
+	// Only valid between systems running the same cartridge with the same mappings.
+	void snapshot(MachineState& out) const;
+	void restore(const MachineState& in);
+
+	bool saveState(const std::string& path) const;
+	std::vector<uint8_t> saveState() const;
+	void saveState(std::vector<uint8_t>& out) const;
+	bool loadState(const std::string& path);
+	bool loadState(const SaveStateView& state);
+
+	const std::vector<uint16_t>& framebuffer() const { return ppu.framebuffer; }
+	const std::vector<int16_t>& audioSamples() const { return audio; }
+	uint64_t frameCount() const { return frame; }
+	bool running() const { return cpu.running; }
+	const Registers& registers() const { return cpu.registers; }
+	uint64_t cycles() const { return cpu.cycles; }
+	uint8_t peek(uint32_t address) const { return bus.peek(address); }
 private:
-	CPU cpu = {};
-	MemoryMap memory = {};
-	RAM ram = {};
-	ROM rom = {};
-};
\ No newline at end of file
+	void emulateFrame(bool render);
+	void runFrameAhead();
+	void mixAudio(uint64_t index);
+	void publishMetrics(uint64_t frameNs);
+
+	// Declared first: every component below binds to it
+	MachineStatePool::Handle state;
+
+	CPU cpu;
+	PPU ppu;
+	Scheduler scheduler;
+	InterruptController interrupts;
+	DmaController dma;
+	Bus bus;
+	SRAM sram;
+	Controllers controllers;
+
+	uint64_t& frame;
+	uint64_t& frameStart;
+	std::vector<int16_t> audio = {};
+	std::function<void(const System&)> frameCallback = {};
+	uint64_t romHash = 0;
+	uint64_t romSize = 0;
+
+	uint32_t aheadFrames = 0;
+	MachineStatePool::Handle aheadState;
+	std::vector<uint8_t> aheadSram = {};
+	RunAheadStats aheadStats = {};
+
+	Metrics runtimeMetrics;
+	PhaseProfiler* profiler = nullptr;
+	uint64_t hostNs = 0;
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+
+// Unterminated formatting into a caller's buffer, for hot paths that cannot afford snprintf.
+// Each returns the position after what it wrote.
+namespace text
+{
+	inline char* appendText(char* p, const char* text)
+	{
+		while (*text)
+			*p++ = *text++;
+		return p;
+	}
+
+	inline char* appendHex(char* p, uint32_t value, int digits)
+	{
+		static const char hexDigits[] = "0123456789ABCDEF";
+		for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4)
+			*p++ = hexDigits[(value >> shift) & 0x0F];
+		return p;
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+namespace timing
+{
+	constexpr uint32_t MASTER_CLOCK_HZ		= 21477272;	// NTSC master clock
+	constexpr uint32_t CLOCKS_PER_CYCLE		= 8;		// Master clocks per CPU cycle (SlowROM/WRAM speed)
+	constexpr uint32_t CLOCKS_PER_SCANLINE	= 1364;
+	constexpr uint32_t SCANLINES_PER_FRAME	= 262;
+	constexpr uint32_t CLOCKS_PER_FRAME		= CLOCKS_PER_SCANLINE * SCANLINES_PER_FRAME;
+	constexpr uint32_t CLOCKS_PER_FRAME_PAIR	= 2 * CLOCKS_PER_FRAME - 4;	// Every other non-interlaced frame has one 1360-clock line
+	constexpr uint32_t AUDIO_SAMPLE_RATE	= 32040;	// S-DSP output rate
+}
@@ -0,0 +1,153 @@
+#include "trace.h"
+#include "disassembler.h"
+#include "text_utils.h"
+#include <chrono>
+#include <cstring>
+
+TraceLogger::TraceLogger(std::ostream& output, size_t capacity) : out(output)
+{
+	size_t size = 1;
+	while (size < capacity)
+		size <<= 1;
+	ring.resize(size);
+	mask = size - 1;
+
+	worker = std::thread(&TraceLogger::drain, this);
+}
+
+TraceLogger::~TraceLogger()
+{
+	stopping.store(true, std::memory_order_release);
+	worker.join();
+}
+
+void TraceLogger::record(const CPU& cpu, uint32_t pc)
+{
+	size_t h = head.load(std::memory_order_relaxed);
+	while (h - tail.load(std::memory_order_acquire) >= ring.size())
+		std::this_thread::yield();
+
+	TraceRecord& entry = ring[h & mask];
+	entry.cycle = cpu.cycles;
+	entry.registers = cpu.registers;
+	entry.pc = pc;
+	entry.bytes[0] = cpu.memory->peek(pc);
+	uint8_t length = instructionLength(entry.bytes[0], cpu.registers.P, cpu.registers.E);
+	for (uint8_t i = 1; i < length; ++i)
+		entry.bytes[i] = cpu.memory->peek((pc & 0xFF0000) | uint16_t(pc + i));
+
+	head.store(h + 1, std::memory_order_release);
+}
+
+void TraceLogger::flush()
+{
+	while (tail.load(std::memory_order_acquire) != head.load(std::memory_order_relaxed))
+		std::this_thread::yield();
+	out.flush();
+}
+
+namespace
+{
+	using text::appendHex;
+	using text::appendText;
+
+	char* appendField(char* p, const char* label, uint32_t value, int digits)
+	{
+		return appendHex(appendText(p, label), value, digits);
+	}
+
+	char* appendDecimal(char* p, uint64_t value)
+	{
+		char digits[20];
+		int n = 0;
+		do
+		{
+			digits[n++] = char('0' + value % 10);
+			value /= 10;
+		} while (value);
+		while (n)
+			*p++ = digits[--n];
+		return p;
+	}
+
+	char* pad(char* p, char* start, size_t width)
+	{
+		while (size_t(p - start) < width)
+			*p++ = ' ';
+		return p;
+	}
+}
+
+size_t TraceLogger::format(const TraceRecord& record, char* out, size_t size)
+{
+	// Formatted by hand: this runs once per traced instruction
+	const Registers& r = record.registers;
+	char line[160];
+	char* p = appendHex(line, record.pc, 6);
+	*p++ = ' ';
+	*p++ = ' ';
+
+	char* column = p;
+	uint8_t length = instructionLength(record.bytes[0], r.P, r.E);
+	for (uint8_t i = 0; i < length; ++i)
+	{
+		if (i)
+			*p++ = ' ';
+		p = appendHex(p, record.bytes[i], 2);
+	}
+	p = pad(p, column, 13);
+
+	column = p;
+	p += disassemble(record.bytes, record.pc, r.P, r.E, p, 24);
+	p = pad(p, column, 17);
+
+	p = appendField(p, "A:", r.A, 4);
+	p = appendField(p, " X:", r.X, 4);
+	p = appendField(p, " Y:", r.Y, 4);
+	p = appendField(p, " S:", r.S, 4);
+	p = appendField(p, " D:", r.D, 4);
+	p = appendField(p, " DB:", r.DBR, 2);
+	p = appendField(p, " P:", r.P, 2);
+	p = appendField(p, " E:", r.E ? 1 : 0, 1);
+	p = appendDecimal(appendText(p, " CYC:"), record.cycle);
+	*p++ = '\n';
+
+	size_t n = size_t(p - line);
+	if (n > size)
+		n = size;
+	std::memcpy(out, line, n);
+	return n;
+}
+
+void TraceLogger::drain()
+{
+	std::vector<char> buffer(1 << 16);
+	const size_t lineMax = 160;
+
+	for (;;)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t h = head.load(std::memory_order_acquire);
+		if (t == h)
+		{
+			if (stopping.load(std::memory_order_acquire) && head.load(std::memory_order_acquire) == t)
+				break;
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			continue;
+		}
+
+		size_t used = 0;
+		for (; t != h; ++t)
+		{
+			if (buffer.size() - used < lineMax)
+			{
+				out.write(buffer.data(), used);
+				used = 0;
+			}
+			used += format(ring[t & mask], &buffer[used], buffer.size() - used);
+		}
+		out.write(buffer.data(), used);
+		tail.store(t, std::memory_order_release);
+	}
+	out.flush();
+}
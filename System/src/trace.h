@@ -0,0 +1,37 @@
+#pragma once
+#include "cpu.h"
+#include <atomic>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+struct TraceRecord
+{
+	uint64_t cycle;
+	Registers registers;
+	uint32_t pc;
+	uint8_t bytes[4];
+};
+
+// Instruction trace. The CPU appends binary records to a single-producer ring
+// and a background thread disassembles and writes them out.
+class TraceLogger
+{
+public:
+	explicit TraceLogger(std::ostream& out, size_t capacity = 1 << 16);
+	~TraceLogger();
+	void record(const CPU& cpu, uint32_t pc);
+	void flush();
+
+	static size_t format(const TraceRecord& record, char* out, size_t size);
+private:
+	void drain();
+
+	std::ostream& out;
+	std::vector<TraceRecord> ring;
+	size_t mask = 0;
+	alignas(64) std::atomic<size_t> head{ 0 };
+	alignas(64) std::atomic<size_t> tail{ 0 };
+	std::atomic<bool> stopping{ false };
+	std::thread worker;
+};
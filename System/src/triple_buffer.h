@@ -0,0 +1,42 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of whole frames from one writer to one reader. The writer
+// fills back() and publishes it; the reader picks up the newest published slot.
+// Neither side waits for the other, stale frames are simply overwritten.
+template <class T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() {}
+	explicit TripleBuffer(const T& initial) { slots.fill(initial); }
+
+	// Writer side
+	T& back() { return slots[backSlot]; }
+	void publish()
+	{
+		uint8_t previous = middle.exchange(uint8_t(backSlot | FRESH), std::memory_order_acq_rel);
+		backSlot = previous & SLOT_MASK;
+	}
+
+	// Reader side: true if a newer frame was published since the last poll
+	bool poll()
+	{
+		if (!(middle.load(std::memory_order_relaxed) & FRESH))
+			return false;
+		uint8_t previous = middle.exchange(frontSlot, std::memory_order_acq_rel);
+		frontSlot = previous & SLOT_MASK;
+		return true;
+	}
+	const T& front() const { return slots[frontSlot]; }
+private:
+	static constexpr uint8_t SLOT_MASK = 0x03;
+	static constexpr uint8_t FRESH = 0x04;
+
+	std::array<T, 3> slots = {};
+	uint8_t backSlot = 0;
+	uint8_t frontSlot = 1;
+	std::atomic<uint8_t> middle{ 2 };
+};
@@ -0,0 +1,275 @@
+// libFuzzer / AFL entry point for the CPU core.
+//
+//   clang++ -g -O1 -fsanitize=fuzzer,address -I System Tests/fuzz/CpuFuzzer.cpp System/src/*.cpp
+//   afl-clang-fast++ -DCPU_FUZZER_STANDALONE -I System Tests/fuzz/CpuFuzzer.cpp System/src/*.cpp
+//
+// Input layout: PC(2) S(2) A(2) X(2) Y(2) D(2) P DBR PBR flags steps, then the
+// ROM image. flags bit 0 selects emulation mode. Invariant failures abort().
+#include "src/cpu.h"
+#include "src/memory.h"
+#include "src/opcode_info.h"
+#include "src/disassembler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace
+{
+	const size_t HEADER_SIZE = 17;
+	const size_t MAX_ROM_SIZE = 0x40000;
+	const size_t MAX_ACCESSES = 32;
+
+	struct Access
+	{
+		uint32_t address;
+		uint8_t value;
+		bool write;
+	};
+
+	// LoROM-style cartridge bus: WRAM at 7E-7F and mirrored low, ROM at 8000-FFFF.
+	// Mapped over the whole 24-bit space so every access the core makes is recorded.
+	class FuzzBus : public MemoryHandler
+	{
+	public:
+		uint8_t read(uint32_t address) override
+		{
+			uint8_t value = openBus;
+			if (RAM* ram = wramAt(address))
+				value = ram->read(wramOffset(address));
+			else if ((address & 0x8000) && bankOf(address) < 0x7E)
+				value = rom.read(romOffset(address));
+			openBus = value;
+			record(address, value, false);
+			return value;
+		}
+
+		void write(uint32_t address, uint8_t value) override
+		{
+			if (RAM* ram = wramAt(address))
+				ram->write(wramOffset(address), value);
+			record(address, value, true);
+		}
+
+		void reset()
+		{
+			count = 0;
+			openBus = 0;
+		}
+
+		RAM wram = RAM(0x20000);
+		ROM rom;
+		Access accesses[MAX_ACCESSES] = {};
+		size_t count = 0;
+	private:
+		static uint8_t bankOf(uint32_t address) { return uint8_t(address >> 16); }
+
+		RAM* wramAt(uint32_t address)
+		{
+			uint8_t bank = bankOf(address);
+			if (bank == 0x7E || bank == 0x7F)
+				return &wram;
+			if ((bank & 0x7F) < 0x40 && (address & 0xFFFF) < 0x2000)
+				return &wram;
+			return nullptr;
+		}
+
+		static uint32_t wramOffset(uint32_t address)
+		{
+			uint8_t bank = bankOf(address);
+			if (bank == 0x7E || bank == 0x7F)
+				return address - 0x7E0000;
+			return address & 0x1FFF;
+		}
+
+		static uint32_t romOffset(uint32_t address)
+		{
+			return (uint32_t(bankOf(address) & 0x7F) << 15) | (address & 0x7FFF);
+		}
+
+		void record(uint32_t address, uint8_t value, bool write)
+		{
+			if (address > 0xFFFFFF)
+				fail("bus address outside 24 bits", address);
+			if (count < MAX_ACCESSES)
+				accesses[count] = { address, value, write };
+			++count;
+		}
+
+		[[noreturn]] static void fail(const char* what, uint32_t value)
+		{
+			std::fprintf(stderr, "invariant failed: %s ($%06X)\n", what, value);
+			std::abort();
+		}
+
+		uint8_t openBus = 0;
+	};
+
+	// Built once per process: constructing a CPU registers every opcode
+	struct Machine
+	{
+		Machine()
+		{
+			map.map(0x000000, 0xFFFFFF, &bus);
+			cpu.memory = &map;
+		}
+
+		CPU cpu;
+		MemoryMap map;
+		FuzzBus bus;
+		std::shared_ptr<std::vector<uint8_t>> image = std::make_shared<std::vector<uint8_t>>();
+	};
+
+	[[noreturn]] void fail(const char* what, uint8_t opcode)
+	{
+		std::fprintf(stderr, "invariant failed: %s (opcode $%02X %s)\n", what, opcode, opcodeInfo[opcode].mnemonic);
+		std::abort();
+	}
+
+	bool directPageMode(AddrMode mode)
+	{
+		switch (mode)
+		{
+		case AddrMode::DirectPage:
+		case AddrMode::DirectPageX:
+		case AddrMode::DirectPageY:
+		case AddrMode::DpIndirect:
+		case AddrMode::DpIndirectX:
+		case AddrMode::DpIndirectY:
+		case AddrMode::DpIndirectLong:
+		case AddrMode::DpIndirectLongY:
+		case AddrMode::StackRelative:
+		case AddrMode::StackRelativeIndirectY:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool dataBankMode(AddrMode mode)
+	{
+		return mode == AddrMode::Absolute || mode == AddrMode::AbsoluteX || mode == AddrMode::AbsoluteY;
+	}
+
+	// Wrapping rules from AddressingModes.h, checked on the first access after the operand
+	void checkAddressing(const FuzzBus& bus, uint8_t opcode, uint8_t p, bool e, uint8_t dbr)
+	{
+		size_t length = instructionLength(opcode, p, e);
+		if (bus.count <= length || length >= MAX_ACCESSES)
+			return;
+
+		const OpcodeInfo& info = opcodeInfo[opcode];
+		uint32_t address = bus.accesses[length].address;
+		if (directPageMode(info.mode) && (address >> 16) != 0)
+			fail("direct page or stack access left bank 0", opcode);
+
+		// JMP/JSR absolute have no data operand
+		if (dataBankMode(info.mode) && opcode != 0x4C && opcode != 0x20)
+		{
+			uint8_t bank = uint8_t(address >> 16);
+			if (bank != dbr && bank != uint8_t(dbr + 1))
+				fail("absolute access outside the data bank", opcode);
+		}
+	}
+
+	void checkRegisters(CPU& cpu, uint8_t opcode)
+	{
+		const Registers& r = cpu.registers;
+		if (cpu.isAccumulator8Bit() && (r.A & 0xFF00))
+			fail("8-bit accumulator not masked", opcode);
+		if (cpu.isIndex8Bit() && ((r.X | r.Y) & 0xFF00))
+			fail("8-bit index register not masked", opcode);
+		if (r.E && (r.P & (M | X)) != (M | X))
+			fail("emulation mode without 8-bit registers", opcode);
+	}
+
+	uint16_t read16(const uint8_t* data)
+	{
+		return uint16_t(data[0] | (data[1] << 8));
+	}
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	static Machine machine;
+	if (size < HEADER_SIZE)
+		return 0;
+
+	CPU& cpu = machine.cpu;
+	FuzzBus& bus = machine.bus;
+
+	// Loaded in place rather than through RomStore, which would keep a copy of every input alive
+	machine.image->assign(data + HEADER_SIZE, data + std::min(size, HEADER_SIZE + MAX_ROM_SIZE));
+	bus.rom.load(RomImage(machine.image));
+	bus.wram.fill(0x00);
+	bus.reset();
+
+	Registers& r = cpu.registers;
+	r.PC = read16(data);
+	r.S = read16(data + 2);
+	r.A = read16(data + 4);
+	r.X = read16(data + 6);
+	r.Y = read16(data + 8);
+	r.D = read16(data + 10);
+	r.P = data[12];
+	r.DBR = data[13];
+	r.PBR = data[14];
+	r.E = data[15] & 1;
+	if (r.E)
+		r.S = uint16_t(0x0100 | (r.S & 0xFF));
+	cpu.updateRegisterSizes();
+	cpu.running = true;
+	cpu.cycles = 0;
+
+	unsigned steps = 1 + (data[16] & 0x3F);
+	for (unsigned i = 0; i < steps && cpu.running; ++i)
+	{
+		uint8_t p = r.P;
+		bool e = r.E;
+		uint8_t dbr = r.DBR;
+
+		bus.reset();
+		cpu.step();
+		if (bus.count == 0)
+			break;
+
+		uint8_t opcode = bus.accesses[0].value;
+		if (!cpu.hasHandler(opcode))
+			continue;
+
+		checkRegisters(cpu, opcode);
+		checkAddressing(bus, opcode, p, e, dbr);
+	}
+	return 0;
+}
+
+#ifdef CPU_FUZZER_STANDALONE
+#ifndef __AFL_LOOP
+#define __AFL_LOOP(n) (false)
+#endif
+
+// AFL persistent mode when built with afl-clang-fast, otherwise replays each file argument
+int main(int argc, char** argv)
+{
+	std::vector<uint8_t> input;
+	while (__AFL_LOOP(10000))
+	{
+		input.resize(1 << 20);
+		input.resize(std::fread(input.data(), 1, input.size(), stdin));
+		LLVMFuzzerTestOneInput(input.data(), input.size());
+	}
+
+	for (int i = 1; i < argc; ++i)
+	{
+		FILE* file = std::fopen(argv[i], "rb");
+		if (!file)
+			continue;
+		input.resize(1 << 20);
+		input.resize(std::fread(input.data(), 1, input.size(), file));
+		std::fclose(file);
+		LLVMFuzzerTestOneInput(input.data(), input.size());
+	}
+	return 0;
+}
+#endif
@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "src/system.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// This binary replaces the global allocator to count heap allocations, so it
+// is kept apart from SystemTests and every other suite runs on the real one
+static std::atomic<size_t> heapAllocations(0);
+
+void* operator new(size_t size)
+{
+    ++heapAllocations;
+    if (void* block = std::malloc(size ? size : 1))
+        return block;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* block) noexcept { std::free(block); }
+void operator delete[](void* block) noexcept { std::free(block); }
+
+
+class AllocationTest : public ::testing::Test
+{
+protected:
+    std::vector<uint8_t> rom;
+
+    // Polls the pad in the NMI handler and shows it as the backdrop colour
+    void SetUp() override
+    {
+        rom.assign(0x8000, 0xEA);
+        const std::vector<uint8_t> program = {
+            0xA9, 0x0F, 0x8F, 0x00, 0x21, 0x00,   // INIDISP: full brightness
+            0xA9, 0x80, 0x8F, 0x00, 0x42, 0x00,   // NMITIMEN: enable NMI
+            0xA9, 0x00, 0x8F, 0x21, 0x21, 0x00,   // loop: CGADD 0
+            0xAF, 0x10, 0x00, 0x7E,               // LDA $7E0010
+            0x8F, 0x22, 0x21, 0x00,               // CGDATA low
+            0xA9, 0x00, 0x8F, 0x22, 0x21, 0x00,   // CGDATA high
+            0x80, 0xEA                            // BRA loop
+        };
+        const std::vector<uint8_t> nmi = {
+            0xAF, 0x18, 0x42, 0x00,               // LDA JOY1L
+            0x8F, 0x10, 0x00, 0x7E,               // STA $7E0010
+            0x5C, 0x0C, 0x80, 0x00                // JML loop
+        };
+        std::copy(program.begin(), program.end(), rom.begin());
+        std::copy(nmi.begin(), nmi.end(), rom.begin() + 0x1000);
+        rom[0x7FEA] = 0x00;
+        rom[0x7FEB] = 0x90;
+    }
+
+    void Boot(System& system)
+    {
+        system.loadRom(rom);
+        system.init();
+    }
+};
+
+namespace Allocation_Tests
+{
+    TEST_F(AllocationTest, FramesDoNotAllocate)
+    {
+        System system;
+        Boot(system);
+        system.runFrame();
+
+        size_t before = heapAllocations;
+        for (int i = 0; i < 10; ++i)
+        {
+            system.setInput(0, (i & 1) ? ButtonA : 0);
+            system.runFrame();
+        }
+
+        EXPECT_EQ(heapAllocations - before, 0u);
+    }
+
+    TEST_F(AllocationTest, RunAheadFramesDoNotAllocate)
+    {
+        System system;
+        Boot(system);
+        system.setRunAhead(2);
+        system.runFrame();
+
+        size_t before = heapAllocations;
+        for (int i = 0; i < 10; ++i)
+        {
+            system.setInput(0, (i & 1) ? ButtonA : 0);
+            system.runFrame();
+        }
+
+        EXPECT_EQ(heapAllocations - before, 0u);
+    }
+
+    TEST_F(AllocationTest, RunAheadAfterLoadingSramDoesNotAllocate)
+    {
+        System system;
+        Boot(system);
+        system.setRunAhead(2);
+        system.runFrame();
+        system.loadSram("missing_directory/save.srm", 0x2000);
+
+        // The first frame on the new cartridge RAM included
+        size_t before = heapAllocations;
+        for (int i = 0; i < 10; ++i)
+        {
+            system.setInput(0, (i & 1) ? ButtonA : 0);
+            system.runFrame();
+        }
+
+        EXPECT_EQ(heapAllocations - before, 0u);
+    }
+}
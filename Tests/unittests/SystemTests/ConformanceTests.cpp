@@ -0,0 +1,130 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "SingleStepHarness.h"
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+namespace Conformance_Tests
+{
+    // Hand-written vectors in the corpus layout; cycles list only the valid accesses
+    const char* vectors = R"([
+        {
+            "name": "a9 8-bit immediate",
+            "initial": { "pc": 32768, "s": 511, "p": 48, "a": 0, "x": 0, "y": 0, "dbr": 0, "d": 0, "pbr": 0, "e": 0,
+                         "ram": [[32768, 169], [32769, 66]] },
+            "final":   { "pc": 32770, "s": 511, "p": 48, "a": 66, "x": 0, "y": 0, "dbr": 0, "d": 0, "pbr": 0, "e": 0,
+                         "ram": [[32768, 169], [32769, 66]] },
+            "cycles": [[32768, 169, "dp-rx-"], [32769, 66, "-p-rx-"]]
+        },
+        {
+            "name": "85 8-bit direct page store",
+            "initial": { "pc": 32768, "s": 511, "p": 48, "a": 90, "x": 0, "y": 0, "dbr": 0, "d": 0, "pbr": 0, "e": 0,
+                         "ram": [[32768, 133], [32769, 16], [16, 0]] },
+            "final":   { "pc": 32770, "s": 511, "p": 48, "a": 90, "x": 0, "y": 0, "dbr": 0, "d": 0, "pbr": 0, "e": 0,
+                         "ram": [[32768, 133], [32769, 16], [16, 90]] },
+            "cycles": [[32768, 133, "dp-rx-"], [32769, 16, "-p-rx-"], [16, 90, "d--wx-"]]
+        }
+    ])";
+
+    TEST(ConformanceTest, ParsesVectors)
+    {
+        std::vector<SingleStep::Vector> parsed;
+        std::string error;
+        ASSERT_TRUE(SingleStep::parseVectors(vectors, parsed, error)) << error;
+        ASSERT_EQ(parsed.size(), 2u);
+        EXPECT_EQ(parsed[0].name, "a9 8-bit immediate");
+        EXPECT_EQ(parsed[0].final.a, 0x42);
+        EXPECT_EQ(parsed[1].final.ram[2].second, 90);
+        ASSERT_EQ(parsed[1].cycles.size(), 3u);
+        EXPECT_TRUE(parsed[1].cycles[2].write);
+    }
+
+    TEST(ConformanceTest, RejectsMalformedJson)
+    {
+        std::vector<SingleStep::Vector> parsed;
+        std::string error;
+        EXPECT_FALSE(SingleStep::parseVectors("[{\"name\": \"x\", ", parsed, error));
+        EXPECT_FALSE(error.empty());
+    }
+
+    TEST(ConformanceTest, RunsEmbeddedVectors)
+    {
+        std::vector<SingleStep::Vector> parsed;
+        std::string error;
+        ASSERT_TRUE(SingleStep::parseVectors(vectors, parsed, error)) << error;
+
+        SingleStep::Runner runner;
+        for (const auto& vector : parsed)
+        {
+            std::string mismatch;
+            EXPECT_EQ(runner.run(vector, false, &mismatch), SingleStep::Outcome::Passed) << mismatch;
+        }
+    }
+
+    TEST(ConformanceTest, ReportsMismatches)
+    {
+        std::vector<SingleStep::Vector> parsed;
+        std::string error;
+        ASSERT_TRUE(SingleStep::parseVectors(vectors, parsed, error)) << error;
+
+        parsed[0].final.a = 0x43;
+        SingleStep::Runner runner;
+        std::string mismatch;
+        EXPECT_EQ(runner.run(parsed[0], false, &mismatch), SingleStep::Outcome::Failed);
+        EXPECT_NE(mismatch.find("a: expected $43 got $42"), std::string::npos) << mismatch;
+    }
+
+    TEST(ConformanceTest, ReportsWhichBusFieldDiffers)
+    {
+        std::vector<SingleStep::Vector> parsed;
+        std::string error;
+        ASSERT_TRUE(SingleStep::parseVectors(vectors, parsed, error)) << error;
+        SingleStep::Runner runner;
+        std::string mismatch;
+        ASSERT_EQ(runner.run(parsed[1], true, &mismatch), SingleStep::Outcome::Passed) << mismatch;
+
+        SingleStep::Vector value = parsed[1];
+        value.cycles[2].value = 91;
+        EXPECT_EQ(runner.run(value, true, &mismatch), SingleStep::Outcome::Failed);
+        EXPECT_NE(mismatch.find("bus cycle 2 value: expected $5b got $5a"), std::string::npos) << mismatch;
+
+        SingleStep::Vector direction = parsed[1];
+        direction.cycles[1].write = true;
+        EXPECT_EQ(runner.run(direction, true, &mismatch), SingleStep::Outcome::Failed);
+        EXPECT_NE(mismatch.find("bus cycle 1 direction: expected write got read"), std::string::npos) << mismatch;
+
+        SingleStep::Vector address = parsed[1];
+        address.cycles[2].address = 17;
+        EXPECT_EQ(runner.run(address, true, &mismatch), SingleStep::Outcome::Failed);
+        EXPECT_NE(mismatch.find("bus cycle 2 address: expected $11 got $10"), std::string::npos) << mismatch;
+    }
+
+    // Point SNES_SINGLESTEP_DIR at a checkout of the per-opcode JSON corpus to run it
+    TEST(ConformanceTest, Corpus)
+    {
+        const char* directory = std::getenv("SNES_SINGLESTEP_DIR");
+        if (!directory)
+            GTEST_SKIP() << "SNES_SINGLESTEP_DIR is not set";
+
+        auto files = SingleStep::corpusFiles(directory);
+        ASSERT_FALSE(files.empty()) << "no vectors found in " << directory;
+
+        bool checkBus = std::getenv("SNES_SINGLESTEP_BUS") != nullptr;
+        auto report = SingleStep::runCorpus(files, std::max(1u, std::thread::hardware_concurrency()), checkBus);
+
+        std::cout << "[ corpus   ] " << report.files << " files, " << report.passed << " passed, "
+                  << report.failed << " failed, " << report.skipped << " skipped" << std::endl;
+        for (size_t op = 0; op < report.opcodes.size(); ++op)
+        {
+            const auto& stats = report.opcodes[op];
+            if (stats.failed)
+                std::cout << "[ corpus   ] $" << std::hex << op << std::dec << ": " << stats.failed << " failed, " << stats.passed << " passed" << std::endl;
+        }
+        for (const auto& failure : report.failures)
+            std::cout << "[ mismatch ] " << failure << std::endl;
+
+        EXPECT_TRUE(report.errors.empty()) << report.errors.front();
+        EXPECT_EQ(report.failed, 0u);
+    }
+}
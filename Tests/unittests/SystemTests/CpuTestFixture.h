@@ -0,0 +1,28 @@
+#pragma once
+#include "gtest/gtest.h"
+#include "src/cpu.h"
+#include "src/bus.h"
+#include <memory>
+#include <vector>
+
+// A CPU on a bare bus, about to run a program loaded at $00:8000
+class CpuTest : public ::testing::Test
+{
+protected:
+    std::unique_ptr<Bus> memory;
+    CPU cpu;
+
+    void LoadProgram(const std::vector<uint8_t>& program)
+    {
+        memory->loadRom(program);
+    }
+
+    void SetUp() override
+    {
+        memory = std::make_unique<Bus>();
+        cpu.memory = &memory.get()->map;
+        cpu.registers.PC = 0x008000;
+        cpu.registers.DBR = 0x7E;
+        cpu.running = true;
+    }
+};
@@ -0,0 +1,122 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "CpuTestFixture.h"
+#include "src/debugger.h"
+
+
+class DebuggerTest : public CpuTest
+{
+protected:
+    Debugger debugger;
+
+    void SetUp() override
+    {
+        CpuTest::SetUp();
+        debugger.attach(cpu);
+    }
+};
+namespace Debugger_Tests
+{
+    TEST_F(DebuggerTest, Breakpoint_StopsBeforeInstruction)
+    {
+        LoadProgram({
+            0xA9, 0x11,
+            0xA9, 0x22,
+            0x00
+            });
+        debugger.addBreakpoint(0x008002);
+
+        cpu.run();
+
+        EXPECT_EQ(cpu.registers.PC, 0x8002);
+        EXPECT_EQ(cpu.registers.A, 0x11);
+        ASSERT_EQ(debugger.hits.size(), 1u);
+        EXPECT_EQ(debugger.hits[0].kind, WatchExec);
+    }
+    TEST_F(DebuggerTest, Breakpoint_ResumeExecutesStoppedInstruction)
+    {
+        LoadProgram({
+            0xA9, 0x11,
+            0xA9, 0x22,
+            0x00
+            });
+        debugger.addBreakpoint(0x008002);
+
+        cpu.run();
+        cpu.running = true;
+        cpu.run();
+
+        EXPECT_EQ(cpu.registers.A, 0x22);
+        EXPECT_EQ(debugger.hits.size(), 1u);
+    }
+    TEST_F(DebuggerTest, WriteWatch_StopsAfterStore)
+    {
+        LoadProgram({
+            0xA9, 0x33,
+            0x8D, 0x34, 0x12,
+            0xA9, 0x44,
+            0x00
+            });
+        debugger.addWatchpoint(0x7E1234, 0x7E1234, WatchWrite);
+
+        cpu.run();
+
+        EXPECT_EQ(memory->wram.read(0x1234), 0x33);
+        EXPECT_EQ(cpu.registers.A, 0x33);
+        ASSERT_EQ(debugger.hits.size(), 1u);
+        EXPECT_EQ(debugger.hits[0].address, 0x7E1234u);
+        EXPECT_EQ(debugger.hits[0].value, 0x33);
+    }
+    TEST_F(DebuggerTest, ReadWatch_ValueFilterSkipsOtherValues)
+    {
+        memory->wram.write(0x0010, 0x01);
+        memory->wram.write(0x0011, 0x80);
+        LoadProgram({
+            0xA5, 0x10,
+            0xA5, 0x11,
+            0xA9, 0x55,
+            0x00
+            });
+        debugger.addWatchpoint(0x000010, 0x000011, WatchRead, 0x80, 0x80);
+
+        cpu.run();
+
+        ASSERT_EQ(debugger.hits.size(), 1u);
+        EXPECT_EQ(debugger.hits[0].address, 0x000011u);
+        EXPECT_EQ(cpu.registers.A, 0x80);
+    }
+    TEST_F(DebuggerTest, Remove_ClearsPageFlags)
+    {
+        LoadProgram({
+            0xA9, 0x11,
+            0x00
+            });
+        uint32_t id = debugger.addBreakpoint(0x008000);
+        EXPECT_TRUE(cpu.memory->pageFlags(0x008000) & WatchExec);
+
+        debugger.remove(id);
+        cpu.run();
+
+        EXPECT_FALSE(cpu.memory->pageFlags(0x008000) & WatchExec);
+        EXPECT_TRUE(debugger.hits.empty());
+        EXPECT_EQ(cpu.registers.A, 0x11);
+    }
+    TEST_F(DebuggerTest, Destructor_Detaches)
+    {
+        LoadProgram({
+            0xA9, 0x11,
+            0x00
+            });
+        {
+            Debugger scoped;
+            scoped.attach(cpu);
+            scoped.addBreakpoint(0x008000);
+            EXPECT_EQ(cpu.memory->debugger, &scoped);
+        }
+
+        EXPECT_EQ(cpu.memory->debugger, nullptr);
+        EXPECT_FALSE(cpu.memory->pageFlags(0x008000) & WatchExec);
+        cpu.run();
+        EXPECT_EQ(cpu.registers.A, 0x11);
+    }
+}
@@ -0,0 +1,115 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "CpuTestFixture.h"
+#include "src/disassembler.h"
+#include "src/opcode_info.h"
+#include "src/trace.h"
+#include <cstring>
+#include <sstream>
+
+
+using DisassemblerTest = CpuTest;
+namespace Disassembler_Tests
+{
+    std::string Disassemble(std::vector<uint8_t> bytes, uint8_t p = 0x30, uint32_t pc = 0x008000)
+    {
+        bytes.resize(4, 0x00);
+        char text[32];
+        size_t n = disassemble(bytes.data(), pc, p, false, text, sizeof(text));
+        return std::string(text, n);
+    }
+
+    TEST(DisassemblerFormatTest, FormatsAddressingModes)
+    {
+        EXPECT_EQ(Disassemble({ 0xA9, 0x42 }), "LDA #$42");
+        EXPECT_EQ(Disassemble({ 0xA9, 0x34, 0x12 }, 0x00), "LDA #$1234");
+        EXPECT_EQ(Disassemble({ 0xA1, 0x10 }), "LDA ($10,X)");
+        EXPECT_EQ(Disassemble({ 0xB7, 0x10 }), "LDA [$10],Y");
+        EXPECT_EQ(Disassemble({ 0xBF, 0x56, 0x34, 0x12 }), "LDA $123456,X");
+        EXPECT_EQ(Disassemble({ 0x93, 0x05 }), "STA ($05,S),Y");
+        EXPECT_EQ(Disassemble({ 0xC2, 0x30 }, 0x00), "REP #$30");
+        EXPECT_EQ(Disassemble({ 0x54, 0x7E, 0x7F }), "MVN $7F,$7E");
+        EXPECT_EQ(Disassemble({ 0xD0, 0xFE }), "BNE $8000");
+        EXPECT_EQ(Disassemble({ 0xFB }), "XCE");
+    }
+
+    TEST(DisassemblerFormatTest, EmulationModeForcesShortImmediates)
+    {
+        uint8_t bytes[4] = { 0xA2, 0x12, 0x34, 0x00 };
+        char text[32];
+        disassemble(bytes, 0x8000, 0x00, true, text, sizeof(text));
+
+        EXPECT_STREQ(text, "LDX #$12");
+        EXPECT_EQ(instructionLength(0xA2, 0x00, true), 2);
+    }
+
+    // Branches, jumps and returns load PC themselves
+    bool changesFlow(uint8_t op)
+    {
+        static const char* const transfers[] = { "JMP", "JML", "JSR", "JSL", "RTS", "RTL", "RTI" };
+        const OpcodeInfo& info = opcodeInfo[op];
+        if (info.mode == AddrMode::Relative || info.mode == AddrMode::RelativeLong)
+            return true;
+        for (const char* mnemonic : transfers)
+        {
+            if (std::strcmp(info.mnemonic, mnemonic) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // Every registered handler must consume exactly the operand bytes the
+    // opcode table describes, in both register widths
+    TEST_F(DisassemblerTest, HandlersMatchOpcodeTableLengths)
+    {
+        for (uint8_t p : { uint8_t(0x30), uint8_t(0x00) })
+        {
+            for (int op = 0; op < 256; ++op)
+            {
+                if (!cpu.hasHandler(uint8_t(op)) || changesFlow(uint8_t(op)))
+                    continue;
+
+                SetUp();
+                LoadProgram({ uint8_t(op), 0x10, 0x00, 0x7E, 0x00 });
+                cpu.registers.P = p;
+                cpu.step();
+                if (!cpu.running)
+                    continue;
+
+                EXPECT_EQ(cpu.registers.PC - 0x8000, instructionLength(uint8_t(op), p, false))
+                    << "opcode " << std::hex << op << " P=" << int(p);
+            }
+        }
+    }
+
+    TEST_F(DisassemblerTest, TraceLogsEachInstruction)
+    {
+        std::ostringstream out;
+        {
+            TraceLogger tracer(out, 4);
+            cpu.tracer = &tracer;
+            LoadProgram({
+                0xA9, 0x42,
+                0x8D, 0x34, 0x12,
+                0xA2, 0x05,
+                0x00
+                });
+
+            cpu.run();
+            tracer.flush();
+            cpu.tracer = nullptr;
+        }
+
+        std::istringstream lines(out.str());
+        std::vector<std::string> trace;
+        for (std::string line; std::getline(lines, line);)
+            trace.push_back(line);
+
+        ASSERT_EQ(trace.size(), 4u);
+        EXPECT_EQ(trace[0].substr(0, 13), "008000  A9 42");
+        EXPECT_NE(trace[0].find("LDA #$42"), std::string::npos);
+        EXPECT_NE(trace[1].find("STA $1234"), std::string::npos);
+        EXPECT_NE(trace[1].find("A:0042"), std::string::npos);
+        EXPECT_NE(trace[3].find("BRK"), std::string::npos);
+    }
+}
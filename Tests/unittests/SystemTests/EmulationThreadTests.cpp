@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "src/emulation_thread.h"
+#include <chrono>
+#include <thread>
+
+namespace EmulationThread_Tests
+{
+    TEST(SpscQueueTest, KeepsOrderAndRejectsWhenFull)
+    {
+        SpscQueue<int, 4> queue;
+        for (int i = 0; i < 4; ++i)
+            EXPECT_TRUE(queue.push(i));
+        EXPECT_FALSE(queue.push(4));
+
+        int value = -1;
+        for (int i = 0; i < 4; ++i)
+        {
+            ASSERT_TRUE(queue.pop(value));
+            EXPECT_EQ(value, i);
+        }
+        EXPECT_FALSE(queue.pop(value));
+        EXPECT_TRUE(queue.empty());
+    }
+
+    TEST(SpscQueueTest, HandsValuesAcrossThreads)
+    {
+        SpscQueue<uint32_t, 16> queue;
+        const uint32_t count = 5000;
+        std::thread producer([&]
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                while (!queue.push(i))
+                    std::this_thread::yield();
+            }
+        });
+
+        uint32_t expected = 0;
+        uint32_t value = 0;
+        while (expected < count)
+        {
+            if (queue.pop(value))
+            {
+                ASSERT_EQ(value, expected++);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+    }
+
+    TEST(TripleBufferTest, ReaderSeesNewestPublishedValue)
+    {
+        TripleBuffer<int> buffer(0);
+        EXPECT_FALSE(buffer.poll());
+
+        buffer.back() = 1;
+        buffer.publish();
+        buffer.back() = 2;
+        buffer.publish();
+
+        ASSERT_TRUE(buffer.poll());
+        EXPECT_EQ(buffer.front(), 2);
+        EXPECT_FALSE(buffer.poll());
+        EXPECT_EQ(buffer.front(), 2);
+    }
+
+    TEST(FramePacerTest, PeriodMatchesNtscFrameRate)
+    {
+        double hz = 1e9 / FramePacer::framePeriodNs();
+        EXPECT_NEAR(hz, 60.0988, 0.0001);
+    }
+
+    TEST(FramePacerTest, WaitsForEachDeadline)
+    {
+        FramePacer pacer;
+        auto begin = FramePacer::clock::now();
+        pacer.start();
+        for (int i = 0; i < 3; ++i)
+            pacer.wait();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(FramePacer::clock::now() - begin).count();
+
+        EXPECT_GE(elapsed, 3 * FramePacer::framePeriodNs());
+        EXPECT_EQ(pacer.stats().frames, 3u);
+    }
+
+    TEST(EmulationThreadTest, RunsFramesAndDeliversInput)
+    {
+        // Shows JOY1L as the backdrop colour every frame
+        std::vector<uint8_t> rom(0x8000, 0xEA);
+        const std::vector<uint8_t> program = {
+            0xA9, 0x0F, 0x8F, 0x00, 0x21, 0x00,   // INIDISP: full brightness
+            0xA9, 0x00, 0x8F, 0x21, 0x21, 0x00,   // loop: CGADD 0
+            0xAF, 0x18, 0x42, 0x00,               // LDA JOY1L
+            0x8F, 0x22, 0x21, 0x00,               // CGDATA low
+            0xA9, 0x00, 0x8F, 0x22, 0x21, 0x00,   // CGDATA high
+            0x80, 0xEA                            // BRA loop
+        };
+        std::copy(program.begin(), program.end(), rom.begin());
+        System system;
+        system.loadRom(rom);
+        system.init();
+
+        EmulationThread thread(system);
+        thread.start(false);
+
+        // The idle colour comes from a frame seen before any input is queued
+        auto giveUp = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        bool seen = false;
+        while (!seen && std::chrono::steady_clock::now() < giveUp)
+            seen = thread.pollFrame();
+        ASSERT_TRUE(seen);
+        uint16_t idle = thread.frame().pixels[0];
+        ASSERT_TRUE(thread.pushInput(0, ButtonA | ButtonX));
+
+        bool changed = false;
+        while (!changed && std::chrono::steady_clock::now() < giveUp)
+        {
+            if (thread.pollFrame())
+                changed = thread.frame().pixels[0] != idle;
+        }
+        thread.stop();
+
+        EXPECT_TRUE(changed);
+        EXPECT_GT(thread.framesRun(), 0u);
+        EXPECT_FALSE(thread.running());
+    }
+}
@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "GoldenFrameRunner.h"
+#include "src/system.h"
+#include "src/fast_hash.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace Golden
+{
+    namespace
+    {
+        bool parseHash(const std::string& text, uint64_t& out)
+        {
+            if (text.empty() || text.size() > 16)
+                return false;
+            char* end = nullptr;
+            out = std::strtoull(text.c_str(), &end, 16);
+            return *end == '\0';
+        }
+    }
+
+    bool parseManifest(const std::string& text, std::vector<Entry>& out, std::string& error)
+    {
+        std::istringstream lines(text);
+        std::string line;
+        for (size_t number = 1; std::getline(lines, line); ++number)
+        {
+            size_t hash = line.find('#');
+            if (hash != std::string::npos)
+                line.erase(hash);
+
+            std::istringstream fields(line);
+            Entry entry;
+            std::string video, audio;
+            if (!(fields >> entry.rom))
+                continue;
+            if (!(fields >> entry.frames >> video >> audio) || entry.frames == 0)
+            {
+                error = "line " + std::to_string(number) + ": expected <rom> <frames> <video> <audio>";
+                return false;
+            }
+            entry.hasVideo = video != "-";
+            entry.hasAudio = audio != "-";
+            if ((entry.hasVideo && !parseHash(video, entry.video)) || (entry.hasAudio && !parseHash(audio, entry.audio)))
+            {
+                error = "line " + std::to_string(number) + ": bad hash";
+                return false;
+            }
+            out.push_back(entry);
+        }
+        return true;
+    }
+
+    std::string formatManifest(const std::vector<Result>& results)
+    {
+        std::string text = "# rom frames video audio\n";
+        char line[512];
+        for (const Result& result : results)
+        {
+            if (result.status == Status::Error)
+            {
+                snprintf(line, sizeof(line), "%s %u - -\n", result.expected.rom.c_str(), result.expected.frames);
+            }
+            else
+            {
+                snprintf(line, sizeof(line), "%s %u %016llx %016llx\n", result.expected.rom.c_str(), result.expected.frames,
+                    (unsigned long long)result.video, (unsigned long long)result.audio);
+            }
+            text += line;
+        }
+        return text;
+    }
+
+    Result runImage(const std::vector<uint8_t>& image, const Entry& entry)
+    {
+        Result result;
+        result.expected = entry;
+
+        // Copier dumps carry a 512-byte header in front of the image
+        std::vector<uint8_t> rom = image;
+        if (rom.size() % 1024 == 512)
+            rom.erase(rom.begin(), rom.begin() + 512);
+        if (rom.empty())
+        {
+            result.error = "empty image";
+            return result;
+        }
+
+        System system;
+        system.loadRom(rom);
+        system.init();
+        for (uint32_t frame = 0; frame < entry.frames && system.running(); ++frame)
+        {
+            system.runFrame();
+            const std::vector<uint16_t>& pixels = system.framebuffer();
+            const std::vector<int16_t>& samples = system.audioSamples();
+            result.video = fasthash::hash(pixels.data(), pixels.size() * sizeof(uint16_t), result.video);
+            result.audio = fasthash::hash(samples.data(), samples.size() * sizeof(int16_t), result.audio);
+        }
+
+        if (!entry.hasVideo && !entry.hasAudio)
+            result.status = Status::New;
+        else if ((!entry.hasVideo || result.video == entry.video) && (!entry.hasAudio || result.audio == entry.audio))
+            result.status = Status::Matched;
+        else
+            result.status = Status::Mismatched;
+        return result;
+    }
+
+    Result runEntry(const std::string& directory, const Entry& entry)
+    {
+        std::ifstream in(directory + "/" + entry.rom, std::ios::binary);
+        if (!in)
+        {
+            Result result;
+            result.expected = entry;
+            result.error = "cannot open " + entry.rom;
+            return result;
+        }
+        std::vector<uint8_t> image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        return runImage(image, entry);
+    }
+
+    std::vector<Result> runManifest(const std::string& directory, const std::vector<Entry>& entries, unsigned threads)
+    {
+        std::vector<Result> results(entries.size());
+        std::atomic<size_t> next{ 0 };
+        if (threads == 0)
+            threads = 1;
+
+        auto worker = [&]()
+        {
+            for (size_t index = next++; index < entries.size(); index = next++)
+                results[index] = runEntry(directory, entries[index]);
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned i = 1; i < threads && i < entries.size(); ++i)
+            pool.emplace_back(worker);
+        worker();
+        for (auto& thread : pool)
+            thread.join();
+        return results;
+    }
+}
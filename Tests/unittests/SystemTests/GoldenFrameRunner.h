@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Headless regression runs over a ROM corpus. A manifest lists each ROM with the
+// frame count and the expected video/audio hashes:
+//
+//     # rom                frames  video             audio
+//     cputest-basic.sfc    600     9f3c0e1d2b4a5c6e  0123456789abcdef
+//
+// A "-" hash is not compared and is filled in when the manifest is updated.
+namespace Golden
+{
+    struct Entry
+    {
+        std::string rom;			// Relative to the manifest's directory
+        uint32_t frames = 0;
+        uint64_t video = 0;
+        uint64_t audio = 0;
+        bool hasVideo = false;		// False for a "-" hash
+        bool hasAudio = false;
+    };
+
+    enum class Status { Matched, Mismatched, New, Error };
+
+    struct Result
+    {
+        Entry expected;
+        uint64_t video = 0;		// Every rendered frame chained through the hash
+        uint64_t audio = 0;
+        Status status = Status::Error;
+        std::string error;
+    };
+
+    bool parseManifest(const std::string& text, std::vector<Entry>& out, std::string& error);
+    std::string formatManifest(const std::vector<Result>& results);
+
+    // Boots the ROM image and runs it for the given number of frames
+    Result runImage(const std::vector<uint8_t>& image, const Entry& entry);
+    Result runEntry(const std::string& directory, const Entry& entry);
+
+    // ROMs are handed out to threads one at a time, each with its own System
+    std::vector<Result> runManifest(const std::string& directory, const std::vector<Entry>& entries, unsigned threads);
+}
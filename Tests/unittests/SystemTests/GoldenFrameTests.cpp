@@ -0,0 +1,164 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "GoldenFrameRunner.h"
+#include "src/fast_hash.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace Golden_Tests
+{
+    // Sets the backdrop to the colour in the immediate operands, then spins
+    std::vector<uint8_t> BackdropRom(uint8_t low, uint8_t high)
+    {
+        std::vector<uint8_t> rom(0x8000, 0xEA);
+        const std::vector<uint8_t> program = {
+            0xA9, 0x0F, 0x8F, 0x00, 0x21, 0x00,   // INIDISP: full brightness
+            0xA9, 0x00, 0x8F, 0x21, 0x21, 0x00,   // CGADD 0
+            0xA9, low,  0x8F, 0x22, 0x21, 0x00,   // CGDATA
+            0xA9, high, 0x8F, 0x22, 0x21, 0x00,
+            0x80, 0xFE                            // BRA *
+        };
+        std::copy(program.begin(), program.end(), rom.begin());
+        return rom;
+    }
+
+    TEST(FastHashTest, SimdMatchesScalarAtEveryLength)
+    {
+        std::vector<uint8_t> bytes(4096 + 70);
+        for (size_t i = 0; i < bytes.size(); ++i)
+            bytes[i] = uint8_t(i * 131 + (i >> 7));
+
+        for (size_t size : { 0, 1, 7, 63, 64, 65, 1023, 1024, 1088, 4096, 4166 })
+        {
+            EXPECT_EQ(fasthash::hash(bytes.data(), size), fasthash::hashScalar(bytes.data(), size)) << size;
+            EXPECT_EQ(fasthash::hash(bytes.data(), size, 99), fasthash::hashScalar(bytes.data(), size, 99)) << size;
+        }
+    }
+
+    TEST(FastHashTest, SensitiveToEveryBitLengthAndSeed)
+    {
+        std::vector<uint8_t> bytes(2048, 0x00);
+        uint64_t base = fasthash::hash(bytes.data(), bytes.size());
+        for (size_t bit = 0; bit < bytes.size() * 8; bit += 97)
+        {
+            bytes[bit / 8] ^= uint8_t(1 << (bit % 8));
+            EXPECT_NE(fasthash::hash(bytes.data(), bytes.size()), base) << bit;
+            bytes[bit / 8] ^= uint8_t(1 << (bit % 8));
+        }
+        EXPECT_NE(fasthash::hash(bytes.data(), bytes.size() - 1), base);
+        EXPECT_NE(fasthash::hash(bytes.data(), bytes.size(), 1), base);
+    }
+
+    TEST(GoldenTest, ParsesAndFormatsManifest)
+    {
+        std::vector<Golden::Entry> entries;
+        std::string error;
+        ASSERT_TRUE(Golden::parseManifest(
+            "# comment\n"
+            "a.sfc 60 00000000000000ff 0000000000000001\n"
+            "\n"
+            "b.sfc 30 - -   # not recorded yet\n"
+            "v.sfc 20 00000000000000ee -\n", entries, error)) << error;
+        ASSERT_EQ(entries.size(), 3u);
+        EXPECT_EQ(entries[0].video, 0xFFu);
+        EXPECT_TRUE(entries[0].hasVideo && entries[0].hasAudio);
+        EXPECT_FALSE(entries[1].hasVideo || entries[1].hasAudio);
+        EXPECT_EQ(entries[2].video, 0xEEu);
+        EXPECT_TRUE(entries[2].hasVideo);
+        EXPECT_FALSE(entries[2].hasAudio);
+
+        EXPECT_FALSE(Golden::parseManifest("c.sfc 10 xyz -\n", entries, error));
+
+        Golden::Result result;
+        result.expected = entries[0];
+        result.status = Golden::Status::Matched;
+        result.video = 0xAB;
+        result.audio = 0xCD;
+        EXPECT_EQ(Golden::formatManifest({ result }), "# rom frames video audio\na.sfc 60 00000000000000ab 00000000000000cd\n");
+    }
+
+    TEST(GoldenTest, DetectsChangedOutput)
+    {
+        Golden::Entry entry;
+        entry.rom = "red";
+        entry.frames = 3;
+        Golden::Result recorded = Golden::runImage(BackdropRom(0x1F, 0x00), entry);
+        ASSERT_EQ(recorded.status, Golden::Status::New);
+
+        entry.video = recorded.video;
+        entry.audio = recorded.audio;
+        entry.hasVideo = true;
+        entry.hasAudio = true;
+        EXPECT_EQ(Golden::runImage(BackdropRom(0x1F, 0x00), entry).status, Golden::Status::Matched);
+
+        Golden::Result changed = Golden::runImage(BackdropRom(0x00, 0x7C), entry);
+        EXPECT_EQ(changed.status, Golden::Status::Mismatched);
+        EXPECT_EQ(changed.audio, recorded.audio);
+
+        // A "-" hash is left out of the comparison
+        Golden::Entry audioOnly = entry;
+        audioOnly.hasVideo = false;
+        EXPECT_EQ(Golden::runImage(BackdropRom(0x00, 0x7C), audioOnly).status, Golden::Status::Matched);
+        Golden::Entry videoOnly = entry;
+        videoOnly.hasAudio = false;
+        videoOnly.audio = ~recorded.audio;
+        EXPECT_EQ(Golden::runImage(BackdropRom(0x1F, 0x00), videoOnly).status, Golden::Status::Matched);
+    }
+
+    // Point SNES_GOLDEN_DIR at a directory holding ROMs and a goldens.txt manifest.
+    // SNES_GOLDEN_UPDATE=1 rewrites the manifest with the hashes from this run.
+    TEST(GoldenTest, Corpus)
+    {
+        const char* directory = std::getenv("SNES_GOLDEN_DIR");
+        if (!directory)
+            GTEST_SKIP() << "SNES_GOLDEN_DIR is not set";
+
+        std::string manifest = std::string(directory) + "/goldens.txt";
+        std::ifstream in(manifest);
+        ASSERT_TRUE(in.good()) << "missing " << manifest;
+        std::stringstream text;
+        text << in.rdbuf();
+        in.close();
+
+        std::vector<Golden::Entry> entries;
+        std::string error;
+        ASSERT_TRUE(Golden::parseManifest(text.str(), entries, error)) << error;
+
+        auto begin = std::chrono::steady_clock::now();
+        auto results = Golden::runManifest(directory, entries, std::max(1u, std::thread::hardware_concurrency()));
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        size_t matched = 0, mismatched = 0, fresh = 0, errors = 0;
+        for (const auto& result : results)
+        {
+            switch (result.status)
+            {
+            case Golden::Status::Matched: ++matched; break;
+            case Golden::Status::New: ++fresh; break;
+            case Golden::Status::Mismatched:
+                ++mismatched;
+                std::cout << "[ golden   ] " << result.expected.rom << ": output changed" << std::endl;
+                break;
+            case Golden::Status::Error:
+                ++errors;
+                std::cout << "[ golden   ] " << result.expected.rom << ": " << result.error << std::endl;
+                break;
+            }
+        }
+        std::cout << "[ golden   ] " << results.size() << " roms in " << seconds << " s, " << matched << " matched, "
+                  << mismatched << " changed, " << fresh << " new, " << errors << " errors" << std::endl;
+
+        if (std::getenv("SNES_GOLDEN_UPDATE"))
+        {
+            std::ofstream out(manifest);
+            out << Golden::formatManifest(results);
+            return;
+        }
+        EXPECT_EQ(mismatched, 0u);
+        EXPECT_EQ(errors, 0u);
+    }
+}
@@ -0,0 +1,162 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "CpuTestFixture.h"
+#include "src/interrupts.h"
+#include "src/scheduler.h"
+#include "src/timing.h"
+
+
+class InterruptTest : public CpuTest
+{
+protected:
+    IoDispatcher io;
+    Scheduler scheduler;
+    InterruptController interrupts;
+    std::vector<uint8_t> rom;
+
+    // Writes code into the 32K bank 0 ROM image at the given CPU address
+    void Place(uint16_t address, const std::vector<uint8_t>& code)
+    {
+        std::copy(code.begin(), code.end(), rom.begin() + (address - 0x8000));
+    }
+
+    void SetVector(uint16_t vector, uint16_t target)
+    {
+        Place(vector, { uint8_t(target), uint8_t(target >> 8) });
+    }
+
+    void Load()
+    {
+        memory->loadRom(rom);
+    }
+
+    void SetUp() override
+    {
+        CpuTest::SetUp();
+        memory->map.mapIo(&io);
+        rom.assign(0x8000, 0xEA);
+        cpu.registers.S = 0x01FF;
+        cpu.registers.P = 0x30;
+        interrupts.attach(cpu, io, scheduler);
+    }
+};
+
+namespace Interrupt_Tests
+{
+    TEST_F(InterruptTest, NmiEntersNativeVectorAndRtiReturns)
+    {
+        SetVector(0xFFEA, 0x9000);
+        Place(0x9000, { 0x40 });
+        Load();
+        cpu.registers.PBR = 0x00;
+        cpu.registers.PC = 0x8123;
+
+        cpu.raiseNmi();
+        cpu.step();
+
+        EXPECT_EQ(cpu.registers.PC, 0x9000);
+        EXPECT_TRUE(cpu.registers.P & I);
+        EXPECT_EQ(cpu.registers.S, 0x01FB);
+        EXPECT_EQ(memory->wram.read(0x01FF), 0x00);	// PBR
+        EXPECT_EQ(memory->wram.read(0x01FE), 0x81);
+        EXPECT_EQ(memory->wram.read(0x01FD), 0x23);
+        EXPECT_EQ(memory->wram.read(0x01FC), 0x30);
+        EXPECT_EQ(cpu.pendingInterrupts, 0);
+
+        cpu.step();
+
+        EXPECT_EQ(cpu.registers.PC, 0x8123);
+        EXPECT_EQ(cpu.registers.P, 0x30);
+        EXPECT_EQ(cpu.registers.S, 0x01FF);
+    }
+
+    TEST_F(InterruptTest, EmulationModeUsesEmulationVectors)
+    {
+        SetVector(0xFFFE, 0x9100);
+        Load();
+        cpu.registers.E = true;
+        cpu.registers.S = 0x01F0;
+
+        cpu.setIrq(true);
+        cpu.step();
+
+        EXPECT_EQ(cpu.registers.PC, 0x9100);
+        EXPECT_EQ(cpu.registers.S, 0x01ED);
+        EXPECT_EQ(memory->wram.read(0x01EE), 0x20);	// B clear on a hardware IRQ
+    }
+
+    TEST_F(InterruptTest, IrqIsHeldWhileMasked)
+    {
+        SetVector(0xFFEE, 0x9000);
+        Load();
+        cpu.registers.P = 0x30 | I;
+
+        cpu.setIrq(true);
+        cpu.step();
+        EXPECT_EQ(cpu.registers.PC, 0x8001);
+
+        Place(0x8001, { 0x58 });	// CLI
+        Load();
+        cpu.step();
+        cpu.step();
+        EXPECT_EQ(cpu.registers.PC, 0x9000);
+    }
+
+    TEST_F(InterruptTest, VBlankRaisesNmiWhenEnabled)
+    {
+        // LDA #$80 / STA $004200 / BRA *
+        Place(0x8000, { 0xA9, 0x80, 0x8F, 0x00, 0x42, 0x00, 0x80, 0xFE });
+        // LDA #$42 / STA $7E0010 / RTI
+        Place(0x9000, { 0xA9, 0x42, 0x8F, 0x10, 0x00, 0x7E, 0x40 });
+        SetVector(0xFFEA, 0x9000);
+        Load();
+
+        scheduler.run(cpu, InterruptController::VBLANK_LINE * timing::CLOCKS_PER_SCANLINE - 1);
+        EXPECT_EQ(memory->wram.read(0x0010), 0xFF);
+
+        scheduler.run(cpu, (InterruptController::VBLANK_LINE + 1) * timing::CLOCKS_PER_SCANLINE);
+        EXPECT_EQ(memory->wram.read(0x0010), 0x42);
+        EXPECT_TRUE(interrupts.nmiFlag);
+        EXPECT_EQ(memory->map.read(0x004210), 0x82);
+        EXPECT_EQ(memory->map.read(0x004210), 0x02);
+    }
+
+    TEST_F(InterruptTest, VTimerRaisesIrqAtLine)
+    {
+        Place(0x8000, {
+            0xA9, 100, 0x8F, 0x09, 0x42, 0x00,	// VTIME = 100
+            0xA9, 0x00, 0x8F, 0x0A, 0x42, 0x00,
+            0xA9, 0x20, 0x8F, 0x00, 0x42, 0x00,	// V-IRQ enable
+            0x58,								// CLI
+            0x80, 0xFE							// BRA *
+            });
+        // LDA $004211 / LDA #$37 / STA $7E0011 / RTI
+        Place(0x9000, { 0xAF, 0x11, 0x42, 0x00, 0xA9, 0x37, 0x8F, 0x11, 0x00, 0x7E, 0x40 });
+        SetVector(0xFFEE, 0x9000);
+        Load();
+
+        scheduler.run(cpu, 100 * timing::CLOCKS_PER_SCANLINE);
+        EXPECT_EQ(memory->wram.read(0x0011), 0xFF);
+
+        scheduler.run(cpu, 101 * timing::CLOCKS_PER_SCANLINE);
+        EXPECT_EQ(memory->wram.read(0x0011), 0x37);
+        EXPECT_FALSE(interrupts.timeUp);
+        EXPECT_EQ(cpu.pendingInterrupts, 0);
+    }
+
+    TEST_F(InterruptTest, TimerMatchesFollowNmitimenMode)
+    {
+        interrupts.htime = 0x20;
+        interrupts.vtime = 10;
+
+        interrupts.nmitimen = 0x10;
+        EXPECT_EQ(interrupts.nextTimerMatch(0), 0x20u * InterruptController::CLOCKS_PER_DOT);
+        EXPECT_EQ(interrupts.nextTimerMatch(0x80), timing::CLOCKS_PER_SCANLINE + 0x80u);
+
+        interrupts.nmitimen = 0x30;
+        EXPECT_EQ(interrupts.nextTimerMatch(0), 10u * timing::CLOCKS_PER_SCANLINE + 0x80u);
+
+        interrupts.vtime = 300;
+        EXPECT_EQ(interrupts.nextTimerMatch(0), Scheduler::NEVER);
+    }
+}
@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "src/media_dump.h"
+#include "src/system.h"
+#include "src/timing.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace MediaDump_Tests
+{
+    std::vector<uint8_t> ReadFile(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    uint32_t Read32(const std::vector<uint8_t>& bytes, size_t offset)
+    {
+        return bytes[offset] | bytes[offset + 1] << 8 | bytes[offset + 2] << 16 | uint32_t(bytes[offset + 3]) << 24;
+    }
+
+    // Records frames of a program that shows JOY1L as the backdrop, with input changing every frame
+    void Record(const std::string& video, const std::string& audio, DumpStats& stats)
+    {
+        std::vector<uint8_t> rom(0x8000, 0xEA);
+        const std::vector<uint8_t> program = {
+            0xA9, 0x0F, 0x8F, 0x00, 0x21, 0x00,   // INIDISP: full brightness
+            0xA9, 0x00, 0x8F, 0x21, 0x21, 0x00,   // loop: CGADD 0
+            0xAF, 0x18, 0x42, 0x00,               // LDA JOY1L
+            0x8F, 0x22, 0x21, 0x00,               // CGDATA low
+            0xA9, 0x00, 0x8F, 0x22, 0x21, 0x00,   // CGDATA high
+            0x80, 0xEA                            // BRA loop
+        };
+        std::copy(program.begin(), program.end(), rom.begin());
+        System system;
+        system.loadRom(rom);
+        system.init();
+
+        MediaDump dump;
+        DumpSettings settings;
+        settings.videoPath = video;
+        settings.audioPath = audio;
+        settings.bufferBytes = 64 * 1024;
+        ASSERT_TRUE(dump.open(settings));
+        system.setFrameCallback([&dump](const System& s) { dump.record(s); });
+        for (uint16_t i = 0; i < 12; ++i)
+        {
+            system.setInput(0, uint16_t(i * 0x1230));
+            system.runFrame();
+        }
+        ASSERT_TRUE(dump.close());
+        stats = dump.stats();
+    }
+
+    TEST(DumpFileTest, TrimsPaddedTailOnClose)
+    {
+        std::string path = "dumpfile_test.bin";
+        alignas(4096) static uint8_t block[DumpFile::ALIGNMENT];
+        for (size_t i = 0; i < sizeof(block); ++i)
+            block[i] = uint8_t(i * 7);
+
+        DumpFile file;
+        ASSERT_TRUE(file.open(path, true));
+        ASSERT_TRUE(file.write(block, sizeof(block)));
+        ASSERT_TRUE(file.write(block, sizeof(block)));
+        ASSERT_TRUE(file.close(DumpFile::ALIGNMENT + 100));
+
+        std::vector<uint8_t> bytes = ReadFile(path);
+        std::remove(path.c_str());
+        ASSERT_EQ(bytes.size(), DumpFile::ALIGNMENT + 100);
+        EXPECT_TRUE(std::equal(bytes.begin() + DumpFile::ALIGNMENT, bytes.end(), block));
+    }
+
+    TEST(MediaDumpTest, IdenticalRunsWriteIdenticalFiles)
+    {
+        DumpStats first, second;
+        Record("dump_a.y4m", "dump_a.wav", first);
+        Record("dump_b.y4m", "dump_b.wav", second);
+        std::vector<uint8_t> videoA = ReadFile("dump_a.y4m"), videoB = ReadFile("dump_b.y4m");
+        std::vector<uint8_t> audioA = ReadFile("dump_a.wav"), audioB = ReadFile("dump_b.wav");
+        for (const char* path : { "dump_a.y4m", "dump_a.wav", "dump_b.y4m", "dump_b.wav" })
+            std::remove(path);
+
+        EXPECT_EQ(videoA, videoB);
+        EXPECT_EQ(audioA, audioB);
+        EXPECT_EQ(first.frames, 12u);
+        EXPECT_EQ(first.videoBytes, videoA.size());
+
+        std::string header(videoA.begin(), std::find(videoA.begin(), videoA.end(), uint8_t('\n')) + 1);
+        EXPECT_EQ(header.compare(0, 21, "YUV4MPEG2 W256 H224 F"), 0) << header;
+        EXPECT_EQ(videoA.size(), header.size() + 12 * (6 + PPU::WIDTH * PPU::HEIGHT * 3));
+
+        // Frames differ as the input does
+        size_t frameBytes = 6 + PPU::WIDTH * PPU::HEIGHT * 3;
+        EXPECT_NE(videoA[header.size() + 6], videoA[header.size() + 10 * frameBytes + 6]);
+
+        ASSERT_GE(audioA.size(), 44u);
+        EXPECT_EQ(Read32(audioA, 4), audioA.size() - 8);
+        EXPECT_EQ(Read32(audioA, 24), timing::AUDIO_SAMPLE_RATE);
+        EXPECT_EQ(Read32(audioA, 40), audioA.size() - 44);
+        EXPECT_GT(audioA.size(), 44u + 12 * 500 * 4);
+    }
+
+    TEST(MediaDumpTest, RawRgbKeepsEveryFramePastTheQueue)
+    {
+        std::string path = "dump_raw.rgb";
+        MediaDump dump;
+        DumpSettings settings;
+        settings.videoPath = path;
+        settings.video = VideoDump::RawRgb;
+        ASSERT_TRUE(dump.open(settings));
+
+        const size_t count = MediaDump::QUEUE_FRAMES * 3;
+        std::vector<uint16_t> frame(PPU::WIDTH * PPU::HEIGHT);
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::fill(frame.begin(), frame.end(), uint16_t(i & 0x1F));
+            dump.addFrame(frame.data(), nullptr, 0);
+        }
+        ASSERT_TRUE(dump.close());
+        std::vector<uint8_t> bytes = ReadFile(path);
+        std::remove(path.c_str());
+
+        size_t frameBytes = PPU::WIDTH * PPU::HEIGHT * 3;
+        ASSERT_EQ(bytes.size(), count * frameBytes);
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint8_t red = uint8_t(((i & 0x1F) << 3) | ((i & 0x1F) >> 2));
+            ASSERT_EQ(bytes[i * frameBytes + frameBytes - 3], red) << "frame " << i;
+            ASSERT_EQ(bytes[i * frameBytes + 1], 0) << "frame " << i;
+        }
+        EXPECT_EQ(dump.stats().frames, count);
+    }
+}
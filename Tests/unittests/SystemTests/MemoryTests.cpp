@@ -0,0 +1,426 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "src/bus.h"
+#include "src/rom_store.h"
+#include "src/ppu.h"
+#include "src/cpu.h"
+#include "src/coverage.h"
+#include "src/sram.h"
+#include "src/system.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace Memory_Tests
+{
+    namespace RomStore_Tests
+    {
+        TEST(RomStoreTest, IdenticalImagesShareOneCopy)
+        {
+            std::vector<uint8_t> program = { 0xA9, 0x42, 0x8D, 0x00, 0x10, 0x00 };
+            ROM first(program);
+            ROM second(program);
+
+            EXPECT_EQ(first.image().get(), second.image().get());
+            EXPECT_EQ(second.read(0x0001), 0x42);
+        }
+        TEST(RomStoreTest, DifferentImagesAreKeptApart)
+        {
+            ROM first(std::vector<uint8_t>{ 0x01, 0x02, 0x03 });
+            ROM second(std::vector<uint8_t>{ 0x01, 0x02, 0x04 });
+
+            EXPECT_NE(first.image().get(), second.image().get());
+            EXPECT_EQ(second.read(0x0002), 0x04);
+        }
+        TEST(RomStoreTest, ImageIsReleasedWithLastUser)
+        {
+            std::vector<uint8_t> program(0x100, 0x5A);
+            std::weak_ptr<const std::vector<uint8_t>> weak;
+            {
+                ROM rom(program);
+                weak = rom.image();
+                EXPECT_FALSE(weak.expired());
+            }
+            EXPECT_TRUE(weak.expired());
+        }
+        TEST(RomStoreTest, InternReportsTheImageHash)
+        {
+            std::vector<uint8_t> program(0x100, 0x3C);
+            uint64_t hashed = 0;
+            RomImage image = RomStore::instance().intern(program, &hashed);
+            EXPECT_EQ(hashed, RomStore::hash(program));
+
+            uint64_t again = 0;
+            EXPECT_EQ(RomStore::instance().intern(program, &again).get(), image.get());
+            EXPECT_EQ(again, hashed);
+        }
+    }
+
+    namespace IoDispatch_Tests
+    {
+        TEST(IoDispatchTest, AllBankMirrorsResolveToTheSameRegister)
+        {
+            IoDispatcher io;
+            MemoryMap map;
+            uint8_t latched = 0;
+            io.registerWrite(0x4200, [](void* ctx, uint16_t, uint8_t value) { *static_cast<uint8_t*>(ctx) = value; }, &latched);
+            io.registerRead(0x4200, [](void* ctx, uint16_t) -> uint8_t { return *static_cast<uint8_t*>(ctx); }, &latched);
+            map.mapIo(&io);
+
+            map.write(0x004200, 0x11);
+            EXPECT_EQ(latched, 0x11);
+            map.write(0x3F4200, 0x22);
+            EXPECT_EQ(latched, 0x22);
+            map.write(0x804200, 0x33);
+            EXPECT_EQ(map.read(0xBF4200), 0x33);
+        }
+        TEST(IoDispatchTest, HighBanksAreNotIoMirrors)
+        {
+            IoDispatcher io;
+            MemoryMap map;
+            RAM ram(0x10000);
+            uint8_t latched = 0;
+            io.registerWrite(0x2100, [](void* ctx, uint16_t, uint8_t value) { *static_cast<uint8_t*>(ctx) = value; }, &latched);
+            map.mapIo(&io);
+            map.map(0x400000, 0x40FFFF, &ram);
+
+            map.write(0x402100, 0x44);
+
+            EXPECT_EQ(latched, 0x00);
+            EXPECT_EQ(ram.read(0x2100), 0x44);
+        }
+        TEST(IoDispatchTest, UnregisteredRegisterReadsOpenBus)
+        {
+            IoDispatcher io;
+            MemoryMap map;
+            RAM ram(0x10);
+            ram.write(0x0000, 0x5C);
+            map.mapIo(&io);
+            map.map(0x7E0000, 0x7E000F, &ram);
+
+            map.read(0x7E0000);
+
+            EXPECT_EQ(map.read(0x002140), 0x5C);
+        }
+        TEST(IoDispatchTest, PpuCgramWritesThroughPorts)
+        {
+            IoDispatcher io;
+            MemoryMap map;
+            PPU ppu;
+            ppu.attach(io);
+            map.mapIo(&io);
+
+            map.write(0x002121, 0x05);
+            map.write(0x002122, 0x1F);
+            map.write(0x002122, 0x7C);
+
+            EXPECT_EQ(ppu.cgram[5], 0x7C1F);
+        }
+        TEST(IoDispatchTest, PpuVramIncrementsOnHighByte)
+        {
+            IoDispatcher io;
+            MemoryMap map;
+            PPU ppu;
+            ppu.attach(io);
+            map.mapIo(&io);
+
+            map.write(0x002115, 0x80);
+            map.write(0x002116, 0x00);
+            map.write(0x002117, 0x10);
+            map.write(0x002118, 0x34);
+            map.write(0x002119, 0x12);
+            map.write(0x002118, 0x78);
+            map.write(0x002119, 0x56);
+
+            EXPECT_EQ(ppu.vram[0x1000], 0x1234);
+            EXPECT_EQ(ppu.vram[0x1001], 0x5678);
+        }
+    }
+    namespace Bus_Tests
+    {
+        TEST(BusTest, LowBanksMirrorTheFirstWramPage)
+        {
+            Bus bus;
+
+            bus.map.write(0x000010, 0x5A);
+            bus.map.write(0xBF1FFF, 0xA5);
+
+            EXPECT_EQ(bus.map.read(0x7E0010), 0x5A);
+            EXPECT_EQ(bus.map.read(0x800010), 0x5A);
+            EXPECT_EQ(bus.map.read(0x7E1FFF), 0xA5);
+            EXPECT_EQ(bus.map.read(0x3F1FFF), 0xA5);
+            EXPECT_TRUE(Bus::isWram(0x3F1FFF));
+            EXPECT_FALSE(Bus::isWram(0x400010));
+            EXPECT_EQ(Bus::wramOffset(0x801234), 0x1234u);
+        }
+        TEST(BusTest, FixedRegionsWinOverCartridge)
+        {
+            Bus bus;
+            RAM cartridge(0x10000);
+            bus.mapCartridge(0x000000, 0x00FFFF, &cartridge);
+
+            bus.map.write(0x000100, 0x11);
+            bus.map.write(0x002100, 0x33);	// I/O page, not cartridge
+            bus.map.write(0x006000, 0x22);
+
+            EXPECT_EQ(bus.wram.read(0x0100), 0x11);
+            EXPECT_EQ(cartridge.read(0x0100), 0x00);
+            EXPECT_EQ(cartridge.read(0x6000), 0x22);
+            EXPECT_EQ(cartridge.read(0x2100), 0x00);
+        }
+        TEST(BusTest, ReloadingRomKeepsCartridgeRegions)
+        {
+            Bus bus;
+            RAM cartridge(0x8000);
+            bus.loadRom({ 0x01, 0x02 });
+            bus.mapCartridge(0x700000, 0x707FFF, &cartridge);
+            bus.loadRom({ 0x03, 0x04, 0x05 });
+
+            bus.map.write(0x700010, 0x42);
+
+            EXPECT_EQ(bus.peek(0x008002), 0x05);
+            EXPECT_EQ(cartridge.read(0x0010), 0x42);
+        }
+    }
+    namespace Coverage_Tests
+    {
+        TEST(CoverageTest, MarksExecutedReadAndWrittenBytes)
+        {
+            Bus memory;
+            memory.loadRom({
+                0xAD, 0x00, 0x01,
+                0x8D, 0x34, 0x12,
+                0x00
+                });
+            CPU cpu;
+            cpu.memory = &memory.map;
+            cpu.registers.PC = 0x008000;
+            cpu.registers.DBR = 0x7E;
+            cpu.running = true;
+            Coverage coverage(memory.rom.size());
+            coverage.attach(memory.map, &memory.rom, &memory.wram);
+
+            cpu.run();
+
+            EXPECT_EQ(coverage.rom.executed[0], 0x7F);
+            EXPECT_EQ(coverage.rom.readFrom[0], 0x00);
+            EXPECT_TRUE(coverage.wram.readFrom[0x0100 >> 3] & 0x01);
+            EXPECT_TRUE(coverage.wram.writtenTo[0x1234 >> 3] & (1 << (0x1234 & 7)));
+            EXPECT_FALSE(coverage.wram.writtenTo[0x1235 >> 3] & (1 << (0x1235 & 7)));
+        }
+        TEST(CoverageTest, MergesAcrossRunsThroughFile)
+        {
+            Coverage first(0x100);
+            Coverage second(0x100);
+            first.rom.executed[0] = 0x01;
+            second.rom.executed[0] = 0x80;
+            second.wram.writtenTo[2] = 0x10;
+            std::string path = "coverage_merge_test.bin";
+
+            ASSERT_TRUE(second.save(path));
+            ASSERT_TRUE(first.mergeFile(path));
+            std::remove(path.c_str());
+
+            EXPECT_EQ(first.rom.executed[0], 0x81);
+            EXPECT_EQ(first.wram.writtenTo[2], 0x10);
+            EXPECT_NE(first.summary().find("executed        2"), std::string::npos);
+        }
+        TEST(CoverageTest, DetachStopsMarking)
+        {
+            Bus memory;
+            Coverage coverage(0x10);
+            coverage.attach(memory.map, nullptr, &memory.wram);
+            coverage.detach();
+
+            memory.map.write(0x7E0010, 0x01);
+
+            EXPECT_EQ(coverage.wram.writtenTo[2], 0x00);
+        }
+        TEST(CoverageTest, DestructorDetaches)
+        {
+            Bus memory;
+            {
+                Coverage coverage(0x10);
+                coverage.attach(memory.map, nullptr, &memory.wram);
+            }
+
+            // Would write through the freed bitmap if the map still held it
+            memory.map.write(0x7E0010, 0x01);
+            EXPECT_EQ(memory.map.read(0x7E0010), 0x01);
+        }
+        TEST(CoverageTest, MergeFileRejectsMismatchedSizes)
+        {
+            std::string path = "coverage_size_test.bin";
+            Coverage saved(0x100);
+            saved.rom.executed[0] = 0x01;
+            ASSERT_TRUE(saved.save(path));
+
+            // Different ROM size in the header
+            Coverage other(0x200);
+            EXPECT_FALSE(other.mergeFile(path));
+
+            // Right sizes in the header, but the bitmaps are cut short
+            std::vector<char> bytes;
+            {
+                std::ifstream in(path, std::ios::binary);
+                bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            }
+            {
+                std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                out.write(bytes.data(), std::streamsize(bytes.size() - 1));
+            }
+            Coverage same(0x100);
+            EXPECT_FALSE(same.mergeFile(path));
+            EXPECT_EQ(same.rom.executed[0], 0x00);
+
+            // A header claiming a huge ROM is refused before anything is allocated
+            bytes[8] = bytes[9] = bytes[10] = bytes[11] = char(0xFF);
+            {
+                std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                out.write(bytes.data(), std::streamsize(bytes.size()));
+            }
+            EXPECT_FALSE(same.mergeFile(path));
+            std::remove(path.c_str());
+        }
+    }
+    namespace Sram_Tests
+    {
+        TEST(SramTest, PersistsAcrossReopen)
+        {
+            std::string path = "sram_persist_test.srm";
+            std::remove(path.c_str());
+            {
+                SRAM sram;
+                ASSERT_TRUE(sram.open(path, 0x2000));
+                sram.write(0x0010, 0x5A);
+                sram.write(0x1FFF, 0xA5);
+            }
+
+            SRAM sram;
+            ASSERT_TRUE(sram.open(path, 0x2000));
+            EXPECT_EQ(sram.read(0x0010), 0x5A);
+            EXPECT_EQ(sram.read(0x1FFF), 0xA5);
+            EXPECT_EQ(sram.read(0x2010), 0x5A);	// Mirrors past the end
+            sram.close();
+            std::remove(path.c_str());
+        }
+        TEST(SramTest, FlushesDirtyPagesOnInterval)
+        {
+            std::string path = "sram_interval_test.srm";
+            const uint32_t page = SRAM::pageSize();
+            SRAM sram;
+            ASSERT_TRUE(sram.open(path, page * 4));
+            sram.syncInterval = 3;
+
+            sram.write(0x0000, 0x01);
+            sram.write(0x0001, 0x02);
+            sram.write(page * 2 + 0x10, 0x03);
+            sram.write(page * 3, 0x00);	// Unchanged byte leaves the page clean
+            EXPECT_EQ(sram.dirtyPages(), 2u);
+
+            sram.endFrame();
+            sram.endFrame();
+            EXPECT_EQ(sram.dirtyPages(), 2u);
+            sram.endFrame();
+            EXPECT_EQ(sram.dirtyPages(), 0u);
+
+            sram.write(0x0002, 0x04);
+            EXPECT_TRUE(sram.flush(true));
+            EXPECT_EQ(sram.dirtyPages(), 0u);
+
+            sram.close();
+            std::remove(path.c_str());
+        }
+        TEST(SramTest, MappingTwiceRegistersOnce)
+        {
+            Bus bus;
+            SRAM sram;
+            sram.open("missing_directory/save.srm", 0x800);
+            bus.mapCartridge(0x700000, 0x707FFF, &sram);
+            uint32_t generation = bus.map.generation();
+
+            bus.mapCartridge(0x700000, 0x707FFF, &sram);
+            EXPECT_EQ(bus.map.generation(), generation);
+
+            bus.map.write(0x700010, 0x42);
+            EXPECT_EQ(sram.read(0x10), 0x42);
+        }
+        TEST(SramTest, ExecutesFromReloadedSram)
+        {
+            // Each save holds a loop that stores its own marker: LDA #marker; STA $7E0100; BRA start
+            auto writeSave = [](const std::string& path, uint8_t marker)
+            {
+                const uint8_t code[] = { 0xA9, marker, 0x8F, 0x00, 0x01, 0x7E, 0x80, 0xF8 };
+                std::vector<uint8_t> bytes(0x800, 0x00);
+                std::copy(std::begin(code), std::end(code), bytes.begin());
+                std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+            };
+            writeSave("sram_exec_first.srm", 0x11);
+            writeSave("sram_exec_second.srm", 0x22);
+
+            std::vector<uint8_t> rom(0x8000, 0xEA);
+            const uint8_t jump[] = { 0x5C, 0x00, 0x00, 0x70 };	// JML $700000
+            std::copy(std::begin(jump), std::end(jump), rom.begin());
+            System system;
+            system.loadRom(rom);
+            system.init();
+
+            ASSERT_TRUE(system.loadSram("sram_exec_first.srm", 0x800));
+            system.runFrame(false);
+            EXPECT_EQ(system.peek(0x7E0100), 0x11);
+
+            // The CPU is inside the old mapping when it is replaced
+            ASSERT_TRUE(system.loadSram("sram_exec_second.srm", 0x800));
+            system.runFrame(false);
+            EXPECT_EQ(system.peek(0x7E0100), 0x22);
+
+            system.loadSram("missing_directory/save.srm", 0x800);
+            system.runFrame(false);
+
+            std::remove("sram_exec_first.srm");
+            std::remove("sram_exec_second.srm");
+        }
+        TEST(SramTest, SpeculationLeavesTheSaveFileAlone)
+        {
+            std::string path = "sram_speculate_test.srm";
+            SRAM sram;
+            ASSERT_TRUE(sram.open(path, 0x800));
+            sram.write(0x10, 0x11);
+            ASSERT_TRUE(sram.flush(true));
+
+            std::vector<uint8_t> scratch(sram.size());
+            sram.speculate(scratch.data());
+            sram.write(0x10, 0x22);
+            EXPECT_EQ(sram.read(0x10), 0x22);
+            EXPECT_EQ(sram.dirtyPages(), 0u);
+            {
+                std::ifstream file(path, std::ios::binary);
+                std::vector<uint8_t> saved((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                ASSERT_GT(saved.size(), 0x10u);
+                EXPECT_EQ(saved[0x10], 0x11);
+            }
+
+            sram.endSpeculation();
+            EXPECT_EQ(sram.read(0x10), 0x11);
+            EXPECT_EQ(sram.dirtyPages(), 0u);
+
+            sram.close();
+            std::remove(path.c_str());
+        }
+        TEST(SramTest, ReadsZeroBeforeOpen)
+        {
+            SRAM sram;
+            EXPECT_EQ(sram.read(0x10), 0x00);
+            sram.write(0x10, 0x42);
+            EXPECT_EQ(sram.size(), 0u);
+        }
+        TEST(SramTest, FallsBackToMemoryWhenFileCannotOpen)
+        {
+            SRAM sram;
+            EXPECT_FALSE(sram.open("missing_directory/save.srm", 0x800));
+            EXPECT_FALSE(sram.persistent());
+            sram.write(0x10, 0x42);
+            EXPECT_EQ(sram.read(0x10), 0x42);
+        }
+    }
+}
@@ -0,0 +1,238 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "src/system.h"
+#include "src/metrics.h"
+#include "src/profiler.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace Metrics_Tests
+{
+    void Boot(System& system)
+    {
+        std::vector<uint8_t> rom(0x8000, 0xEA);
+        const std::vector<uint8_t> program = {
+            0xAF, 0x00, 0x01, 0x7E,   // LDA $7E0100
+            0x8F, 0x00, 0x21, 0x00,   // STA INIDISP
+            0x80, 0xF6                // BRA start
+        };
+        std::copy(program.begin(), program.end(), rom.begin());
+        system.loadRom(rom);
+        system.init();
+    }
+
+    TEST(LatencyHistogramTest, PercentilesStayWithinBucketPrecision)
+    {
+        LatencyHistogram histogram;
+        for (uint64_t value = 1; value <= 10000; ++value)
+            histogram.record(value * 1000);
+
+        EXPECT_EQ(histogram.count(), 10000u);
+        EXPECT_NEAR(double(histogram.percentile(0.5)), 5000000.0, 5000000.0 * 0.016);
+        EXPECT_NEAR(double(histogram.percentile(0.99)), 9900000.0, 9900000.0 * 0.016);
+        EXPECT_EQ(histogram.percentile(1.0), 10000000u);
+    }
+
+    TEST(LatencyHistogramTest, BucketsCoverTheWholeRange)
+    {
+        EXPECT_EQ(LatencyHistogram::bucketOf(0), 0u);
+        EXPECT_EQ(LatencyHistogram::bucketOf(127), 127u);
+        EXPECT_EQ(LatencyHistogram::bucketOf(~uint64_t(0)), LatencyHistogram::BUCKETS - 1);
+        for (size_t bucket = 1; bucket < LatencyHistogram::BUCKETS; ++bucket)
+        {
+            ASSERT_EQ(LatencyHistogram::bucketOf(LatencyHistogram::highestIn(bucket)), bucket);
+            ASSERT_EQ(LatencyHistogram::bucketOf(LatencyHistogram::highestIn(bucket - 1) + 1), bucket);
+        }
+    }
+
+    TEST(MetricsTest, SystemPublishesCountersPerFrame)
+    {
+        System system;
+        Boot(system);
+        for (int i = 0; i < 4; ++i)
+            system.runFrame(false);
+
+        MetricsSnapshot snapshot;
+        system.metrics().snapshot(snapshot);
+
+        EXPECT_EQ(snapshot.counters.frames, 4u);
+        EXPECT_EQ(snapshot.counters.cycles, system.cycles());
+        EXPECT_GT(snapshot.counters.instructions, 0u);
+        EXPECT_GT(snapshot.counters.handlerReads, 0u);
+        EXPECT_GT(snapshot.counters.ioAccesses, 0u);
+        EXPECT_EQ(snapshot.frameTimes.count(), 4u);
+        EXPECT_GT(snapshot.mips(), 0.0);
+        // The loop runs from ROM through the code window; only the data read goes through a handler
+        EXPECT_GT(snapshot.fastPathRatio(), 0.8);
+    }
+
+    TEST(MetricsTest, SnapshotsAreConsistentWhileFramesRun)
+    {
+        System system;
+        Boot(system);
+        std::atomic<bool> done(false);
+        std::thread emulation([&]
+        {
+            for (int i = 0; i < 30; ++i)
+                system.runFrame(false);
+            done = true;
+        });
+
+        uint64_t lastFrames = 0;
+        while (!done)
+        {
+            MetricsSnapshot snapshot;
+            system.metrics().snapshot(snapshot);
+            // Cycles and frames come from the same publish
+            EXPECT_GE(snapshot.counters.cycles, snapshot.counters.frames * 357368);
+            EXPECT_GE(snapshot.counters.frames, lastFrames);
+            lastFrames = snapshot.counters.frames;
+        }
+        emulation.join();
+    }
+
+    TEST(MetricsDumperTest, WritesSnapshotToFile)
+    {
+        System system;
+        Boot(system);
+        system.runFrame(false);
+        std::string path = "metrics_dump_test.txt";
+
+        MetricsDumper dumper(system.metrics(), MetricsDumper::Target::File, path);
+        ASSERT_TRUE(dumper.dumpOnce());
+
+        std::ifstream in(path);
+        std::stringstream text;
+        text << in.rdbuf();
+        in.close();
+        std::remove(path.c_str());
+        EXPECT_NE(text.str().find("frames          1\n"), std::string::npos);
+        EXPECT_NE(text.str().find("frame_ns_p99"), std::string::npos);
+    }
+
+#ifndef _WIN32
+    TEST(MetricsDumperTest, SendsSnapshotToUnixSocket)
+    {
+        System system;
+        Boot(system);
+        system.runFrame(false);
+        std::string path = "metrics_dump_test.sock";
+        ::unlink(path.c_str());
+
+        int listener = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+        ASSERT_GE(listener, 0);
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        std::copy(path.begin(), path.end(), address.sun_path);
+        ASSERT_EQ(::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+
+        MetricsDumper dumper(system.metrics(), MetricsDumper::Target::Socket, path);
+        dumper.start(5);
+        char buffer[1024] = {};
+        ssize_t received = ::recv(listener, buffer, sizeof(buffer) - 1, 0);
+        dumper.stop();
+        ::close(listener);
+        ::unlink(path.c_str());
+
+        ASSERT_GT(received, 0);
+        EXPECT_NE(std::string(buffer).find("instructions"), std::string::npos);
+    }
+#endif
+
+    // Counters advance by a fixed step on every sample, so charges are predictable
+    class SteppingProfiler : public PhaseProfiler
+    {
+    public:
+        SteppingProfiler() { enabled = true; reset(); }
+        uint64_t clock = 0;
+        uint64_t step = 0;
+    protected:
+        void sample(uint64_t* values) override
+        {
+            clock += step;
+            for (size_t i = 0; i < CounterCount; ++i)
+                values[i] = clock;
+        }
+    };
+
+    TEST(PhaseProfilerTest, InnerPhaseIsNotChargedToOuter)
+    {
+        SteppingProfiler profiler;
+        profiler.enter(ProfilePhase::CpuDispatch);
+        profiler.clock = 10;
+        profiler.enter(ProfilePhase::MemoryMap);
+        profiler.clock = 13;
+        profiler.exit();
+        profiler.clock = 20;
+        profiler.exit();
+        profiler.clock = 50;	// Outside any phase
+        profiler.enter(ProfilePhase::Render);
+        profiler.exit();
+
+        EXPECT_EQ(profiler.count(ProfilePhase::CpuDispatch, PhaseProfiler::Cycles), 17u);
+        EXPECT_EQ(profiler.count(ProfilePhase::MemoryMap, PhaseProfiler::Cycles), 3u);
+        EXPECT_EQ(profiler.count(ProfilePhase::Render, PhaseProfiler::Cycles), 0u);
+        EXPECT_EQ(profiler.entries(ProfilePhase::MemoryMap), 1u);
+    }
+
+    TEST(PhaseProfilerTest, SampledPhaseIsScaled)
+    {
+        SteppingProfiler profiler;
+        profiler.enter(ProfilePhase::CpuDispatch);
+        for (int i = 0; i < 4; ++i)
+        {
+            profiler.clock += 5;
+            PhaseProfiler::Scope memory(&profiler, ProfilePhase::MemoryMap, 2);
+            profiler.clock += 3;
+        }
+        profiler.exit();
+
+        // Every other access is measured; the estimate matches what all four cost
+        EXPECT_EQ(profiler.count(ProfilePhase::MemoryMap, PhaseProfiler::Cycles), 12u);
+        EXPECT_EQ(profiler.count(ProfilePhase::CpuDispatch, PhaseProfiler::Cycles), 20u);
+        EXPECT_EQ(profiler.entries(ProfilePhase::MemoryMap), 4u);
+    }
+
+    TEST(PhaseProfilerTest, SystemBracketsEveryPhase)
+    {
+        System system;
+        Boot(system);
+        SteppingProfiler profiler;
+        profiler.step = 1;
+        system.attachProfiler(&profiler);
+        system.runFrame();
+        system.attachProfiler(nullptr);
+
+        EXPECT_EQ(profiler.entries(ProfilePhase::Render), uint64_t(PPU::HEIGHT));
+        EXPECT_EQ(profiler.entries(ProfilePhase::Audio), 1u);
+        EXPECT_GT(profiler.entries(ProfilePhase::CpuDispatch), 0u);
+        EXPECT_GT(profiler.entries(ProfilePhase::MemoryMap), 0u);
+        EXPECT_GT(profiler.count(ProfilePhase::MemoryMap, PhaseProfiler::Instructions), 0u);
+        EXPECT_NE(profiler.report().find("memory map"), std::string::npos);
+    }
+
+    TEST(PhaseProfilerTest, HardwareCountersWhenAvailable)
+    {
+        PhaseProfiler profiler;
+        if (!profiler.open())
+        {
+            // No perf access here (non-Linux, container or perf_event_paranoid)
+            EXPECT_FALSE(profiler.active());
+            return;
+        }
+        System system;
+        Boot(system);
+        system.attachProfiler(&profiler);
+        system.runFrame(false);
+        system.attachProfiler(nullptr);
+
+        EXPECT_GT(profiler.count(ProfilePhase::CpuDispatch, PhaseProfiler::Instructions), 0u);
+    }
+}
@@ -1,28 +1,14 @@
 #include "pch.h"
 #include "gtest/gtest.h"
-#include "src/cpu.h"
-#include "src/memory.h"
+#include "CpuTestFixture.h"
 
 
-class CPUOpcodeTest : public ::testing::Test
+class CPUOpcodeTest : public CpuTest
 {
 protected:
-    std::unique_ptr<Memory> memory;
-    CPU cpu;
-
-    void LoadProgram(const std::vector<uint8_t>& program)
-    {
-        memory->loadProgram(program);
-    }
-
     void SetUp() override
     {
-        memory = std::make_unique<Memory>();
-        memory->init();
-        cpu.memory = &memory.get()->map;
-        cpu.registers.PC = 0x008000;
-        cpu.registers.DBR = 0x7E;
-        cpu.running = true;
+        CpuTest::SetUp();
         register_opcodes(cpu);
     }
 };
@@ -914,4 +900,59 @@ namespace OpCode_Tests
             EXPECT_EQ(memory->wram.read(0xEEAA), 0x99); // LDA ($20),Y  expect A = 0x99
         }
     }
+    namespace Jump_Tests
+    {
+        TEST_F(CPUOpcodeTest, JSL_RTL_CallsIntoAnotherBank)
+        {
+            // $7E:1000 LDA #$5A / RTL
+            memory->wram.write(0x1000, 0xA9);
+            memory->wram.write(0x1001, 0x5A);
+            memory->wram.write(0x1002, 0x6B);
+            cpu.registers.S = 0x01FF;
+            LoadProgram({
+                0x22, 0x00, 0x10, 0x7E, // JSL $7E1000
+                0x8F, 0x20, 0x00, 0x7E, // STA $7E0020
+                0x00
+                });
+
+            cpu.run();
+
+            EXPECT_EQ(memory->wram.read(0x0020), 0x5A);
+            EXPECT_EQ(cpu.registers.PBR, 0x00);
+            EXPECT_EQ(cpu.registers.PC, 0x8009);
+            EXPECT_EQ(cpu.registers.S, 0x01FF);
+        }
+        TEST_F(CPUOpcodeTest, JML_FetchesFromNewBank)
+        {
+            memory->wram.write(0x2000, 0xA9);
+            memory->wram.write(0x2001, 0x33);
+            memory->wram.write(0x2002, 0x00);
+            LoadProgram({
+                0x5C, 0x00, 0x20, 0x7E, // JML $7E2000
+                0x00
+                });
+
+            cpu.run();
+
+            EXPECT_EQ(cpu.registers.A, 0x33);
+            EXPECT_EQ(cpu.registers.PBR, 0x7E);
+            EXPECT_EQ(cpu.registers.PC, 0x2003);
+        }
+        TEST_F(CPUOpcodeTest, ModifiedCodeInRamIsFetched)
+        {
+            memory->wram.write(0x3000, 0xA9);
+            memory->wram.write(0x3001, 0x11);
+            memory->wram.write(0x3002, 0x00);
+            LoadProgram({ 0x5C, 0x00, 0x30, 0x7E, 0x00 });
+            cpu.run();
+            EXPECT_EQ(cpu.registers.A, 0x11);
+
+            // The fetch window points at WRAM, so a store to the operand is seen on the next run
+            cpu.memory->write(0x7E3001, 0x22);
+            cpu.registers.PC = 0x3000;
+            cpu.running = true;
+            cpu.run();
+            EXPECT_EQ(cpu.registers.A, 0x22);
+        }
+    }
 }
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "src/post_process.h"
+#include "src/ppu.h"
+#include <chrono>
+#include <thread>
+
+namespace PostProcess_Tests
+{
+    std::vector<uint16_t> Frame(uint16_t color)
+    {
+        return std::vector<uint16_t>(PPU::WIDTH * PPU::HEIGHT, color);
+    }
+
+    TEST(BandPoolTest, RunsEveryBandOnce)
+    {
+        BandPool pool(4);
+        std::vector<std::atomic<int>> hits(100);
+        for (int round = 0; round < 50; ++round)
+        {
+            pool.run(hits.size(), [](void* ctx, size_t band)
+            {
+                (*static_cast<std::vector<std::atomic<int>>*>(ctx))[band]++;
+            }, &hits);
+        }
+        for (auto& count : hits)
+            EXPECT_EQ(count.load(), 50);
+    }
+
+    TEST(PostProcessTest, ScaleReplicatesPixels)
+    {
+        PostSettings settings;
+        settings.scale = 3;
+        PostProcessor post(settings);
+        std::vector<uint16_t> in = Frame(0x0000);
+        in[PPU::WIDTH + 1] = 0x7FFF;
+        in[PPU::WIDTH + 2] = 0x001F;
+
+        PostFrame out;
+        post.process(in.data(), out);
+
+        ASSERT_EQ(out.width, PPU::WIDTH * 3);
+        ASSERT_EQ(out.height, PPU::HEIGHT * 3);
+        for (uint32_t y = 3; y < 6; ++y)
+        {
+            for (uint32_t x = 3; x < 6; ++x)
+                EXPECT_EQ(out.pixels[y * out.width + x], 0xFFFFFFu);
+            EXPECT_EQ(out.pixels[y * out.width + 6], 0xFF0000u);
+            EXPECT_EQ(out.pixels[y * out.width + 2], 0x000000u);
+        }
+    }
+
+    TEST(PostProcessTest, BandsMatchOneThreadForEveryFilter)
+    {
+        std::vector<uint16_t> in(PPU::WIDTH * PPU::HEIGHT);
+        for (size_t i = 0; i < in.size(); ++i)
+            in[i] = uint16_t((i * 2654435761u >> 7) & 0x7FFF);
+
+        const PostFilter filters[] = { PostFilter::Scale, PostFilter::Ntsc, PostFilter::Xbr };
+        for (PostFilter filter : filters)
+        {
+            PostSettings single;
+            single.filter = filter;
+            single.threads = 1;
+            single.bandRows = PPU::HEIGHT;
+            PostSettings banded = single;
+            banded.threads = 4;
+            banded.bandRows = 7;
+
+            PostFrame a, b;
+            PostProcessor(single).process(in.data(), a);
+            PostProcessor(banded).process(in.data(), b);
+            EXPECT_EQ(a.pixels, b.pixels) << "filter " << int(filter);
+        }
+    }
+
+    TEST(PostProcessTest, XbrSmoothsDiagonalsAndKeepsFlatAreas)
+    {
+        PostSettings settings;
+        settings.filter = PostFilter::Xbr;
+        PostProcessor post(settings);
+
+        // White below the diagonal, black above
+        std::vector<uint16_t> in = Frame(0x0000);
+        for (uint32_t y = 0; y < PPU::HEIGHT; ++y)
+            for (uint32_t x = 0; x <= y && x < PPU::WIDTH; ++x)
+                in[y * PPU::WIDTH + x] = 0x7FFF;
+
+        PostFrame out;
+        post.process(in.data(), out);
+
+        // The black pixel right of the step gets its lower left corner blended
+        uint32_t x = 11, y = 10;
+        EXPECT_EQ(out.pixels[(y * 2 + 1) * out.width + x * 2], 0x7F7F7Fu);
+        EXPECT_EQ(out.pixels[(y * 2) * out.width + x * 2 + 1], 0x000000u);
+        EXPECT_EQ(out.pixels[(100 * 2) * out.width + 200 * 2], 0x000000u);
+        EXPECT_EQ(out.pixels[(200 * 2) * out.width + 20 * 2], 0xFFFFFFu);
+    }
+
+    TEST(PostProcessTest, NtscDimsScanlinesAndBleedsChroma)
+    {
+        PostSettings settings;
+        settings.filter = PostFilter::Ntsc;
+        PostProcessor post(settings);
+        std::vector<uint16_t> in = Frame(0x0000);
+        for (uint32_t y = 0; y < PPU::HEIGHT; ++y)
+            in[y * PPU::WIDTH + 100] = 0x001F;
+
+        PostFrame out;
+        post.process(in.data(), out);
+
+        uint32_t bright = out.pixels[100 * 2];
+        uint32_t dim = out.pixels[out.width + 100 * 2];
+        EXPECT_GT(bright >> 16, dim >> 16);
+        EXPECT_GT(out.pixels[102 * 2] >> 16 & 0xFF, 0u);  // Red bleeds two pixels out
+        EXPECT_EQ(out.pixels[104 * 2], 0x000000u);
+    }
+
+    TEST(PostProcessTest, PipelineFiltersSubmittedFramesInBackground)
+    {
+        PostSettings settings;
+        settings.threads = 3;
+        PostProcessor post(settings);
+        post.start();
+
+        std::vector<uint16_t> in = Frame(0x0000);
+        for (uint64_t number = 1; number <= 20; ++number)
+        {
+            std::fill(in.begin(), in.end(), uint16_t(number));
+            post.submit(in.data(), number);
+        }
+
+        bool done = false;
+        auto giveUp = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!done && std::chrono::steady_clock::now() < giveUp)
+        {
+            if (post.poll())
+                done = post.frame().number == 20;
+            else
+                std::this_thread::yield();
+        }
+        post.stop();
+
+        ASSERT_TRUE(done);
+        EXPECT_EQ(post.frame().pixels[0], uint32_t((20 << 3) | (20 >> 2)) << 16);
+        EXPECT_GE(post.framesProcessed(), 1u);
+    }
+}
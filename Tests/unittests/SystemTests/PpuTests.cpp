@@ -0,0 +1,501 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "src/ppu.h"
+#include "src/mode7.h"
+#include "src/color_math.h"
+#include "src/dma.h"
+#include "src/bus.h"
+#include "src/cpu.h"
+#include <random>
+
+class Mode7Test : public ::testing::Test
+{
+protected:
+    Bus bus;
+    PPU ppu;
+
+    void SetUp() override
+    {
+        ppu.attach(bus.io);
+        Write(0x2100, 0x0F);    // Display on, full brightness
+        Write(0x2105, 0x07);
+        Write(0x212C, 0x01);
+        ppu.cgram[0] = 0x1111;
+        for (uint16_t i = 1; i < 256; ++i)
+            ppu.cgram[i] = i;
+    }
+
+    void Write(uint16_t address, uint8_t value)
+    {
+        bus.map.write(address, value);
+    }
+
+    void WriteMode7(uint16_t address, uint16_t value)
+    {
+        Write(address, uint8_t(value));
+        Write(address, uint8_t(value >> 8));
+    }
+
+    // Map entry and one row of a tile's pixels
+    void PlaceTile(uint8_t column, uint8_t row, uint8_t tile)
+    {
+        uint16_t& entry = ppu.vram[row * 128 + column];
+        entry = uint16_t((entry & 0xFF00) | tile);
+    }
+    void SetPixel(uint8_t tile, uint8_t x, uint8_t y, uint8_t color)
+    {
+        uint16_t& word = ppu.vram[(tile << 6) | (y << 3) | x];
+        word = uint16_t((color << 8) | (word & 0x00FF));
+    }
+
+    void Identity()
+    {
+        WriteMode7(0x211B, 0x0100);
+        WriteMode7(0x211C, 0x0000);
+        WriteMode7(0x211D, 0x0000);
+        WriteMode7(0x211E, 0x0100);
+    }
+};
+
+class SpriteTest : public Mode7Test
+{
+protected:
+    void SetUp() override
+    {
+        Mode7Test::SetUp();
+        Write(0x2105, 0x00);
+        Write(0x212C, 0x10);
+        // Park every sprite below the screen
+        for (uint32_t i = 0; i < 128; ++i)
+            SetSprite(i, 0, 0xF0, 0, 0);
+    }
+
+    void SetSprite(uint32_t index, int32_t x, uint8_t y, uint8_t tile, uint8_t attributes, bool large = false)
+    {
+        Write(0x2102, uint8_t(index * 2));
+        Write(0x2103, 0x00);
+        Write(0x2104, uint8_t(x));
+        Write(0x2104, y);
+        Write(0x2104, tile);
+        Write(0x2104, attributes);
+
+        // High table bytes are written one at a time from the word address
+        uint32_t slot = index / 4;
+        uint32_t shift = (index & 3) * 2;
+        uint8_t high = uint8_t((ppu.oam[0x200 + slot] & ~(3 << shift)) | ((((x >> 8) & 1) | (large ? 2 : 0)) << shift));
+        Write(0x2102, uint8_t(slot / 2));
+        Write(0x2103, 0x01);
+        if (slot & 1)
+            Write(0x2104, ppu.oam[0x200 + slot - 1]);
+        Write(0x2104, high);
+    }
+
+    uint8_t Status()
+    {
+        return bus.map.read(0x213E);
+    }
+};
+
+namespace Ppu_Tests
+{
+    TEST(Mode7EvaluateTest, SimdMatchesScalar)
+    {
+        std::vector<uint16_t> vram(0x8000);
+        std::mt19937 random(7);
+        for (auto& word : vram)
+            word = uint16_t(random());
+
+        std::vector<uint8_t> simd(256), scalar(256);
+        PpuLatches regs = {};
+        for (int i = 0; i < 500; ++i)
+        {
+            regs.m7a = uint16_t(random());
+            regs.m7b = uint16_t(random());
+            regs.m7c = uint16_t(random());
+            regs.m7d = uint16_t(random());
+            regs.m7x = uint16_t(random() & 0x1FFF);
+            regs.m7y = uint16_t(random() & 0x1FFF);
+            regs.m7hofs = uint16_t(random() & 0x1FFF);
+            regs.m7vofs = uint16_t(random() & 0x1FFF);
+            regs.m7sel = uint8_t(random() & 0xC3);
+
+            mode7::Line line = mode7::setup(regs, 1 + i % 224);
+            mode7::evaluate(line, vram.data(), simd.data(), simd.size());
+            mode7::evaluateScalar(line, vram.data(), scalar.data(), scalar.size());
+            ASSERT_EQ(simd, scalar) << "case " << i;
+        }
+    }
+
+    TEST_F(Mode7Test, IdentityMatrixShowsTheMap)
+    {
+        Identity();
+        PlaceTile(1, 0, 2);
+        SetPixel(2, 3, 1, 0x42);    // Line 0 is hardware line 1, tile row 1
+
+        ppu.renderScanline(0);
+
+        EXPECT_EQ(ppu.framebuffer[8 + 3], 0x0042);
+        EXPECT_EQ(ppu.framebuffer[8 + 4], 0x1111);
+        EXPECT_EQ(ppu.framebuffer[3], 0x1111);
+    }
+
+    TEST_F(Mode7Test, ScrollAndFlipMoveThePlayfield)
+    {
+        Identity();
+        PlaceTile(1, 0, 2);
+        SetPixel(2, 3, 1, 0x42);
+        WriteMode7(0x210D, 8);
+
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[3], 0x0042);
+
+        WriteMode7(0x210D, 0);
+        Write(0x211A, 0x01);    // H flip: screen x maps to 255 - x
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[255 - 11], 0x0042);
+    }
+
+    TEST_F(Mode7Test, ScreenOverSelectsTransparentOrTileZero)
+    {
+        Identity();
+        SetPixel(0, 0, 1, 0x21);
+        WriteMode7(0x210D, uint16_t(-8 & 0x1FFF));    // First eight pixels fall left of the field
+
+        Write(0x211A, 0x00);
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[0], 0x0021);    // Wraps to tile 0 at the right edge
+
+        Write(0x211A, 0x80);
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[0], 0x1111);
+
+        PlaceTile(127, 0, 5);
+        Write(0x211A, 0xC0);
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[0], 0x0021);    // Tile 0, not the wrapped map entry
+    }
+
+    TEST_F(Mode7Test, ExtbgUsesBitSevenAsPriority)
+    {
+        Identity();
+        SetPixel(0, 0, 1, 0x85);
+        SetPixel(0, 1, 1, 0x06);
+        Write(0x2133, 0x40);
+
+        Write(0x212C, 0x02);
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[0], 0x0005);
+        EXPECT_EQ(ppu.framebuffer[1], 0x0006);
+
+        Write(0x212C, 0x03);    // BG1 covers low priority BG2 only
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[0], 0x0005);
+        EXPECT_EQ(ppu.framebuffer[1], 0x0006);
+        SetPixel(0, 0, 1, 0x05);
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[0], 0x0005);
+    }
+
+    TEST_F(Mode7Test, MultiplierReadsSignedProduct)
+    {
+        WriteMode7(0x211B, uint16_t(-300));
+        WriteMode7(0x211C, 0x0500);
+
+        int32_t product = int32_t(bus.map.read(0x2134)) | (bus.map.read(0x2135) << 8) | (bus.map.read(0x2136) << 16);
+        EXPECT_EQ(product, -1500 & 0xFFFFFF);
+    }
+
+    TEST_F(Mode7Test, HdmaChangesTheMatrixPerLine)
+    {
+        CPU cpu;
+        DmaController dma;
+        dma.attach(cpu, bus.io, bus.map);
+
+        // Two lines of M7A = $0100, then one line of $0200, then end
+        const uint8_t table[] = { 0x02, 0x00, 0x01, 0x01, 0x00, 0x02, 0x00 };
+        for (size_t i = 0; i < sizeof(table); ++i)
+            bus.map.write(0x7E2000 + uint32_t(i), table[i]);
+        Write(0x4300, 0x02);    // Write-twice to one register
+        Write(0x4301, 0x1B);
+        Write(0x4302, 0x00);
+        Write(0x4303, 0x20);
+        Write(0x4304, 0x7E);
+        Write(0x420C, 0x01);
+
+        dma.startFrame();
+        dma.hblank();
+        EXPECT_EQ(ppu.regs.m7a, 0x0100);
+        dma.hblank();
+        EXPECT_EQ(ppu.regs.m7a, 0x0100);
+        dma.hblank();
+        EXPECT_EQ(ppu.regs.m7a, 0x0200);
+        Write(0x211B, 0x34);    // Ended: no further writes
+        Write(0x211B, 0x12);
+        dma.hblank();
+        EXPECT_EQ(ppu.regs.m7a, 0x1234);
+    }
+
+    TEST_F(Mode7Test, GeneralDmaFillsVram)
+    {
+        CPU cpu;
+        DmaController dma;
+        dma.attach(cpu, bus.io, bus.map);
+        for (uint32_t i = 0; i < 8; ++i)
+            bus.map.write(0x7E1000 + i, uint8_t(0x10 + i));
+
+        Write(0x2115, 0x80);
+        Write(0x2116, 0x00);
+        Write(0x2117, 0x04);
+        Write(0x4310, 0x01);    // Alternate VMDATAL/VMDATAH
+        Write(0x4311, 0x18);
+        Write(0x4312, 0x00);
+        Write(0x4313, 0x10);
+        Write(0x4314, 0x7E);
+        Write(0x4315, 0x08);
+        Write(0x4316, 0x00);
+        uint64_t before = cpu.cycles;
+        Write(0x420B, 0x02);
+
+        EXPECT_EQ(ppu.vram[0x400], 0x1110);
+        EXPECT_EQ(ppu.vram[0x403], 0x1716);
+        EXPECT_EQ(bus.map.read(0x4315), 0x00);
+        EXPECT_GT(cpu.cycles, before);
+    }
+
+    TEST_F(SpriteTest, DrawsOverBackdropWithFlip)
+    {
+        ppu.vram[0] = 0x0080;    // Tile 0, row 0: leftmost pixel color 1
+        SetSprite(0, 10, 0, 0, 0x02);    // Palette 1
+
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[10], 0x0091);
+        EXPECT_EQ(ppu.framebuffer[11], 0x1111);
+
+        SetSprite(0, 10, 0, 0, 0x42);
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[17], 0x0091);
+        EXPECT_EQ(ppu.framebuffer[10], 0x1111);
+    }
+
+    TEST_F(SpriteTest, LowerIndexWinsOverlap)
+    {
+        ppu.vram[0] = 0x0080;
+        ppu.vram[16] = 0x8000;    // Tile 1: leftmost pixel color 2
+        SetSprite(5, 20, 0, 1, 0x00);
+        SetSprite(6, 20, 0, 0, 0x30);
+
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[20], 0x0082);
+    }
+
+    TEST_F(SpriteTest, RangeOverPastThirtyTwoSprites)
+    {
+        for (uint32_t i = 0; i < 32; ++i)
+            SetSprite(i, int32_t(i * 8), 4, 0, 0);
+        ppu.startFrame();
+        ppu.evaluateSprites(4);
+        EXPECT_EQ(Status() & 0xC0, 0x00);
+
+        SetSprite(40, 0, 0, 0, 0);
+        ppu.evaluateSprites(4);
+        EXPECT_EQ(Status() & 0xC0, 0x40);
+
+        ppu.startFrame();
+        EXPECT_EQ(Status(), 0x01);
+    }
+
+    TEST_F(SpriteTest, TimeOverPastThirtyFourSlivers)
+    {
+        Write(0x2101, 0x60);    // 16x16 small sprites
+        for (uint32_t i = 0; i < 17; ++i)
+            SetSprite(i, int32_t(i * 15), 0, 0, 0);
+        SetSprite(17, 250, 0, 0, 0);    // Second sliver is off screen and not fetched
+        ppu.startFrame();
+        ppu.evaluateSprites(10);
+        EXPECT_EQ(Status() & 0xC0, 0x80);
+
+        SetSprite(16, -16, 0, 0, 0);    // Entirely off screen: out of range
+        ppu.startFrame();
+        ppu.evaluateSprites(10);
+        EXPECT_EQ(Status() & 0xC0, 0x00);
+    }
+
+    TEST_F(SpriteTest, XMinus256CountsForRangeOnly)
+    {
+        ppu.vram[0] = 0x0080;
+        for (uint32_t i = 0; i < 32; ++i)
+            SetSprite(i, -256, 0, 0, 0);
+        SetSprite(32, 40, 0, 0, 0);
+
+        ppu.startFrame();
+        ppu.renderScanline(0);
+
+        EXPECT_EQ(Status() & 0xC0, 0x40);
+        EXPECT_EQ(ppu.framebuffer[40], 0x1111);
+        EXPECT_EQ(ppu.framebuffer[0], 0x1111);
+    }
+
+    TEST_F(SpriteTest, PriorityRotationChangesWhichSpritesFit)
+    {
+        ppu.vram[0] = 0x0080;
+        for (uint32_t i = 0; i < 33; ++i)
+            SetSprite(i, 0, 0, 0, 0);
+        SetSprite(40, 100, 0, 0, 0);
+
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[100], 0x1111);
+
+        Write(0x2102, 40 * 2);
+        Write(0x2103, 0x80);
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[100], 0x0081);
+    }
+
+    TEST_F(SpriteTest, IncrementalListsMatchFullScan)
+    {
+        std::mt19937 random(11);
+        Write(0x2101, uint8_t(0x20 * (random() % 8)));
+        SpriteEvaluator::Line line;
+
+        for (int step = 0; step < 400; ++step)
+        {
+            uint32_t index = random() % 128;
+            SetSprite(index, int32_t(random() % 512) - 256, uint8_t(random()), 0, 0, (random() & 1) != 0);
+            if (step % 50 == 0)
+                Write(0x2101, uint8_t(0x20 * (random() % 8)));
+
+            uint32_t row = random() % 224;
+            ppu.startFrame();
+            ppu.evaluateSprites(row);
+            uint8_t flags = Status() & 0xC0;
+
+            // Reference: scan all 128 entries
+            size_t inRange = 0;
+            for (uint32_t i = 0; i < 128; ++i)
+            {
+                uint8_t high = uint8_t(ppu.oam[0x200 + i / 4] >> ((i & 3) * 2));
+                int32_t x = ppu.oam[i * 4] | ((high & 1) << 8);
+                x = x >= 256 ? x - 512 : x;
+                SpriteSize size = SPRITE_SIZES[ppu.regs.obsel >> 5][(high >> 1) & 1];
+                bool onLine = ((row - ppu.oam[i * 4 + 1]) & 0xFF) < size.height;
+                if (onLine && ((x > -size.width && x < 256) || x == -256))
+                    ++inRange;
+            }
+            ASSERT_EQ(flags & 0x40, inRange > 32 ? 0x40 : 0x00) << "step " << step;
+        }
+    }
+
+    TEST(ColorMathTest, SimdMatchesScalar)
+    {
+        std::mt19937 random(11);
+        std::vector<uint16_t> main(256), sub(256), simd(256), scalar(256);
+        for (int i = 0; i < 200; ++i)
+        {
+            for (size_t x = 0; x < 256; ++x)
+            {
+                main[x] = uint16_t(random() & 0x7FFF);
+                sub[x] = uint16_t(random() & 0x7FFF);
+            }
+            colormath::Line line;
+            line.main = main.data();
+            line.sub = sub.data();
+            for (size_t word = 0; word < 4; ++word)
+            {
+                line.clip[word] = uint64_t(random()) << 32 | random();
+                line.math[word] = uint64_t(random()) << 32 | random();
+                line.half[word] = uint64_t(random()) << 32 | random();
+            }
+            line.subtract = (i & 1) != 0;
+            line.brightness = uint8_t(random() & 0x0F);
+
+            colormath::blend(line, simd.data());
+            colormath::blendScalar(line, scalar.data());
+            ASSERT_EQ(simd, scalar) << "iteration " << i;
+        }
+    }
+
+    TEST(ColorMathTest, WindowLogicCombinesRanges)
+    {
+        colormath::LineMask first = colormath::range(10, 100);
+        colormath::LineMask second = colormath::range(50, 200);
+
+        EXPECT_EQ(colormath::range(20, 10), colormath::none());
+        EXPECT_EQ(colormath::range(0, 255), colormath::all());
+        EXPECT_TRUE(colormath::test(first, 63) && colormath::test(first, 64));
+        EXPECT_FALSE(colormath::test(first, 9) || colormath::test(first, 101));
+
+        EXPECT_EQ(colormath::window(first, second, 0x00, 0), colormath::none());
+        EXPECT_EQ(colormath::window(first, second, 0x03, 0), ~first);
+        EXPECT_EQ(colormath::window(first, second, 0x0A, 0), colormath::range(10, 200));
+        EXPECT_EQ(colormath::window(first, second, 0x0A, 1), colormath::range(50, 100));
+        EXPECT_EQ(colormath::window(first, second, 0x0A, 2), colormath::range(10, 49) | colormath::range(101, 200));
+        EXPECT_EQ(colormath::window(first, second, 0x0A, 3), ~(colormath::range(10, 49) | colormath::range(101, 200)));
+    }
+
+    TEST_F(Mode7Test, BackdropAddsFixedColor)
+    {
+        ppu.cgram[0] = 0x0842;      // 2, 2, 2
+        Write(0x2132, 0xE4);        // Fixed color 4, 4, 4
+        Write(0x2131, 0x20);        // Math on the backdrop
+
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[0], 0x18C6);
+
+        Write(0x2131, 0x60);        // Add and halve
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[0], 0x0C63);
+
+        Write(0x2131, 0xA0);        // Subtract, clamped at zero
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[0], 0x0000);
+
+        Write(0x2132, 0x3F);        // Red only to 31: add saturates
+        Write(0x2131, 0x20);
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[0], 0x18DF);
+    }
+
+    TEST_F(Mode7Test, WindowsMaskLayersAndClipToBlack)
+    {
+        Identity();
+        for (uint8_t column = 0; column < 32; ++column)
+            PlaceTile(column, 0, 2);
+        for (uint8_t x = 0; x < 8; ++x)
+            SetPixel(2, x, 1, 0x42);
+        Write(0x2126, 10);          // Window 1 covers 10-19
+        Write(0x2127, 19);
+
+        Write(0x2123, 0x02);        // BG1 uses window 1, masked on the main screen
+        Write(0x212E, 0x01);
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[9], 0x0042);
+        EXPECT_EQ(ppu.framebuffer[10], 0x1111);
+        EXPECT_EQ(ppu.framebuffer[19], 0x1111);
+        EXPECT_EQ(ppu.framebuffer[20], 0x0042);
+
+        Write(0x212E, 0x00);
+        Write(0x2125, 0x30);        // Color window is window 1 inverted
+        Write(0x2130, 0x40);        // Clip to black outside it, which leaves 10-19 black
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[9], 0x0042);
+        EXPECT_EQ(ppu.framebuffer[10], 0x0000);
+        EXPECT_EQ(ppu.framebuffer[19], 0x0000);
+        EXPECT_EQ(ppu.framebuffer[20], 0x0042);
+    }
+
+    TEST_F(Mode7Test, SubScreenHalvesOnlyOverOpaquePixels)
+    {
+        Identity();
+        PlaceTile(1, 0, 2);
+        SetPixel(2, 3, 1, 0x08);
+        ppu.cgram[0] = 0x0842;
+        Write(0x212C, 0x00);        // BG1 on the sub screen only
+        Write(0x212D, 0x01);
+        Write(0x2130, 0x02);        // Add the sub screen
+        Write(0x2131, 0x60);        // Half, on the backdrop
+
+        ppu.renderScanline(0);
+        EXPECT_EQ(ppu.framebuffer[8 + 3], 0x0425);  // (2 + 8) / 2, 2 / 2, 2 / 2
+        EXPECT_EQ(ppu.framebuffer[8 + 4], 0x0842);  // Sub backdrop is the fixed color, not halved
+    }
+}
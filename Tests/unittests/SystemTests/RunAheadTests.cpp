@@ -0,0 +1,222 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "src/system.h"
+#include "src/profiler.h"
+
+
+class RunAheadTest : public ::testing::Test
+{
+protected:
+    std::vector<uint8_t> rom;
+
+    // Polls the pad in the NMI handler like a game would and shows it as the
+    // backdrop colour, so input reaches the screen one frame after it is set
+    void SetUp() override
+    {
+        rom.assign(0x8000, 0xEA);
+        const std::vector<uint8_t> program = {
+            0xA9, 0x0F, 0x8F, 0x00, 0x21, 0x00,   // INIDISP: full brightness
+            0xA9, 0x80, 0x8F, 0x00, 0x42, 0x00,   // NMITIMEN: enable NMI
+            0xA9, 0x00, 0x8F, 0x21, 0x21, 0x00,   // loop: CGADD 0
+            0xAF, 0x10, 0x00, 0x7E,               // LDA $7E0010
+            0x8F, 0x22, 0x21, 0x00,               // CGDATA low
+            0xA9, 0x00, 0x8F, 0x22, 0x21, 0x00,   // CGDATA high
+            0x80, 0xEA                            // BRA loop
+        };
+        const std::vector<uint8_t> nmi = {
+            0xAF, 0x18, 0x42, 0x00,               // LDA JOY1L
+            0x8F, 0x10, 0x00, 0x7E,               // STA $7E0010
+            0x5C, 0x0C, 0x80, 0x00                // JML loop
+        };
+        std::copy(program.begin(), program.end(), rom.begin());
+        std::copy(nmi.begin(), nmi.end(), rom.begin() + 0x1000);
+        rom[0x7FEA] = 0x00;
+        rom[0x7FEB] = 0x90;
+    }
+
+    void Boot(System& system)
+    {
+        system.loadRom(rom);
+        system.init();
+    }
+};
+
+using FastForwardTest = RunAheadTest;
+
+namespace RunAhead_Tests
+{
+    // Counts phase visits without reading hardware counters
+    class VisitCounter : public PhaseProfiler
+    {
+    public:
+        VisitCounter() { enabled = true; }
+    protected:
+        void sample(uint64_t* values) override
+        {
+            for (size_t i = 0; i < CounterCount; ++i)
+                values[i] = 0;
+        }
+    };
+
+    TEST_F(RunAheadTest, ShowsInputOneFrameEarlier)
+    {
+        System plain;
+        System ahead;
+        Boot(plain);
+        Boot(ahead);
+        ahead.setRunAhead(1);
+        for (int i = 0; i < 3; ++i)
+        {
+            plain.runFrame();
+            ahead.runFrame();
+        }
+        uint16_t idle = plain.framebuffer()[0];
+        ASSERT_EQ(ahead.framebuffer()[0], idle);
+
+        plain.setInput(0, ButtonA);
+        ahead.setInput(0, ButtonA);
+        plain.runFrame();
+        ahead.runFrame();
+
+        EXPECT_EQ(plain.framebuffer()[0], idle);
+        EXPECT_NE(ahead.framebuffer()[0], idle);
+
+        plain.runFrame();
+        EXPECT_EQ(plain.framebuffer(), ahead.framebuffer());
+    }
+
+    TEST_F(RunAheadTest, CommittedTimelineMatchesPlainRun)
+    {
+        System plain;
+        System ahead;
+        Boot(plain);
+        Boot(ahead);
+        ahead.setRunAhead(3);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            uint16_t buttons = (i & 2) ? ButtonB : ButtonStart;
+            plain.setInput(0, buttons);
+            ahead.setInput(0, buttons);
+            plain.runFrame();
+            ahead.runFrame();
+        }
+
+        EXPECT_EQ(ahead.frameCount(), plain.frameCount());
+        EXPECT_EQ(ahead.cycles(), plain.cycles());
+        EXPECT_EQ(ahead.saveState(), plain.saveState());
+        EXPECT_EQ(ahead.audioSamples().size(), plain.audioSamples().size());
+    }
+
+    TEST_F(RunAheadTest, ReportsExtraCost)
+    {
+        System system;
+        Boot(system);
+        system.setRunAhead(2);
+        for (int i = 0; i < 5; ++i)
+            system.runFrame();
+
+        const RunAheadStats& stats = system.runAheadStats();
+        EXPECT_EQ(stats.frames, 5u);
+        EXPECT_EQ(stats.aheadFrames, 10u);	// Two speculative frames behind every committed one
+
+        system.runFrame(false);
+        EXPECT_EQ(system.runAheadStats().frames, 5u);
+        EXPECT_EQ(system.runAheadStats().aheadFrames, 10u);
+    }
+
+    TEST_F(RunAheadTest, CartridgeRamKeepsOnlyCommittedWrites)
+    {
+        // The NMI handler also keeps the last three pads in cartridge RAM, newest at $700000,
+        // so any speculative frame that leaked would shift the history out of step
+        const std::vector<uint8_t> history = {
+            0xAF, 0x01, 0x00, 0x70, 0x8F, 0x02, 0x00, 0x70,   // $700002 = $700001
+            0xAF, 0x00, 0x00, 0x70, 0x8F, 0x01, 0x00, 0x70,   // $700001 = $700000
+            0xAF, 0x18, 0x42, 0x00, 0x8F, 0x00, 0x00, 0x70,   // $700000 = JOY1L
+            0x8F, 0x10, 0x00, 0x7E,                           // STA $7E0010
+            0x5C, 0x0C, 0x80, 0x00                            // JML loop
+        };
+        std::copy(history.begin(), history.end(), rom.begin() + 0x1000);
+
+        System plain;
+        System ahead;
+        Boot(plain);
+        Boot(ahead);
+        ahead.setRunAhead(2);
+        plain.loadSram("missing_directory/plain.srm", 0x800);
+        ahead.loadSram("missing_directory/ahead.srm", 0x800);
+
+        const uint16_t pads[] = { ButtonA, ButtonX, ButtonL, ButtonR, ButtonA, ButtonX };
+        for (uint16_t pad : pads)
+        {
+            plain.setInput(0, pad);
+            ahead.setInput(0, pad);
+            plain.runFrame();
+            ahead.runFrame();
+            for (uint32_t address = 0x700000; address <= 0x700002; ++address)
+                ASSERT_EQ(ahead.peek(address), plain.peek(address));
+        }
+        EXPECT_NE(ahead.peek(0x700000), ahead.peek(0x700001));
+        EXPECT_EQ(ahead.saveState(), plain.saveState());
+    }
+
+    TEST_F(FastForwardTest, SkippedFramesKeepTiming)
+    {
+        System plain;
+        System fast;
+        Boot(plain);
+        Boot(fast);
+        for (int i = 0; i < 7; ++i)
+            plain.runFrame();
+        FastForwardStats stats = fast.fastForward(7, 2);
+        EXPECT_EQ(stats.frames, 7u);
+        EXPECT_EQ(stats.renderedFrames, 2u);	// Frames 3 and 6
+
+        EXPECT_EQ(fast.frameCount(), plain.frameCount());
+        EXPECT_EQ(fast.cycles(), plain.cycles());
+        EXPECT_EQ(fast.saveState(), plain.saveState());
+
+        plain.runFrame();
+        fast.runFrame();
+        EXPECT_EQ(fast.framebuffer(), plain.framebuffer());
+    }
+
+    TEST_F(FastForwardTest, PresentsOnlyEveryNthFrame)
+    {
+        System system;
+        Boot(system);
+        int presented = 0;
+        system.setFrameCallback([&](const System&) { ++presented; });
+        VisitCounter profiler;
+        system.attachProfiler(&profiler);
+
+        FastForwardStats stats = system.fastForward(9, 2);
+        system.attachProfiler(nullptr);
+
+        EXPECT_EQ(presented, 3);
+        EXPECT_EQ(profiler.entries(ProfilePhase::Audio), 3u);
+        EXPECT_EQ(stats.frames, 9u);
+        EXPECT_EQ(stats.renderedFrames, 3u);
+        EXPECT_GE(stats.seconds, 0.0);
+        EXPECT_GE(stats.fps, 0.0);
+    }
+
+    TEST_F(FastForwardTest, SkippedFramesLeaveTheScreenAlone)
+    {
+        System system;
+        Boot(system);
+        system.fastForward(3, 0);
+        uint16_t idle = system.framebuffer()[0];
+
+        // The pad reaches the backdrop on the next frame, but neither of these is drawn
+        system.setInput(0, ButtonA);
+        FastForwardStats skipped = system.fastForward(2, 2);
+        EXPECT_EQ(skipped.frames, 2u);
+        EXPECT_EQ(skipped.renderedFrames, 0u);
+        EXPECT_EQ(system.framebuffer()[0], idle);
+
+        FastForwardStats shown = system.fastForward(1, 0);
+        EXPECT_EQ(shown.renderedFrames, 1u);
+        EXPECT_NE(system.framebuffer()[0], idle);
+    }
+}
@@ -0,0 +1,304 @@
+#include "pch.h"
+#include "gtest/gtest.h"
+#include "src/system.h"
+#include "src/savestate.h"
+#include "src/machine_state.h"
+#include "src/ppu.h"
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+
+
+class SaveStateTest : public ::testing::Test
+{
+protected:
+    std::vector<uint8_t> rom;
+
+    void SetUp() override
+    {
+        rom.assign(0x8000, 0xEA);
+        const std::vector<uint8_t> program = {
+            0xA9, 0x42, 0x8F, 0x00, 0x01, 0x7E,   // STA $7E0100
+            0xA9, 0x80, 0x8F, 0x15, 0x21, 0x00,   // VMAIN: increment on high byte
+            0xA9, 0x34, 0x8F, 0x18, 0x21, 0x00,   // VMDATAL
+            0xA9, 0x12, 0x8F, 0x19, 0x21, 0x00,   // VMDATAH
+            0x80, 0xFE                            // BRA *
+        };
+        std::copy(program.begin(), program.end(), rom.begin());
+    }
+
+    void Boot(System& system)
+    {
+        system.loadRom(rom);
+        system.init();
+    }
+
+    static PpuLatches Latches(const std::vector<uint8_t>& bytes)
+    {
+        SaveStateView view;
+        EXPECT_TRUE(view.open(bytes.data(), bytes.size()));
+        const PpuLatches* latches = view.find<PpuLatches>(sectionId("PPU "), 4);
+        return latches ? *latches : PpuLatches();
+    }
+
+    // The same state as an older build wrote it: the given PPU section, and no DMA section
+    static std::vector<uint8_t> Downgrade(const std::vector<uint8_t>& bytes, uint32_t ppuVersion, const void* ppu, size_t size)
+    {
+        const SaveStateHeader* header = reinterpret_cast<const SaveStateHeader*>(bytes.data());
+        const SaveStateSection* table = reinterpret_cast<const SaveStateSection*>(bytes.data() + sizeof(SaveStateHeader));
+        SaveStateWriter writer;
+        for (uint32_t i = 0; i < header->sectionCount; ++i)
+        {
+            if (table[i].id == sectionId("PPU "))
+                writer.add(table[i].id, ppuVersion, ppu, size);
+            else if (table[i].id != sectionId("DMA "))
+                writer.add(table[i].id, table[i].version, bytes.data() + table[i].offset, size_t(table[i].size));
+        }
+        std::vector<uint8_t> out;
+        writer.build(out);
+        return out;
+    }
+};
+
+namespace SaveState_Tests
+{
+    TEST_F(SaveStateTest, RoundTripsThroughFile)
+    {
+        std::string path = "savestate_roundtrip_test.sst";
+        System original;
+        Boot(original);
+        original.runFrame(false);
+        ASSERT_TRUE(original.saveState(path));
+
+        System restored;
+        Boot(restored);
+        ASSERT_TRUE(restored.loadState(path));
+        std::remove(path.c_str());
+
+        EXPECT_EQ(restored.cycles(), original.cycles());
+        EXPECT_EQ(restored.frameCount(), original.frameCount());
+        EXPECT_EQ(restored.registers().PC, original.registers().PC);
+        EXPECT_EQ(restored.registers().A, original.registers().A);
+        EXPECT_EQ(restored.peek(0x7E0100), 0x42);
+
+        // Both machines continue identically from the checkpoint
+        original.runFrame(false);
+        restored.runFrame(false);
+        EXPECT_EQ(restored.cycles(), original.cycles());
+        EXPECT_EQ(restored.saveState(), original.saveState());
+    }
+
+    TEST_F(SaveStateTest, SectionsAreAligned)
+    {
+        System system;
+        Boot(system);
+        std::vector<uint8_t> bytes = system.saveState();
+
+        const SaveStateHeader* header = reinterpret_cast<const SaveStateHeader*>(bytes.data());
+        const SaveStateSection* table = reinterpret_cast<const SaveStateSection*>(bytes.data() + sizeof(SaveStateHeader));
+        ASSERT_EQ(header->fileSize, bytes.size());
+        for (uint32_t i = 0; i < header->sectionCount; ++i)
+            EXPECT_EQ(table[i].offset % SaveStateWriter::ALIGNMENT, 0u);
+
+        SaveStateView view;
+        ASSERT_TRUE(view.open(bytes.data(), bytes.size()));
+        EXPECT_NE(view.find(sectionId("WRAM"), 1, 0x20000), nullptr);
+        EXPECT_EQ(view.find(sectionId("WRAM"), 2, 0x20000), nullptr);
+    }
+
+    TEST_F(SaveStateTest, RejectsCorruptAndForeignStates)
+    {
+        System system;
+        Boot(system);
+        std::vector<uint8_t> bytes = system.saveState();
+
+        SaveStateView view;
+        std::vector<uint8_t> truncated(bytes.begin(), bytes.end() - 1);
+        EXPECT_FALSE(view.open(truncated.data(), truncated.size()));
+
+        std::vector<uint8_t> badMagic = bytes;
+        badMagic[0] = 'X';
+        EXPECT_FALSE(view.open(badMagic.data(), badMagic.size()));
+
+        rom[0x10] ^= 0xFF;
+        System other;
+        Boot(other);
+        ASSERT_TRUE(view.open(bytes.data(), bytes.size()));
+        EXPECT_FALSE(other.loadState(view));
+    }
+
+    TEST_F(SaveStateTest, LoadsVersionOneStates)
+    {
+        System original;
+        Boot(original);
+        original.runFrame(false);
+        std::vector<uint8_t> bytes = original.saveState();
+        PpuLatches latches = Latches(bytes);
+
+        // Version 1 held the port latches up to INIDISP, then a pad byte
+        uint8_t v1[16] = {};
+        std::memcpy(v1, &latches, offsetof(PpuLatches, bgMode));
+        std::vector<uint8_t> old = Downgrade(bytes, 1, v1, sizeof(v1));
+
+        System restored;
+        Boot(restored);
+        restored.runFrame(false);
+        SaveStateView view;
+        ASSERT_TRUE(view.open(old.data(), old.size()));
+        ASSERT_TRUE(restored.loadState(view));
+
+        PpuLatches upgraded = Latches(restored.saveState());
+        EXPECT_EQ(upgraded.vramAddress, latches.vramAddress);
+        EXPECT_EQ(upgraded.vramIncrementHigh, 0x80);
+        EXPECT_EQ(upgraded.brightness, latches.brightness);
+        EXPECT_EQ(upgraded.m7a, 0);
+        EXPECT_EQ(restored.cycles(), original.cycles());
+        EXPECT_EQ(restored.peek(0x7E0100), 0x42);
+
+        original.runFrame(false);
+        restored.runFrame(false);
+        EXPECT_EQ(restored.cycles(), original.cycles());
+    }
+
+    TEST_F(SaveStateTest, LoadsVersionTwoStates)
+    {
+        System original;
+        Boot(original);
+        original.runFrame(false);
+        std::vector<uint8_t> bytes = original.saveState();
+        PpuLatches latches = Latches(bytes);
+
+        // Version 2 had the mode 7 registers after a pad byte where the sprite latches now sit
+        uint8_t v2[38] = {};
+        std::memcpy(v2, &latches, offsetof(PpuLatches, obsel));
+        const uint16_t m7[8] = { 0x0100, 0xFF80, 0x0040, 0x0100, 0x0123, 0x0456, 0x1FF0, 0x0008 };
+        std::memcpy(v2 + 22, m7, sizeof(m7));
+        std::vector<uint8_t> old = Downgrade(bytes, 2, v2, sizeof(v2));
+
+        System restored;
+        Boot(restored);
+        SaveStateView view;
+        ASSERT_TRUE(view.open(old.data(), old.size()));
+        ASSERT_TRUE(restored.loadState(view));
+
+        PpuLatches upgraded = Latches(restored.saveState());
+        EXPECT_EQ(upgraded.vramIncrementHigh, 0x80);
+        EXPECT_EQ(upgraded.m7a, 0x0100);
+        EXPECT_EQ(upgraded.m7b, 0xFF80);
+        EXPECT_EQ(upgraded.m7vofs, 0x0008);
+        EXPECT_EQ(upgraded.obsel, 0);
+        EXPECT_EQ(upgraded.oamReload, 0);
+    }
+
+    TEST_F(SaveStateTest, LoadsVersionThreeStates)
+    {
+        System original;
+        Boot(original);
+        original.runFrame(false);
+        std::vector<uint8_t> bytes = original.saveState();
+        PpuLatches latches = Latches(bytes);
+        latches.obsel = 0x62;
+        latches.m7a = 0x0180;
+
+        // Version 3 ended before the window and color math registers
+        std::vector<uint8_t> old = Downgrade(bytes, 3, &latches, offsetof(PpuLatches, fixedColor));
+
+        System restored;
+        Boot(restored);
+        SaveStateView view;
+        ASSERT_TRUE(view.open(old.data(), old.size()));
+        ASSERT_TRUE(restored.loadState(view));
+
+        PpuLatches upgraded = Latches(restored.saveState());
+        EXPECT_EQ(upgraded.obsel, 0x62);
+        EXPECT_EQ(upgraded.m7a, 0x0180);
+        EXPECT_EQ(upgraded.vramIncrementHigh, 0x80);
+        EXPECT_EQ(upgraded.cgadsub, 0);
+        EXPECT_EQ(upgraded.fixedColor, 0);
+    }
+
+    TEST_F(SaveStateTest, RestoresRepeatedlyFromSharedView)
+    {
+        System system;
+        Boot(system);
+        system.runFrame(false);
+        std::vector<uint8_t> bytes = system.saveState();
+        SaveStateView view;
+        ASSERT_TRUE(view.open(bytes.data(), bytes.size()));
+
+        // The view is only read, so every restore lands on the same state
+        for (int i = 0; i < 3; ++i)
+        {
+            system.runFrame(false);
+            ASSERT_TRUE(system.loadState(view));
+            EXPECT_EQ(system.saveState(), bytes);
+        }
+    }
+
+    TEST_F(SaveStateTest, ArenaSnapshotMatchesSaveState)
+    {
+        System original;
+        Boot(original);
+        original.runFrame(false);
+        auto checkpoint = MachineStatePool::shared().acquire();
+        original.snapshot(*checkpoint);
+        std::vector<uint8_t> expected = original.saveState();
+
+        original.runFrame(false);
+        original.restore(*checkpoint);
+        EXPECT_EQ(original.saveState(), expected);
+
+        // Another machine on the same cartridge picks up from the snapshot too
+        System other;
+        Boot(other);
+        other.restore(*checkpoint);
+        EXPECT_EQ(other.saveState(), expected);
+        EXPECT_EQ(other.peek(0x7E0100), 0x42);
+
+        original.runFrame(false);
+        other.runFrame(false);
+        EXPECT_EQ(other.saveState(), original.saveState());
+    }
+
+    TEST(MachineStateTest, GroupsStartOnCacheLines)
+    {
+        EXPECT_EQ(alignof(MachineState), 64u);
+        EXPECT_EQ(offsetof(MachineState, cpu), 0u);
+        EXPECT_EQ(offsetof(MachineState, timing), 64u);
+        EXPECT_EQ(offsetof(MachineState, io), 128u);
+        EXPECT_EQ(offsetof(MachineState, ppu) % 64, 0u);
+        EXPECT_EQ(offsetof(MachineState, pageTable) % 64, 0u);
+        EXPECT_EQ(offsetof(MachineState, wram) % 64, 0u);
+
+        auto state = MachineStatePool::shared().acquire();
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(state.get()) % 64, 0u);
+    }
+
+    TEST(MachineStateTest, StandalonePpuKeepsItsOwnState)
+    {
+        size_t idle = MachineStatePool::shared().idle();
+        {
+            PPU ppu;
+            ppu.vram[0x10] = 0x1234;
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(ppu.vram.data()) % 64, 0u);
+        }
+        EXPECT_EQ(MachineStatePool::shared().idle(), idle);
+    }
+
+    TEST(MachineStateTest, PoolReusesReleasedArenas)
+    {
+        MachineStatePool pool;
+        MachineState* first = nullptr;
+        {
+            auto state = pool.acquire();
+            first = state.get();
+            state->wram[0x10] = 0x5A;
+        }
+        EXPECT_EQ(pool.idle(), 1u);
+
+        auto reused = pool.acquire();
+        EXPECT_EQ(reused.get(), first);
+        EXPECT_EQ(reused->wram[0x10], 0x00);
+        EXPECT_EQ(pool.idle(), 0u);
+    }
+}
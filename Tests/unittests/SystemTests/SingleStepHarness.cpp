@@ -0,0 +1,507 @@
+#include "pch.h"
+#include "SingleStepHarness.h"
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace SingleStep
+{
+    namespace
+    {
+        struct Json
+        {
+            enum class Type { Null, Bool, Number, String, Array, Object } type = Type::Null;
+            double number = 0.0;
+            std::string text;
+            std::vector<Json> items;
+            std::vector<std::pair<std::string, Json>> members;
+
+            const Json* get(const char* key) const
+            {
+                for (auto& member : members)
+                {
+                    if (member.first == key)
+                        return &member.second;
+                }
+                return nullptr;
+            }
+        };
+
+        class Parser
+        {
+        public:
+            Parser(const std::string& input) : p(input.data()), end(input.data() + input.size()) {}
+
+            bool parse(Json& value)
+            {
+                skip();
+                if (p >= end)
+                    return fail("unexpected end of input");
+
+                switch (*p)
+                {
+                case '{': return parseObject(value);
+                case '[': return parseArray(value);
+                case '"': value.type = Json::Type::String; return parseString(value.text);
+                case 't': return literal("true", value, Json::Type::Bool, 1.0);
+                case 'f': return literal("false", value, Json::Type::Bool, 0.0);
+                case 'n': return literal("null", value, Json::Type::Null, 0.0);
+                default: return parseNumber(value);
+                }
+            }
+
+            std::string error;
+        private:
+            void skip()
+            {
+                while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+                    ++p;
+            }
+
+            bool fail(const char* message)
+            {
+                error = message;
+                return false;
+            }
+
+            bool literal(const char* word, Json& value, Json::Type type, double number)
+            {
+                for (const char* w = word; *w; ++w, ++p)
+                {
+                    if (p >= end || *p != *w)
+                        return fail("bad literal");
+                }
+                value.type = type;
+                value.number = number;
+                return true;
+            }
+
+            bool parseNumber(Json& value)
+            {
+                char* stop = nullptr;
+                value.number = std::strtod(p, &stop);
+                if (stop == p)
+                    return fail("bad number");
+                value.type = Json::Type::Number;
+                p = stop;
+                return true;
+            }
+
+            bool parseString(std::string& out)
+            {
+                ++p;
+                const char* start = p;
+                while (p < end && *p != '"')
+                {
+                    if (*p == '\\')
+                        ++p;
+                    ++p;
+                }
+                if (p >= end)
+                    return fail("unterminated string");
+                out.assign(start, p);
+                ++p;
+                return true;
+            }
+
+            bool parseArray(Json& value)
+            {
+                value.type = Json::Type::Array;
+                ++p;
+                skip();
+                if (p < end && *p == ']')
+                {
+                    ++p;
+                    return true;
+                }
+                for (;;)
+                {
+                    value.items.emplace_back();
+                    if (!parse(value.items.back()))
+                        return false;
+                    skip();
+                    if (p < end && *p == ',')
+                    {
+                        ++p;
+                        continue;
+                    }
+                    if (p < end && *p == ']')
+                    {
+                        ++p;
+                        return true;
+                    }
+                    return fail("expected , or ]");
+                }
+            }
+
+            bool parseObject(Json& value)
+            {
+                value.type = Json::Type::Object;
+                ++p;
+                skip();
+                if (p < end && *p == '}')
+                {
+                    ++p;
+                    return true;
+                }
+                for (;;)
+                {
+                    skip();
+                    if (p >= end || *p != '"')
+                        return fail("expected key");
+                    value.members.emplace_back();
+                    if (!parseString(value.members.back().first))
+                        return false;
+                    skip();
+                    if (p >= end || *p != ':')
+                        return fail("expected :");
+                    ++p;
+                    if (!parse(value.members.back().second))
+                        return false;
+                    skip();
+                    if (p < end && *p == ',')
+                    {
+                        ++p;
+                        continue;
+                    }
+                    if (p < end && *p == '}')
+                    {
+                        ++p;
+                        return true;
+                    }
+                    return fail("expected , or }");
+                }
+            }
+
+            const char* p;
+            const char* end;
+        };
+
+        uint32_t number(const Json& object, const char* key)
+        {
+            const Json* value = object.get(key);
+            return value ? uint32_t(value->number) : 0;
+        }
+
+        bool readState(const Json& json, CpuState& state)
+        {
+            if (json.type != Json::Type::Object)
+                return false;
+
+            state.pc = uint16_t(number(json, "pc"));
+            state.s = uint16_t(number(json, "s"));
+            state.a = uint16_t(number(json, "a"));
+            state.x = uint16_t(number(json, "x"));
+            state.y = uint16_t(number(json, "y"));
+            state.d = uint16_t(number(json, "d"));
+            state.p = uint8_t(number(json, "p"));
+            state.dbr = uint8_t(number(json, "dbr"));
+            state.pbr = uint8_t(number(json, "pbr"));
+            state.e = number(json, "e") != 0;
+
+            if (const Json* ram = json.get("ram"))
+            {
+                for (const Json& entry : ram->items)
+                {
+                    if (entry.items.size() == 2)
+                        state.ram.emplace_back(uint32_t(entry.items[0].number) & 0xFFFFFF, uint8_t(entry.items[1].number));
+                }
+            }
+            return true;
+        }
+
+        std::string describe(const char* field, uint32_t expected, uint32_t actual)
+        {
+            std::ostringstream out;
+            out << field << ": expected $" << std::hex << expected << " got $" << actual;
+            return out.str();
+        }
+    }
+
+    bool parseVectors(const std::string& json, std::vector<Vector>& out, std::string& error)
+    {
+        Parser parser(json);
+        Json root;
+        if (!parser.parse(root))
+        {
+            error = parser.error;
+            return false;
+        }
+        if (root.type != Json::Type::Array)
+        {
+            error = "expected an array of vectors";
+            return false;
+        }
+
+        out.reserve(out.size() + root.items.size());
+        for (const Json& test : root.items)
+        {
+            Vector vector;
+            if (const Json* name = test.get("name"))
+                vector.name = name->text;
+
+            const Json* initial = test.get("initial");
+            const Json* final = test.get("final");
+            if (!initial || !final || !readState(*initial, vector.initial) || !readState(*final, vector.final))
+            {
+                error = "vector " + vector.name + " is missing a state";
+                return false;
+            }
+
+            // Flags are "dp-rw..." style: VDA, VPA, then read/write at index 3
+            if (const Json* cycles = test.get("cycles"))
+            {
+                for (const Json& cycle : cycles->items)
+                {
+                    if (cycle.items.size() < 3 || cycle.items[0].type != Json::Type::Number)
+                        continue;
+                    const std::string& flags = cycle.items[2].text;
+                    bool valid = flags.size() > 3 && (flags[0] == 'd' || flags[1] == 'p');
+                    if (!valid)
+                        continue;
+
+                    BusCycle bus;
+                    bus.address = uint32_t(cycle.items[0].number) & 0xFFFFFF;
+                    bus.value = uint8_t(cycle.items[1].number);
+                    bus.write = flags[3] == 'w';
+                    vector.cycles.push_back(bus);
+                }
+            }
+            out.push_back(std::move(vector));
+        }
+        return true;
+    }
+
+    uint8_t SparseBus::read(uint32_t address)
+    {
+        uint8_t value = get(address);
+        accesses.push_back({ address, value, false });
+        return value;
+    }
+
+    void SparseBus::write(uint32_t address, uint8_t value)
+    {
+        accesses.push_back({ address, value, true });
+        poke(address, value);
+    }
+
+    void SparseBus::reset()
+    {
+        bytes.clear();
+        accesses.clear();
+    }
+
+    void SparseBus::poke(uint32_t address, uint8_t value)
+    {
+        for (auto& entry : bytes)
+        {
+            if (entry.first == address)
+            {
+                entry.second = value;
+                return;
+            }
+        }
+        bytes.emplace_back(address, value);
+    }
+
+    uint8_t SparseBus::get(uint32_t address) const
+    {
+        for (auto& entry : bytes)
+        {
+            if (entry.first == address)
+                return entry.second;
+        }
+        return 0x00;
+    }
+
+    Runner::Runner()
+    {
+        map.map(0x000000, 0xFFFFFF, &bus);
+        cpu.memory = &map;
+    }
+
+    Outcome Runner::run(const Vector& vector, bool checkBus, std::string* mismatch)
+    {
+        const CpuState& in = vector.initial;
+        bus.reset();
+        for (auto& entry : in.ram)
+            bus.poke(entry.first, entry.second);
+
+        uint8_t opcode = bus.get((uint32_t(in.pbr) << 16) | in.pc);
+        if (!cpu.hasHandler(opcode))
+            return Outcome::Skipped;
+
+        cpu.registers.PC = in.pc;
+        cpu.registers.S = in.s;
+        cpu.registers.A = in.a;
+        cpu.registers.X = in.x;
+        cpu.registers.Y = in.y;
+        cpu.registers.D = in.d;
+        cpu.registers.P = in.p;
+        cpu.registers.DBR = in.dbr;
+        cpu.registers.PBR = in.pbr;
+        cpu.registers.E = in.e;
+        cpu.running = true;
+
+        cpu.step();
+        if (!cpu.running)
+            return Outcome::Skipped;
+
+        const CpuState& out = vector.final;
+        const Registers& r = cpu.registers;
+        std::string problem;
+        if (r.PC != out.pc) problem = describe("pc", out.pc, r.PC);
+        else if (r.PBR != out.pbr) problem = describe("pbr", out.pbr, r.PBR);
+        else if (r.A != out.a) problem = describe("a", out.a, r.A);
+        else if (r.X != out.x) problem = describe("x", out.x, r.X);
+        else if (r.Y != out.y) problem = describe("y", out.y, r.Y);
+        else if (r.S != out.s) problem = describe("s", out.s, r.S);
+        else if (r.D != out.d) problem = describe("d", out.d, r.D);
+        else if (r.DBR != out.dbr) problem = describe("dbr", out.dbr, r.DBR);
+        else if (r.P != out.p) problem = describe("p", out.p, r.P);
+        else if (r.E != out.e) problem = describe("e", out.e, r.E);
+
+        for (size_t i = 0; problem.empty() && i < out.ram.size(); ++i)
+        {
+            uint8_t actual = bus.get(out.ram[i].first);
+            if (actual != out.ram[i].second)
+            {
+                std::ostringstream where;
+                where << " at $" << std::hex << out.ram[i].first;
+                problem = describe("ram", out.ram[i].second, actual) + where.str();
+            }
+        }
+
+        if (problem.empty() && checkBus)
+        {
+            if (bus.accesses.size() != vector.cycles.size())
+            {
+                problem = describe("bus accesses", uint32_t(vector.cycles.size()), uint32_t(bus.accesses.size()));
+            }
+            else
+            {
+                for (size_t i = 0; i < vector.cycles.size() && problem.empty(); ++i)
+                {
+                    const BusCycle& want = vector.cycles[i];
+                    const BusCycle& got = bus.accesses[i];
+                    std::string field = "bus cycle " + std::to_string(i);
+                    if (want.address != got.address)
+                        problem = describe((field + " address").c_str(), want.address, got.address);
+                    else if (want.write != got.write)
+                        problem = field + " direction: expected " + (want.write ? "write" : "read") + " got " + (got.write ? "write" : "read");
+                    else if (want.value != got.value)
+                        problem = describe((field + " value").c_str(), want.value, got.value);
+                }
+            }
+        }
+
+        if (problem.empty())
+            return Outcome::Passed;
+        if (mismatch)
+            *mismatch = vector.name + ": " + problem;
+        return Outcome::Failed;
+    }
+
+    CorpusReport runCorpus(const std::vector<std::string>& files, unsigned threads, bool checkBus)
+    {
+        CorpusReport report;
+        std::mutex lock;
+        std::atomic<size_t> next{ 0 };
+        const size_t failureLog = 20;
+
+        if (threads == 0)
+            threads = 1;
+
+        auto worker = [&]()
+        {
+            Runner runner;
+            CorpusReport local;
+            for (size_t index = next++; index < files.size(); index = next++)
+            {
+                std::ifstream in(files[index], std::ios::binary);
+                if (!in)
+                    continue;
+                std::string json((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+                std::vector<Vector> vectors;
+                std::string error;
+                if (!parseVectors(json, vectors, error))
+                {
+                    local.errors.push_back(files[index] + ": " + error);
+                    continue;
+                }
+                ++local.files;
+
+                for (const Vector& vector : vectors)
+                {
+                    uint8_t opcode = 0;
+                    for (auto& entry : vector.initial.ram)
+                    {
+                        if (entry.first == ((uint32_t(vector.initial.pbr) << 16) | vector.initial.pc))
+                            opcode = entry.second;
+                    }
+
+                    std::string mismatch;
+                    Outcome outcome = runner.run(vector, checkBus, local.failures.size() < failureLog ? &mismatch : nullptr);
+                    OpcodeReport& op = local.opcodes[opcode];
+                    switch (outcome)
+                    {
+                    case Outcome::Passed: ++local.passed; ++op.passed; break;
+                    case Outcome::Skipped: ++local.skipped; ++op.skipped; break;
+                    case Outcome::Failed:
+                        ++local.failed;
+                        ++op.failed;
+                        if (!mismatch.empty())
+                            local.failures.push_back(mismatch);
+                        break;
+                    }
+                }
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            report.files += local.files;
+            report.passed += local.passed;
+            report.failed += local.failed;
+            report.skipped += local.skipped;
+            for (size_t i = 0; i < 256; ++i)
+            {
+                report.opcodes[i].passed += local.opcodes[i].passed;
+                report.opcodes[i].failed += local.opcodes[i].failed;
+                report.opcodes[i].skipped += local.opcodes[i].skipped;
+            }
+            for (auto& failure : local.failures)
+            {
+                if (report.failures.size() < failureLog)
+                    report.failures.push_back(failure);
+            }
+            report.errors.insert(report.errors.end(), local.errors.begin(), local.errors.end());
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned i = 1; i < threads; ++i)
+            pool.emplace_back(worker);
+        worker();
+        for (auto& thread : pool)
+            thread.join();
+        return report;
+    }
+
+    std::vector<std::string> corpusFiles(const std::string& directory)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::vector<std::string> files;
+        for (int op = 0; op < 256; ++op)
+        {
+            for (const char* mode : { "e", "n" })
+            {
+                std::string path = directory + "/" + digits[op >> 4] + digits[op & 0x0F] + "." + mode + ".json";
+                if (std::ifstream(path))
+                    files.push_back(path);
+            }
+        }
+        return files;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "src/cpu.h"
+#include "src/memory.h"
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Single-step conformance vectors in the per-opcode JSON layout
+// ({"name", "initial", "final", "cycles"} objects, one array per file).
+namespace SingleStep
+{
+    struct CpuState
+    {
+        uint16_t pc = 0, s = 0, a = 0, x = 0, y = 0, d = 0;
+        uint8_t p = 0, dbr = 0, pbr = 0;
+        bool e = false;
+        std::vector<std::pair<uint32_t, uint8_t>> ram;
+    };
+
+    struct BusCycle
+    {
+        uint32_t address = 0;
+        uint8_t value = 0;
+        bool write = false;
+    };
+
+    struct Vector
+    {
+        std::string name;
+        CpuState initial;
+        CpuState final;
+        std::vector<BusCycle> cycles;	// Valid data/program accesses only
+    };
+
+    bool parseVectors(const std::string& json, std::vector<Vector>& out, std::string& error);
+
+    // Flat 24-bit bus that only stores the bytes a vector touches
+    class SparseBus : public MemoryHandler
+    {
+    public:
+        uint8_t read(uint32_t address) override;
+        void write(uint32_t address, uint8_t value) override;
+        void reset();
+        void poke(uint32_t address, uint8_t value);
+        uint8_t get(uint32_t address) const;
+
+        std::vector<BusCycle> accesses;
+    private:
+        std::vector<std::pair<uint32_t, uint8_t>> bytes;
+    };
+
+    enum class Outcome { Passed, Failed, Skipped };
+
+    // One CPU, map and bus reused for every vector run on a thread
+    class Runner
+    {
+    public:
+        Runner();
+        Outcome run(const Vector& vector, bool checkBus, std::string* mismatch = nullptr);
+    private:
+        CPU cpu;
+        MemoryMap map;
+        SparseBus bus;
+    };
+
+    struct OpcodeReport
+    {
+        size_t passed = 0;
+        size_t failed = 0;
+        size_t skipped = 0;
+    };
+
+    struct CorpusReport
+    {
+        size_t files = 0;
+        size_t passed = 0;
+        size_t failed = 0;
+        size_t skipped = 0;
+        std::array<OpcodeReport, 256> opcodes = {};
+        std::vector<std::string> failures;	// First few mismatches, for the log
+        std::vector<std::string> errors;
+    };
+
+    // Files are split across threads; each thread parses and runs whole files
+    CorpusReport runCorpus(const std::vector<std::string>& files, unsigned threads, bool checkBus);
+
+    // "<dir>/<op>.<e|n>.json" for every opcode, as laid out by the public corpus
+    std::vector<std::string> corpusFiles(const std::string& directory);
+}